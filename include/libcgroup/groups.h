@@ -50,6 +50,43 @@ enum cgroup_delete_flag {
 	 * CGFLAG_DELETE_RECURSIVE.
 	 */
 	CGFLAG_DELETE_EMPTY_ONLY = 4,
+
+	/**
+	 * Kill the tasks of the group and of all its subgroups with
+	 * cgroup.kill instead of moving them to the parent group.  Groups
+	 * without cgroup.kill, i.e. on cgroup v1 or Linux older than 5.14,
+	 * have their tasks moved as usual.  cgroup.kill kills the whole
+	 * subtree, so this flag requires CGFLAG_DELETE_RECURSIVE.
+	 */
+	CGFLAG_DELETE_KILL = 8,
+
+	/**
+	 * With CGFLAG_DELETE_RECURSIVE, remove independent subgroups
+	 * concurrently with a bounded pool of threads.  A group is removed
+	 * as soon as all its subgroups are gone.
+	 */
+	CGFLAG_DELETE_PARALLEL = 16,
+};
+
+/**
+ * Flags for cgroup_get_cgroup_ext().
+ */
+enum cgroup_get_flag {
+	/**
+	 * Only list the settings, their values are read from the kernel on
+	 * first access with cgroup_get_value_string() and friends.
+	 */
+	CGFLAG_GET_LAZY = 1,
+};
+
+/**
+ * Flags for cgroup_get_procs_ext() and cgroup_get_threads_ext().
+ */
+enum cgroup_get_pids_flag {
+	/** Sort the list. */
+	CGFLAG_GET_PIDS_SORT = 1,
+	/** Only count the tasks, the list is not touched. */
+	CGFLAG_GET_PIDS_COUNT = 2,
 };
 
 /**
@@ -279,6 +316,9 @@ int cgroup_delete_cgroup(struct cgroup *cgrp, int ignore_migration);
  * #CGFLAG_DELETE_RECURSIVE flag specifies that all subgroups should be removed
  * too. If root group is being removed with this flag specified, all subgroups
  * are removed but the root group itself is left undeleted.
+ * #CGFLAG_DELETE_KILL flag kills the tasks instead of moving them, the
+ * tasks of the root group are never killed.  It can only be used with
+ * #CGFLAG_DELETE_RECURSIVE, ECGINVAL is returned otherwise.
  * @see cgroup_delete_flag.
  *
  * @param cgrp
@@ -311,11 +351,32 @@ int cgroup_delete_cgroup_ext(struct cgroup *cgrp, int flags);
  * cgroup_get_uid_gid() if the group is in multiple hierarchies, each with
  * different owner of tasks file?
  *
+ * Controllers attached with cgroup_add_controller() limit the read to
+ * these controllers.  If such a controller already has values, added with
+ * cgroup_add_value_string() and friends, only these settings are read,
+ * which avoids listing and reading every file of the group.  A missing
+ * setting fails with ECGROUPVALUENOTEXIST.
+ *
  * @param cgrp The cgroup to load. Only its name is used, everything else
  *	is replaced.
  */
 int cgroup_get_cgroup(struct cgroup *cgrp);
 
+/**
+ * Read information regarding the group from kernel, like
+ * cgroup_get_cgroup().
+ *
+ * With CGFLAG_GET_LAZY, the values are read on first access with
+ * cgroup_get_value_string(), cgroup_get_value_int64(),
+ * cgroup_get_value_uint64() or cgroup_get_value_bool(), so settings that
+ * are never looked at cost nothing.  cgroup_copy_cgroup() reads the
+ * values it copies.  Other functions see the values not read yet as empty.
+ *
+ * @param cgrp The cgroup to load.
+ * @param flags Combination of CGFLAG_GET_* flags.
+ */
+int cgroup_get_cgroup_ext(struct cgroup *cgrp, int flags);
+
 /**
  * Copy all controllers, their parameters and values. Group name, permissions
  * and ownerships are not copied. All existing controllers
@@ -589,6 +650,33 @@ int cgroup_get_procs(const char *name, const char *controller, pid_t **pids, int
  */
 int cgroup_get_threads(const char *name, const char *controller, pid_t **pids, int *size);
 
+/**
+ * Get the list of processes in a cgroup, like cgroup_get_procs(), into a
+ * buffer that can be reused from one call to the next.  The list is only
+ * sorted on request, and the tasks can be counted without listing them.
+ * @param name The name of the cgroup
+ * @param controller The name of the controller
+ * @param pids Buffer for the list, NULL or allocated with malloc().  It is
+ *	grown with realloc() as needed and is to be freed by the caller.  May
+ *	be NULL with #CGFLAG_GET_PIDS_COUNT.
+ * @param size Size of the pids buffer, in pids, 0 if NULL, updated when
+ *	grown.  May be NULL with #CGFLAG_GET_PIDS_COUNT.
+ * @param cnt The number of processes.
+ * @param flags Bit flags, see #cgroup_get_pids_flag.
+ * @return 0 on success, ECGROUPSUBSYSNOTMOUNTED if the controller isn't
+ *	mounted, ECGROUPUNSUPP if the file doesn't exist, ECGINVAL if it isn't
+ *	a list of pids.
+ */
+int cgroup_get_procs_ext(const char *name, const char *controller, pid_t **pids, int *size,
+			 int *cnt, int flags);
+
+/**
+ * Get the list of threads in a cgroup, like cgroup_get_threads(), see
+ * cgroup_get_procs_ext() for the parameters.
+ */
+int cgroup_get_threads_ext(const char *name, const char *controller, pid_t **pids, int *size,
+			   int *cnt, int flags);
+
 /**
  * Change permission of files and directories of given group
  * @param cgrp The cgroup which permissions should be changed
@@ -692,6 +780,173 @@ bool is_cgroup_mode_hybrid(void);
  */
 bool is_cgroup_mode_unified(void);
 
+/**
+ * @}
+ * @name Cgroup handles
+ * A <tt>struct cgroup_handle*</tt> keeps an existing control group open.
+ * Unlike the functions above, the parameters are read and written directly
+ * from/to the kernel, through file descriptors that are opened on first use
+ * and reused by subsequent calls.  This is meant for applications that
+ * repeatedly read or update the same parameters of the same group.
+ *
+ * A parameter is looked up in the hierarchy of the controller its name
+ * starts with.  The cgroup v1 files without a controller prefix, e.g.
+ * @c tasks or @c notify_on_release, are looked up in the first cgroup v1
+ * hierarchy of the handle; open the handle with a single controller to
+ * choose the hierarchy.
+ *
+ * A handle must not be used by multiple threads at the same time.
+ * @{
+ */
+struct cgroup_handle;
+
+/**
+ * Open an existing control group.
+ *
+ * @param name Name of the group.
+ * @param controllers NULL terminated list of the controllers to open, or
+ * NULL to open all mounted controllers the group exists in.
+ * @param handle The opened handle.  Use cgroup_close() to free it.
+ * @return 0 on success, ECGROUPNOTEXIST if the group doesn't exist in one
+ * of the requested controllers (or in any controller when controllers is
+ * NULL).
+ */
+int cgroup_open(const char *name, const char * const controllers[],
+		struct cgroup_handle **handle);
+
+/**
+ * Read a parameter of the group.  The value is truncated to len - 1 bytes,
+ * is always NUL terminated and the trailing newline is removed.
+ *
+ * @param handle
+ * @param name Name of the parameter, e.g. "memory.stat".
+ * @param value Buffer for the value.
+ * @param len Size of the value buffer.
+ * @return 0 on success, ECGROUPSUBSYSNOTMOUNTED if the controller of the
+ * parameter isn't part of the handle, ECGROUPVALUENOTEXIST if the parameter
+ * doesn't exist.
+ */
+int cgroup_handle_read(struct cgroup_handle *handle, const char *name, char *value,
+		       size_t len);
+
+/**
+ * Read a parameter of the group whatever its size, e.g. memory.stat or
+ * memory.numa_stat on large machines.  The trailing newline is removed.
+ *
+ * @param handle
+ * @param name Name of the parameter, e.g. "memory.stat".
+ * @param value Buffer for the value, NULL or allocated with malloc().  It is
+ * grown with realloc() as needed and is to be freed by the caller, so it can
+ * be reused for the next read.
+ * @param size Size of the value buffer, 0 if NULL, updated when grown.
+ * @return 0 on success, ECGROUPSUBSYSNOTMOUNTED if the controller of the
+ * parameter isn't part of the handle, ECGROUPVALUENOTEXIST if the parameter
+ * doesn't exist.
+ */
+int cgroup_handle_read_all(struct cgroup_handle *handle, const char *name, char **value,
+			   size_t *size);
+
+/**
+ * Read and parse a stats file of the group, see cgroup_read_stats_typed().
+ *
+ * @param handle
+ * @param name Name of the file, e.g. "cpu.stat" or "io.stat".
+ * @param stats The values.
+ * @return 0 on success, ECGROUPSUBSYSNOTMOUNTED if the controller of the
+ * file isn't part of the handle, ECGROUPVALUENOTEXIST if the file doesn't
+ * exist, ECGINVAL if a value isn't a number.
+ */
+int cgroup_handle_read_stats(struct cgroup_handle *handle, const char *name,
+			     struct cgroup_stats *stats);
+
+/**
+ * Write a parameter of the group.  Multiline values are written line by
+ * line.
+ *
+ * @param handle
+ * @param name Name of the parameter, e.g. "cpu.max".
+ * @param value The new value.
+ * @return 0 on success, ECGROUPSUBSYSNOTMOUNTED if the controller of the
+ * parameter isn't part of the handle, ECGROUPVALUENOTEXIST if the parameter
+ * doesn't exist.
+ */
+int cgroup_handle_write(struct cgroup_handle *handle, const char *name, const char *value);
+
+/**
+ * Move a process, with all its threads, to the group in all hierarchies of
+ * the handle.
+ *
+ * @param handle
+ * @param pid The process to move.
+ */
+int cgroup_handle_attach(struct cgroup_handle *handle, pid_t pid);
+
+/**
+ * Close the handle and free it.
+ *
+ * @param handle
+ */
+void cgroup_close(struct cgroup_handle *handle);
+
+/**
+ * @}
+ * @name Cgroup pools
+ * A <tt>struct cgroup_pool*</tt> keeps a number of pre-created groups under
+ * a parent group, so that placing a job doesn't wait for the group to be
+ * created, its ownership to be changed and its parameters to be written.
+ * Groups are handed out by cgroup_pool_acquire(), a background thread
+ * resets the released groups and tops up the pool.
+ *
+ * The pool functions can be called from multiple threads.
+ * @{
+ */
+struct cgroup_pool;
+
+/**
+ * Create a pool of groups.  The groups are named
+ * <tt>parent/pool-<pid>-<n></tt> and have the controllers, parameters,
+ * ownerships and permissions of the template.  The initial groups are
+ * created before the function returns.
+ *
+ * @param parent Name of the parent group, it's created if it doesn't exist.
+ * @param tmpl Template group, its name is ignored.  The pool keeps its own
+ *	copy.
+ * @param size Number of ready groups the pool maintains.
+ * @param pool The new pool.  Use cgroup_pool_destroy() to free it.
+ */
+int cgroup_pool_create(const char *parent, struct cgroup *tmpl, int size,
+		       struct cgroup_pool **pool);
+
+/**
+ * Take a group from the pool.  If the pool is drained, a new group is
+ * created by the caller.
+ *
+ * @param pool
+ * @param cgrp The group, owned by the pool.  It must not be modified or
+ *	freed, use cgroup_pool_release() to give it back.
+ */
+int cgroup_pool_acquire(struct cgroup_pool *pool, struct cgroup **cgrp);
+
+/**
+ * Give a group back to the pool.  The group should be empty, its template
+ * parameters are written again before it's handed out again.  A group that
+ * can't be reset is deleted and replaced.
+ *
+ * @param pool
+ * @param cgrp Group returned by cgroup_pool_acquire().
+ * @return 0 on success, ECGROUPNOTEXIST if the group wasn't acquired from
+ *	the pool.
+ */
+int cgroup_pool_release(struct cgroup_pool *pool, struct cgroup *cgrp);
+
+/**
+ * Stop the pool, delete its ready groups and free it.  Groups that are
+ * still acquired are left in place, their struct cgroup is freed.
+ *
+ * @param pool The pool, set to NULL.
+ */
+void cgroup_pool_destroy(struct cgroup_pool **pool);
+
 /**
  * @}
  * @}
@@ -264,6 +264,407 @@ int cgroup_read_stats_next(void **handle, struct cgroup_stat *stat);
  */
 int cgroup_read_stats_end(void **handle);
 
+/**
+ * @}
+ *
+ * @name Read typed group stats
+ * The following functions parse a whole stats file in one pass into numeric
+ * values, without copying the names.  Both the flat keyed files, e.g.
+ * @c memory.stat, @c cpu.stat or @c memory.events, and the nested keyed
+ * files, e.g. @c io.stat or the @c *.pressure files, are supported.
+ * @{
+ */
+
+/**
+ * Keys known by the typed stats readers.  A key may be found in several
+ * files, e.g. #CG_STAT_MAX in @c memory.events and @c pids.events.
+ *
+ * Most keys are counters, which only grow until the group is removed.  The
+ * others are gauges, e.g. the sizes of @c memory.stat or the pressure
+ * averages, which go up and down.  The comments below tell which are which.
+ *
+ * The values of the keys are part of the ABI, so the enum is append-only:
+ * new keys are only added at the end, right before the private sentinel.
+ * cgroup_stat_key_name() returns NULL for the keys that the library in use
+ * doesn't know yet.
+ */
+enum cgroup_stat_key {
+	CG_STAT_UNKNOWN = -1,
+
+	/* cpu.stat, cpuacct.stat, counters */
+	CG_STAT_USAGE_USEC,
+	CG_STAT_USER_USEC,
+	CG_STAT_SYSTEM_USEC,
+	CG_STAT_CORE_SCHED_FORCE_IDLE_USEC,
+	CG_STAT_NR_PERIODS,
+	CG_STAT_NR_THROTTLED,
+	CG_STAT_THROTTLED_USEC,
+	CG_STAT_THROTTLED_TIME,
+	CG_STAT_NR_BURSTS,
+	CG_STAT_BURST_USEC,
+	CG_STAT_BURST_TIME,
+	CG_STAT_USER,
+	CG_STAT_SYSTEM,
+
+	/* memory.stat, gauges */
+	CG_STAT_ANON,
+	CG_STAT_FILE,
+	CG_STAT_KERNEL,
+	CG_STAT_KERNEL_STACK,
+	CG_STAT_PAGETABLES,
+	CG_STAT_SEC_PAGETABLES,
+	CG_STAT_PERCPU,
+	CG_STAT_SOCK,
+	CG_STAT_VMALLOC,
+	CG_STAT_SHMEM,
+	CG_STAT_ZSWAP,
+	CG_STAT_ZSWAPPED,
+	CG_STAT_FILE_MAPPED,
+	CG_STAT_FILE_DIRTY,
+	CG_STAT_FILE_WRITEBACK,
+	CG_STAT_SWAPCACHED,
+	CG_STAT_ANON_THP,
+	CG_STAT_FILE_THP,
+	CG_STAT_SHMEM_THP,
+	CG_STAT_INACTIVE_ANON,
+	CG_STAT_ACTIVE_ANON,
+	CG_STAT_INACTIVE_FILE,
+	CG_STAT_ACTIVE_FILE,
+	CG_STAT_UNEVICTABLE,
+	CG_STAT_SLAB_RECLAIMABLE,
+	CG_STAT_SLAB_UNRECLAIMABLE,
+	CG_STAT_SLAB,
+	/* memory.stat, counters */
+	CG_STAT_WORKINGSET_REFAULT_ANON,
+	CG_STAT_WORKINGSET_REFAULT_FILE,
+	CG_STAT_WORKINGSET_ACTIVATE_ANON,
+	CG_STAT_WORKINGSET_ACTIVATE_FILE,
+	CG_STAT_WORKINGSET_RESTORE_ANON,
+	CG_STAT_WORKINGSET_RESTORE_FILE,
+	CG_STAT_WORKINGSET_NODERECLAIM,
+	CG_STAT_PGSCAN,
+	CG_STAT_PGSTEAL,
+	CG_STAT_PGSCAN_KSWAPD,
+	CG_STAT_PGSCAN_DIRECT,
+	CG_STAT_PGSCAN_KHUGEPAGED,
+	CG_STAT_PGSTEAL_KSWAPD,
+	CG_STAT_PGSTEAL_DIRECT,
+	CG_STAT_PGSTEAL_KHUGEPAGED,
+	CG_STAT_PGFAULT,
+	CG_STAT_PGMAJFAULT,
+	CG_STAT_PGREFILL,
+	CG_STAT_PGACTIVATE,
+	CG_STAT_PGDEACTIVATE,
+	CG_STAT_PGLAZYFREE,
+	CG_STAT_PGLAZYFREED,
+	CG_STAT_ZSWPIN,
+	CG_STAT_ZSWPOUT,
+	CG_STAT_ZSWPWB,
+	CG_STAT_THP_FAULT_ALLOC,
+	CG_STAT_THP_COLLAPSE_ALLOC,
+	CG_STAT_THP_SWPOUT,
+	CG_STAT_THP_SWPOUT_FALLBACK,
+	/* memory.stat of cgroup v1, gauges */
+	CG_STAT_CACHE,
+	CG_STAT_RSS,
+	CG_STAT_RSS_HUGE,
+	CG_STAT_MAPPED_FILE,
+	CG_STAT_DIRTY,
+	CG_STAT_WRITEBACK,
+	CG_STAT_SWAP,
+	/* Counters */
+	CG_STAT_PGPGIN,
+	CG_STAT_PGPGOUT,
+	/* Gauges */
+	CG_STAT_HIERARCHICAL_MEMORY_LIMIT,
+	CG_STAT_HIERARCHICAL_MEMSW_LIMIT,
+
+	/* memory.events, memory.swap.events, pids.events, counters */
+	CG_STAT_LOW,
+	CG_STAT_HIGH,
+	CG_STAT_MAX,
+	CG_STAT_OOM,
+	CG_STAT_OOM_KILL,
+	CG_STAT_OOM_GROUP_KILL,
+	CG_STAT_FAIL,
+
+	/* io.stat, counters */
+	CG_STAT_RBYTES,
+	CG_STAT_WBYTES,
+	CG_STAT_RIOS,
+	CG_STAT_WIOS,
+	CG_STAT_DBYTES,
+	CG_STAT_DIOS,
+
+	/* cpu.pressure, memory.pressure, io.pressure, gauges */
+	CG_STAT_AVG10,
+	CG_STAT_AVG60,
+	CG_STAT_AVG300,
+	/* Counter */
+	CG_STAT_TOTAL,
+
+	/* New keys go above.  Private, the number of keys of this header */
+	__CG_STAT_KEY_MAX,
+};
+
+/**
+ * One value of a stats file.
+ */
+struct cgroup_stat_entry {
+	/**
+	 * The first field of the line of a nested keyed file, e.g. "8:0" in
+	 * @c io.stat or "some" in @c cpu.pressure, NULL for a flat keyed file.
+	 */
+	const char *scope;
+	/** Name of the value, also set for unknown keys. */
+	const char *name;
+	/** #cgroup_stat_key of the name. */
+	int key;
+	/**
+	 * The value.  Values with decimals, i.e. the pressure averages, are
+	 * stored in hundredths, "max" is stored as UINT64_MAX.
+	 */
+	u_int64_t value;
+};
+
+/**
+ * The values of a stats file.  Initialize it with zeros and release it with
+ * cgroup_stats_free(); it can be reused from one read to the next, so that
+ * sampling doesn't allocate memory once the buffers are large enough.
+ */
+struct cgroup_stats {
+	/** The values, in the order of the file. */
+	struct cgroup_stat_entry *entries;
+	/** Number of values. */
+	int cnt;
+
+	/* Private, the buffers reused from one read to the next */
+	int size;
+	char *buf;
+	size_t buf_size;
+};
+
+/**
+ * Parse the content of a stats file.  The names of the values are not
+ * copied: buf is changed in place and must outlive the values.
+ *
+ * @param buf Content of the file, NUL terminated.
+ * @param stats The values.
+ * @return 0 on success, ECGINVAL if a value isn't a number.
+ */
+int cgroup_parse_stats(char *buf, struct cgroup_stats *stats);
+
+/**
+ * Read and parse a stats file of a group.
+ *
+ * @param controller Name of the controller of the file.
+ * @param path The path to control group, relative to hierarchy root.
+ * @param name Name of the file, e.g. "memory.stat" or "io.pressure".
+ * @param stats The values.
+ * @return 0 on success, ECGROUPVALUENOTEXIST if the file doesn't exist,
+ * ECGINVAL if a value isn't a number.
+ */
+int cgroup_read_stats_typed(const char *controller, const char *path, const char *name,
+			    struct cgroup_stats *stats);
+
+/**
+ * Find a value in stats.
+ *
+ * @param stats The values.
+ * @param scope The first field of the line for a nested keyed file, e.g.
+ * "8:0" or "some", NULL for a flat keyed file.
+ * @param key The key of the value.
+ * @param value The value.
+ * @return 0 on success, ECGROUPVALUENOTEXIST if there is no such value.
+ */
+int cgroup_stats_get(const struct cgroup_stats *stats, const char *scope,
+		     enum cgroup_stat_key key, u_int64_t *value);
+
+/**
+ * Get the name of a key, e.g. "usage_usec" for #CG_STAT_USAGE_USEC.
+ *
+ * @param key The key.
+ * @return The name, NULL for an invalid key.
+ */
+const char *cgroup_stat_key_name(enum cgroup_stat_key key);
+
+/**
+ * Release the buffers of stats.
+ */
+void cgroup_stats_free(struct cgroup_stats *stats);
+
+/**
+ * @}
+ *
+ * @name Sample rates of group stats
+ * A <tt>struct cgroup_sampler*</tt> reads a set of stats files, e.g.
+ * @c cpu.stat of several groups, keeps the values of the previous sample of
+ * every file and computes how much each value changed since then and at
+ * which rate.  The files are read through cgroup handles and the buffers
+ * are reused, so that sampling doesn't allocate memory once they are large
+ * enough.
+ *
+ * A sampler must not be used by several threads at once.
+ * @{
+ */
+struct cgroup_sampler;
+
+/** The value was not in the previous sample, e.g. on the first sample. */
+#define CG_STAT_DELTA_NEW	0x1
+/**
+ * The value of a counter decreased since the previous sample, i.e. it was
+ * reset, e.g. the group was removed and created again.  The delta is
+ * counted from zero.  Gauges, and the keys unknown to the library, are never
+ * flagged, their delta is negative when they decrease.
+ */
+#define CG_STAT_DELTA_RESET	0x2
+
+/**
+ * Change of a value between the last two samples of a file.
+ */
+struct cgroup_stat_delta {
+	/** Scope of the value, see struct cgroup_stat_entry. */
+	const char *scope;
+	/** Name of the value. */
+	const char *name;
+	/** #cgroup_stat_key of the name. */
+	int key;
+	/** The value in the last sample. */
+	u_int64_t value;
+	/** Change of the value since the previous sample, see #cgroup_stat_key. */
+	int64_t delta;
+	/** Change of the value per second. */
+	double rate;
+	/** CG_STAT_DELTA_* flags. */
+	int flags;
+};
+
+/**
+ * Create a sampler.
+ * @param sampler The new sampler.  Use cgroup_sampler_free() to free it.
+ */
+int cgroup_sampler_create(struct cgroup_sampler **sampler);
+
+/**
+ * Add a stats file of a group to the sampler.  The group is opened with
+ * cgroup_open(), once for all of its files.
+ * @param sampler
+ * @param name Name of the group.
+ * @param file Name of the file, e.g. "cpu.stat" or "io.stat".
+ * @param id The id of the file in the sampler.
+ * @return 0 on success, ECGROUPNOTEXIST if the group doesn't exist.
+ */
+int cgroup_sampler_add(struct cgroup_sampler *sampler, const char *name, const char *file,
+		       int *id);
+
+/**
+ * Read all the files of the sampler and compute the deltas from their
+ * previous sample.  The time of every sample is taken from CLOCK_MONOTONIC
+ * right after the file is read.  A file that fails to read doesn't stop the
+ * others and keeps its previous sample.
+ * @param sampler
+ * @return 0 if all files were read, the error of the first failure
+ *	otherwise, see cgroup_handle_read_stats().
+ */
+int cgroup_sampler_sample(struct cgroup_sampler *sampler);
+
+/**
+ * Get the deltas of all the values of a file, in the order of the file.
+ * They are valid until the next cgroup_sampler_sample().
+ * @param sampler
+ * @param id The id of the file, see cgroup_sampler_add().
+ * @param deltas The deltas.
+ * @param cnt Number of deltas, 0 before the first sample.
+ * @param interval_ns Time between the last two samples of the file in
+ *	nanoseconds, 0 after the first sample.  May be NULL.
+ */
+int cgroup_sampler_get_deltas(const struct cgroup_sampler *sampler, int id,
+			      const struct cgroup_stat_delta **deltas, int *cnt,
+			      u_int64_t *interval_ns);
+
+/**
+ * Find the delta of a value of a file.
+ * @param sampler
+ * @param id The id of the file, see cgroup_sampler_add().
+ * @param scope The scope of the value, NULL for a flat keyed file, see
+ *	cgroup_stats_get().
+ * @param key The key of the value.
+ * @param delta The delta.
+ * @return 0 on success, ECGROUPVALUENOTEXIST if there is no such value in
+ *	the last sample.
+ */
+int cgroup_sampler_get(const struct cgroup_sampler *sampler, int id, const char *scope,
+		       enum cgroup_stat_key key, struct cgroup_stat_delta *delta);
+
+/**
+ * Free the sampler and close its groups.
+ * @param sampler The sampler, set to NULL.
+ */
+void cgroup_sampler_free(struct cgroup_sampler **sampler);
+
+/**
+ * @}
+ *
+ * @name Collect files of a subtree
+ * Read a set of files, e.g. @c cpu.stat and @c memory.current, from every
+ * group of a subtree with a pool of threads.
+ * @{
+ */
+
+/**
+ * Content of a file read by cgroup_collect_subtree().
+ */
+struct cgroup_file_value {
+	/** Name of the file. */
+	const char *name;
+	/**
+	 * Content of the file without the trailing newline, NULL if it
+	 * couldn't be read.  It may be changed, e.g. by cgroup_parse_stats(),
+	 * but is only valid during the callback.
+	 */
+	char *value;
+	/** Length of the content. */
+	size_t len;
+	/** 0, ECGROUPVALUENOTEXIST if the file doesn't exist, or ECGOTHER. */
+	int error;
+};
+
+/**
+ * Called by cgroup_collect_subtree() for every group of the subtree.  The
+ * callback is called concurrently from several threads and in no particular
+ * order.
+ *
+ * @param path Path of the group, relative to the hierarchy root.
+ * @param values The files of the group, in the order they were requested.
+ * @param cnt Number of files.
+ * @param arg The argument of cgroup_collect_subtree().
+ * @return 0 to continue, any other value stops the collection and is
+ * returned by cgroup_collect_subtree().
+ */
+typedef int (*cgroup_collect_callback)(const char *path, struct cgroup_file_value *values,
+				       int cnt, void *arg);
+
+/**
+ * Read files of every group of a subtree, the root included.  The subtree is
+ * walked by a pool of threads, each with its own queue of groups and taking
+ * groups from the queues of the others when its own is empty.  The files are
+ * opened relative to the directory of their group.  Groups removed during
+ * the walk are skipped.
+ *
+ * @param controller Name of the controller of the hierarchy, NULL for the
+ * cgroup v2 hierarchy.
+ * @param root The path to the root group of the subtree, relative to the
+ * hierarchy root.
+ * @param files NULL terminated list of the files to read, e.g. "cpu.stat".
+ * @param cb The callback.
+ * @param arg Argument passed to the callback.
+ * @param nthreads Number of threads, or 0 for one per online CPU.
+ * @return 0 on success, ECGROUPNOTEXIST if root doesn't exist, or the
+ * value returned by the callback if it stopped the collection.
+ */
+int cgroup_collect_subtree(const char *controller, const char *root, const char * const *files,
+			   cgroup_collect_callback cb, void *arg, int nthreads);
+
 /**
  * @}
  *
@@ -58,6 +58,57 @@ int cgroup_attach_task(struct cgroup *cgrp);
  */
 int cgroup_attach_task_pid(struct cgroup *cgrp, pid_t tid);
 
+/** Outcome of moving one task with cgroup_attach_tasks(). */
+struct cgroup_attach_result {
+	/** 0 if the task was moved, error code otherwise. */
+	int ret;
+	/** errno of the failed write if ret is ECGOTHER, e.g. ESRCH. */
+	int err;
+};
+
+/**
+ * Move given tasks (=threads) to given control group.  The destination is
+ * resolved and opened once for all the tasks, each task is then moved with
+ * a single write per hierarchy, like cgroup_attach_task_pid() does.
+ *
+ * A task that fails to move doesn't stop the others from being moved.
+ *
+ * @param cgrp Destination control group.
+ * @param tids The tasks to move.
+ * @param n Number of tasks in tids.
+ * @param results Optional array of n entries, receives the outcome of each
+ *	task.
+ * @return 0 if all tasks were moved, the error of the first task that
+ *	failed to move otherwise.  If the destination can't be resolved or
+ *	opened, the error is returned and no task is moved.
+ */
+int cgroup_attach_tasks(struct cgroup *cgrp, const pid_t *tids, size_t n,
+			struct cgroup_attach_result *results);
+
+/** Flags for cgroup_migrate_all(). */
+enum cgroup_migrate_flag {
+	/**
+	 * Freeze the source group while its tasks are moved, so that new
+	 * tasks can't be forked into it.  Only the cgroup v2 hierarchy can
+	 * be frozen, the other hierarchies are migrated without freezing.
+	 */
+	CGFLAG_MIGRATE_FREEZE = 1,
+};
+
+/**
+ * Move all the tasks of a group to another group.  In every hierarchy of
+ * src, the task list of src is read and each task is written to the opened
+ * destination file, again until src is empty, so that the tasks forked
+ * meanwhile are moved too.
+ *
+ * @param src Source control group, its controllers select the hierarchies.
+ * @param dst Destination control group.  Only its name is used, it must
+ *	exist in all the hierarchies of src.
+ * @param flags Bit flags, as defined in enum #cgroup_migrate_flag.
+ * @return 0 on success, #ECGNONEMPTY if src keeps being populated.
+ */
+int cgroup_migrate_all(struct cgroup *src, struct cgroup *dst, int flags);
+
 /**
  * Changes the cgroup of a task based on the path provided.  In this case,
  * the user must already know into which cgroup the task should be placed and
@@ -71,6 +122,28 @@ int cgroup_attach_task_pid(struct cgroup *cgrp, pid_t tid);
  */
 int cgroup_change_cgroup_path(const char *path, pid_t pid, const char * const controllers[]);
 
+/**
+ * Create a child process directly in the cgroup given by path, using
+ * clone3() with CLONE_INTO_CGROUP.  Unlike cgroup_change_cgroup_path() after
+ * fork(), neither the parent nor the child is ever migrated.
+ *
+ * This requires a cgroup v2 destination, i.e. all the controllers must be
+ * in the unified hierarchy, and kernel 5.7 or newer.  Like after fork() in
+ * a multithreaded program, the child should only call async-signal-safe
+ * functions until it calls exec.
+ *
+ * @param path Name of the destination group.
+ * @param controllers List of controllers, may be NULL on cgroup v2 systems.
+ * @param pid Receives the pid of the child in the parent and 0 in the
+ *	child.
+ * @return 0 in both the parent and the child on success.  #ECGROUPUNSUPP
+ *	if the destination or the kernel doesn't support CLONE_INTO_CGROUP,
+ *	the caller can then fall back to fork() and
+ *	cgroup_change_cgroup_path().
+ */
+int cgroup_clone_into_cgroup_path(const char *path, const char * const controllers[],
+				  pid_t *pid);
+
 /**
  * Get the current control group path where the given task is.
  * @param pid The task to find.
@@ -127,7 +200,10 @@ void cgroup_print_rules_config(FILE *fp);
  * group.
  *
  * This function may be called after creating new control groups to move
- * running PIDs into the newly created control groups.
+ * running PIDs into the newly created control groups.  The PIDs are moved
+ * in batches, see cgroup_migrator_create().  The environment variable
+ * CGROUP_MIGRATE_RATE, in the form <tt>rate[:burst]</tt>, limits the
+ * number of moves per second.
  *	@return 0 on success, < 0 on error
  */
 int cgroup_change_all_cgroups(void);
@@ -179,6 +255,91 @@ int cgroup_change_cgroup_uid_gid_flags(uid_t uid, gid_t gid, pid_t pid, int flag
  */
 int cgroup_change_cgroup_uid_gid(uid_t uid, gid_t gid, pid_t pid);
 
+/**
+ * @}
+ * @name Batched migration
+ * @{
+ * Moving many tasks one by one with the functions above takes the kernel's
+ * global cgroup lock for every task back to back, which stalls forks and
+ * cgroup operations of unrelated processes.  A <tt>struct
+ * cgroup_migrator*</tt> queues the moves, groups them by destination so that
+ * every destination is resolved and opened once, and optionally paces them
+ * with a token bucket.
+ *
+ * A migrator must not be used by several threads at once.
+ */
+struct cgroup_migrator;
+
+/** Statistics of a cgroup_migrator, accumulated over all its flushes. */
+struct cgroup_migrator_stats {
+	/** Number of tasks moved. */
+	unsigned long moved;
+	/** Number of tasks that failed to move, e.g. because they exited. */
+	unsigned long failed;
+	/** Number of destination batches flushed. */
+	unsigned long batches;
+	/** Moves per second achieved by cgroup_migrator_flush(). */
+	double moves_per_sec;
+	/** Average time between queueing and moving a task, in microseconds. */
+	unsigned long avg_latency_us;
+	/** Maximum time between queueing and moving a task, in microseconds. */
+	unsigned long max_latency_us;
+};
+
+/**
+ * Create a migrator.
+ * @param rate Maximum number of moves per second, 0 for no limit.
+ * @param burst Number of moves allowed back to back before the rate applies,
+ *	at least 1.
+ * @param migrator The new migrator.  Use cgroup_migrator_free() to free it.
+ */
+int cgroup_migrator_create(unsigned int rate, unsigned int burst,
+			   struct cgroup_migrator **migrator);
+
+/**
+ * Queue the move of a process and all its threads, like
+ * cgroup_change_cgroup_path() does.  Nothing is moved before
+ * cgroup_migrator_flush().
+ * @param migrator
+ * @param path Name of the destination group.
+ * @param controllers List of controllers, may be NULL on cgroup v2 systems.
+ * @param pid The process to move.
+ */
+int cgroup_migrator_add(struct cgroup_migrator *migrator, const char *path,
+			const char * const controllers[], pid_t pid);
+
+/**
+ * Queue the move of a process to the group given by the rules in the
+ * config file, see cgroup_change_cgroup_flags() for the parameters.  Groups
+ * of template rules are created right away, the process is moved by
+ * cgroup_migrator_flush().
+ */
+int cgroup_migrator_classify(struct cgroup_migrator *migrator, uid_t uid, gid_t gid,
+			     const char *procname, pid_t pid, int flags);
+
+/**
+ * Move all the queued processes, one destination after the other.  A
+ * process that fails to move doesn't stop the others.
+ * @param migrator
+ * @return 0 if all processes were moved, the error of the first failure
+ *	otherwise.
+ */
+int cgroup_migrator_flush(struct cgroup_migrator *migrator);
+
+/**
+ * Get the statistics of the migrator.
+ * @param migrator
+ * @param stats Receives the statistics.
+ */
+int cgroup_migrator_get_stats(const struct cgroup_migrator *migrator,
+			      struct cgroup_migrator_stats *stats);
+
+/**
+ * Free the migrator, the processes still queued are not moved.
+ * @param migrator The migrator, set to NULL.
+ */
+void cgroup_migrator_free(struct cgroup_migrator **migrator);
+
 /**
  * @}
  * @name Communication with cgrulesengd daemon
@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+/*
+ * Microbenchmark for cg_build_path_locked()
+ *
+ * Builds the path of a cgroup for every mounted controller in a tight loop
+ * and reports the average cost of a single call.
+ *
+ * Usage: build_path_bench [cgroup name] [iterations]
+ */
+#include "../src/libcgroup-internal.h"
+#include <libcgroup.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#define DEFAULT_ITERATIONS	1000000
+
+static double elapsed_ns(const struct timespec * const start, const struct timespec * const end)
+{
+	return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
+
+int main(int argc, char *argv[])
+{
+	char *controllers[CG_CONTROLLER_MAX];
+	struct timespec start, end;
+	const char *name = "bench/a/b";
+	long iterations = DEFAULT_ITERATIONS;
+	char path[FILENAME_MAX];
+	int ctrl_cnt = 0;
+	long i;
+	int ret;
+	int j;
+
+	if (argc > 1)
+		name = argv[1];
+	if (argc > 2)
+		iterations = atol(argv[2]);
+
+	ret = cgroup_init();
+	if (ret) {
+		fprintf(stderr, "cgroup_init failed: %s\n", cgroup_strerror(ret));
+		exit(1);
+	}
+
+	pthread_rwlock_rdlock(&cg_mount_table_lock);
+	for (j = 0; j < CG_CONTROLLER_MAX && cg_mount_table[j].name[0] != '\0'; j++)
+		controllers[ctrl_cnt++] = cg_mount_table[j].name;
+
+	if (ctrl_cnt == 0) {
+		fprintf(stderr, "no controllers are mounted\n");
+		exit(1);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < iterations; i++) {
+		if (!cg_build_path_locked(name, path, controllers[i % ctrl_cnt])) {
+			fprintf(stderr, "cg_build_path_locked failed for %s\n",
+				controllers[i % ctrl_cnt]);
+			exit(1);
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	pthread_rwlock_unlock(&cg_mount_table_lock);
+
+	printf("%ld calls over %d controllers, last path %s\n", iterations, ctrl_cnt, path);
+	printf("%.1f ns/call\n", elapsed_ns(&start, &end) / iterations);
+
+	return 0;
+}
@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+/*
+ * Benchmark of the stats readers
+ *
+ * Reads the memory.stat file of a cgroup with cgroup_read_stats_begin() and
+ * strtoull(), then with cgroup_read_stats_typed(), and reports the average
+ * cost of a whole file for both.
+ *
+ * Usage: stats_bench [cgroup name] [iterations]
+ */
+#include <libcgroup.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#define DEFAULT_ITERATIONS	100000
+
+static double elapsed_ns(const struct timespec * const start, const struct timespec * const end)
+{
+	return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
+
+int main(int argc, char *argv[])
+{
+	long iterations = DEFAULT_ITERATIONS;
+	struct cgroup_stats stats = {};
+	struct timespec start, end;
+	struct cgroup_stat stat;
+	const char *name = "/";
+	u_int64_t sum = 0;
+	void *handle;
+	long i;
+	int ret;
+
+	if (argc > 1)
+		name = argv[1];
+	if (argc > 2)
+		iterations = atol(argv[2]);
+
+	ret = cgroup_init();
+	if (ret) {
+		fprintf(stderr, "cgroup_init failed: %s\n", cgroup_strerror(ret));
+		exit(1);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < iterations; i++) {
+		ret = cgroup_read_stats_begin("memory", name, &handle, &stat);
+		while (ret == 0) {
+			sum += strtoull(stat.value, NULL, 10);
+			ret = cgroup_read_stats_next(&handle, &stat);
+		}
+		cgroup_read_stats_end(&handle);
+
+		if (ret != ECGEOF) {
+			fprintf(stderr, "cannot read memory.stat of %s: %s\n", name,
+				cgroup_strerror(ret));
+			exit(1);
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("cgroup_read_stats_*:     %8.0f ns/file\n", elapsed_ns(&start, &end) / iterations);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < iterations; i++) {
+		ret = cgroup_read_stats_typed("memory", name, "memory.stat", &stats);
+		if (ret) {
+			fprintf(stderr, "cannot read memory.stat of %s: %s\n", name,
+				cgroup_strerror(ret));
+			exit(1);
+		}
+		sum += stats.entries[0].value;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("cgroup_read_stats_typed: %8.0f ns/file, %d values\n",
+	       elapsed_ns(&start, &end) / iterations, stats.cnt);
+
+	cgroup_stats_free(&stats);
+
+	/* Keep the reads from being optimized out */
+	return sum == 0 ? 1 : 0;
+}
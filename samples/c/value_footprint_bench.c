@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+/*
+ * Memory benchmark for the storage of the setting values
+ *
+ * Reads a cgroup with cgroup_get_cgroup() a number of times, keeps all the
+ * copies and reports the heap used per setting value.  The footprint of the
+ * former layout, with the name and value buffers embedded in every value,
+ * is computed for comparison.
+ *
+ * Usage: value_footprint_bench [cgroup name] [copies]
+ */
+#include "../src/libcgroup-internal.h"
+#include <libcgroup.h>
+
+#include <malloc.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#define DEFAULT_COPIES	1000
+
+/* struct control_value before the names were interned */
+struct old_control_value {
+	char name[FILENAME_MAX];
+	char value[CG_CONTROL_VALUE_MAX];
+	char *multiline_value;
+	char *prev_name;
+	bool dirty;
+};
+
+int main(int argc, char *argv[])
+{
+	long copies = DEFAULT_COPIES;
+	struct cgroup **cgrps;
+	const char *name = "/";
+	size_t before, after;
+	long value_cnt = 0;
+	double old_bytes;
+	long i;
+	int ret;
+	int j;
+
+	if (argc > 1)
+		name = argv[1];
+	if (argc > 2)
+		copies = atol(argv[2]);
+
+	ret = cgroup_init();
+	if (ret) {
+		fprintf(stderr, "cgroup_init failed: %s\n", cgroup_strerror(ret));
+		exit(1);
+	}
+
+	cgrps = calloc(copies, sizeof(*cgrps));
+	if (!cgrps) {
+		fprintf(stderr, "not enough memory\n");
+		exit(1);
+	}
+
+	before = mallinfo2().uordblks;
+	for (i = 0; i < copies; i++) {
+		cgrps[i] = cgroup_new_cgroup(name);
+		if (!cgrps[i]) {
+			fprintf(stderr, "not enough memory\n");
+			exit(1);
+		}
+
+		ret = cgroup_get_cgroup(cgrps[i]);
+		if (ret) {
+			fprintf(stderr, "cgroup_get_cgroup failed for %s: %s\n", name,
+				cgroup_strerror(ret));
+			exit(1);
+		}
+
+		for (j = 0; j < cgrps[i]->index; j++)
+			value_cnt += cgrps[i]->controller[j]->index;
+	}
+	after = mallinfo2().uordblks;
+
+	if (value_cnt == 0) {
+		fprintf(stderr, "%s has no settings\n", name);
+		exit(1);
+	}
+
+	/*
+	 * Only the values differ, everything else is the same in both layouts.
+	 * The arena chunks are counted in both, which slightly favors the new
+	 * layout.
+	 */
+	old_bytes = (double)(after - before) + value_cnt *
+		((double)sizeof(struct old_control_value) - sizeof(struct control_value));
+
+	printf("%ld copies of %s, %ld values\n", copies, name, value_cnt);
+	printf("now: %.1f MiB, %.1f bytes/value\n", (after - before) / 1048576.0,
+	       (double)(after - before) / value_cnt);
+	printf("old: %.1f MiB, %.1f bytes/value\n", old_bytes / 1048576.0,
+	       old_bytes / value_cnt);
+
+	for (i = 0; i < copies; i++)
+		cgroup_free(&cgrps[i]);
+	free(cgrps);
+
+	return 0;
+}
@@ -129,7 +129,7 @@ int cgroup_convert_cpu_quota_to_max(struct cgroup_controller * const dst_cgc,
 			goto out;
 	}
 
-	dst_cgc->values[dst_cgc->index - 1]->prev_name = strdup(CFS_QUOTA_US);
+	dst_cgc->values[dst_cgc->index - 1]->prev_name = cg_intern_name(CFS_QUOTA_US);
 
 out:
 	if (period)
@@ -165,7 +165,7 @@ int cgroup_convert_cpu_period_to_max(struct cgroup_controller * const dst_cgc,
 			goto out;
 	}
 
-	dst_cgc->values[dst_cgc->index - 1]->prev_name = strdup(CFS_PERIOD_US);
+	dst_cgc->values[dst_cgc->index - 1]->prev_name = cg_intern_name(CFS_PERIOD_US);
 
 out:
 	if (quota)
@@ -28,6 +28,8 @@
 #include <unistd.h>
 #include <mntent.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <signal.h>
 #include <string.h>
 #include <libgen.h>
 #include <assert.h>
@@ -35,9 +37,11 @@
 #include <stdio.h>
 #include <fcntl.h>
 #include <ctype.h>
+#include <poll.h>
 #include <fts.h>
 #include <pwd.h>
 #include <grp.h>
+#include <time.h>
 
 #include <sys/syscall.h>
 #include <sys/socket.h>
@@ -69,6 +73,26 @@ static __thread char errtext[MAXLEN];
 /* Check if cgroup_init has been called or not. */
 static int cgroup_initialized;
 
+/*
+ * Watch on the mount table the cg_mount_table was built from.  The kernel
+ * flags an open /proc/self/mounts with POLLPRI whenever a filesystem is
+ * mounted or unmounted in its mount namespace.
+ */
+static struct {
+	int fd;
+	/* The process that opened fd, and the file fd was opened on */
+	pid_t pid;
+	dev_t dev;
+	ino_t ino;
+	dev_t ns_dev;
+	ino_t ns_ino;
+	/* A change was seen since cg_mount_table was built */
+	bool changed;
+} cg_mounts_watch = { .fd = -1 };
+
+/* Lock for cg_mounts_watch */
+static pthread_mutex_t cg_mounts_watch_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /* List of configuration rules */
 static struct cgroup_rule_list rl;
 
@@ -1415,6 +1439,72 @@ out:
 	return ret;
 }
 
+/*
+ * Append len bytes of src to path, which currently holds path_len bytes.
+ * The path is truncated at FILENAME_MAX - 1 bytes and always terminated.
+ * Returns the new length of the path.
+ */
+static int cg_path_append(char *path, int path_len, const char *src, size_t len)
+{
+	if (path_len + len > FILENAME_MAX - 1)
+		len = FILENAME_MAX - 1 - path_len;
+
+	memcpy(path + path_len, src, len);
+	path_len += len;
+	path[path_len] = '\0';
+
+	return path_len;
+}
+
+/*
+ * Compute the path prefix of a hierarchy mounted at mount_path, i.e.
+ * "<mount_path>/<systemd_default_cgroup>/"
+ */
+static void cg_set_path_prefix(struct cg_path_prefix *prefix, const char *mount_path)
+{
+	int len;
+
+	len = cg_path_append(prefix->path, 0, mount_path, strlen(mount_path));
+	len = cg_path_append(prefix->path, len, "/", 1);
+	prefix->mnt_len = len;
+
+#ifdef WITH_SYSTEMD
+	if (systemd_default_cgroup[0] != '\0') {
+		len = cg_path_append(prefix->path, len, systemd_default_cgroup,
+				     strlen(systemd_default_cgroup));
+		len = cg_path_append(prefix->path, len, "/", 1);
+	}
+#endif
+	if (len >= FILENAME_MAX - 1)
+		cgroup_dbg("filename too long: %s", prefix->path);
+
+	prefix->len = len;
+}
+
+/* Path prefix of cg_cgroup_v2_mount_path, protected by cg_mount_table_lock */
+static struct cg_path_prefix cg_cgroup_v2_prefix;
+
+/* Call with cg_mount_table_lock write-locked */
+static void cgroup_set_cg_mnt_tbl_prefixes(void)
+{
+	int i;
+
+	for (i = 0; i < CG_CONTROLLER_MAX && cg_mount_table[i].name[0] != '\0'; i++)
+		cg_set_path_prefix(&cg_mount_table[i].prefix, cg_mount_table[i].mount.path);
+
+	if (strlen(cg_cgroup_v2_mount_path) > 0)
+		cg_set_path_prefix(&cg_cgroup_v2_prefix, cg_cgroup_v2_mount_path);
+	else
+		memset(&cg_cgroup_v2_prefix, 0, sizeof(cg_cgroup_v2_prefix));
+}
+
+void cg_refresh_mount_prefixes(void)
+{
+	pthread_rwlock_wrlock(&cg_mount_table_lock);
+	cgroup_set_cg_mnt_tbl_prefixes();
+	pthread_rwlock_unlock(&cg_mount_table_lock);
+}
+
 /*
  * Free global variables filled by previous cgroup_init(). This function
  * should be called with cg_mount_table_lock taken.
@@ -1436,6 +1526,7 @@ static void cgroup_free_cg_mount_table(void)
 
 	memset(&cg_mount_table, 0, sizeof(cg_mount_table));
 	memset(&cg_cgroup_v2_mount_path, 0, sizeof(cg_cgroup_v2_mount_path));
+	memset(&cg_cgroup_v2_prefix, 0, sizeof(cg_cgroup_v2_prefix));
 	memset(&cg_cgroup_v2_empty_mount_paths, 0, sizeof(cg_cgroup_v2_empty_mount_paths));
 }
 
@@ -1678,6 +1769,101 @@ err:
 	return ret;
 }
 
+/*
+ * Returns true if cg_mounts_watch.fd is still the file it was opened on.
+ * The application may have closed it, e.g. while daemonizing, and the
+ * number may now be one of its own files.
+ */
+static bool cg_mounts_watch_fd_valid(void)
+{
+	struct stat st;
+
+	if (cg_mounts_watch.fd < 0 || fstat(cg_mounts_watch.fd, &st))
+		return false;
+
+	return st.st_dev == cg_mounts_watch.dev && st.st_ino == cg_mounts_watch.ino;
+}
+
+/*
+ * Start watching the mount table of the current mount namespace.  Must be
+ * called before the mount table is read, so that no change is missed.
+ */
+static void cg_mounts_watch_start(void)
+{
+	struct stat st, ns_st;
+
+	pthread_mutex_lock(&cg_mounts_watch_lock);
+
+	/* A forked child closes its copy, the parent keeps its own */
+	if (cg_mounts_watch_fd_valid())
+		close(cg_mounts_watch.fd);
+
+	cg_mounts_watch.changed = false;
+	cg_mounts_watch.fd = open("/proc/self/mounts", O_RDONLY | O_CLOEXEC);
+	if (cg_mounts_watch.fd < 0 || fstat(cg_mounts_watch.fd, &st) ||
+	    stat("/proc/self/ns/mnt", &ns_st)) {
+		cg_mounts_watch.changed = true;
+	} else {
+		cg_mounts_watch.pid = getpid();
+		cg_mounts_watch.dev = st.st_dev;
+		cg_mounts_watch.ino = st.st_ino;
+		cg_mounts_watch.ns_dev = ns_st.st_dev;
+		cg_mounts_watch.ns_ino = ns_st.st_ino;
+	}
+
+	pthread_mutex_unlock(&cg_mounts_watch_lock);
+}
+
+/* Force the next cgroup_init() to rebuild the mount table */
+static void cg_mounts_watch_invalidate(void)
+{
+	pthread_mutex_lock(&cg_mounts_watch_lock);
+	cg_mounts_watch.changed = true;
+	pthread_mutex_unlock(&cg_mounts_watch_lock);
+}
+
+/*
+ * Returns true if the mount table may have changed since cg_mount_table
+ * was built, i.e. if a filesystem was (un)mounted or if the process moved
+ * to another mount namespace.
+ */
+static bool cg_mounts_changed(void)
+{
+	struct pollfd pfd;
+	struct stat st;
+	bool changed;
+
+	pthread_mutex_lock(&cg_mounts_watch_lock);
+
+	/*
+	 * A forked child shares the open file, and so its events, with the
+	 * parent.  It can't know what the parent consumed, the table is
+	 * rebuilt with a watch of its own.
+	 */
+	if (!cg_mounts_watch.changed &&
+	    (cg_mounts_watch.pid != getpid() || !cg_mounts_watch_fd_valid()))
+		cg_mounts_watch.changed = true;
+
+	if (!cg_mounts_watch.changed) {
+		pfd.fd = cg_mounts_watch.fd;
+		pfd.events = POLLPRI;
+		pfd.revents = 0;
+
+		/* The event is consumed by poll(), remember it */
+		if (poll(&pfd, 1, 0) != 0)
+			cg_mounts_watch.changed = true;
+		else if (stat("/proc/self/ns/mnt", &st) || st.st_dev != cg_mounts_watch.ns_dev ||
+			 st.st_ino != cg_mounts_watch.ns_ino)
+			cg_mounts_watch.changed = true;
+	}
+
+	changed = cg_mounts_watch.changed;
+
+	pthread_mutex_unlock(&cg_mounts_watch_lock);
+
+	return changed;
+}
+
 /**
  * cgroup_init(), initializes the MOUNT_POINT.
  *
@@ -1688,13 +1874,31 @@ err:
 int cgroup_init(void)
 {
 	static char *controllers[CG_CONTROLLER_MAX];
+	bool unchanged;
 	int ret = 0;
 	int i;
 
 	cgroup_set_default_logger(-1);
 
+	/*
+	 * Nothing to do if nothing was (un)mounted since the last
+	 * cgroup_init(), the readers of the table aren't blocked to find out.
+	 */
+	pthread_rwlock_rdlock(&cg_mount_table_lock);
+	unchanged = cgroup_initialized && !cg_mounts_changed();
+	pthread_rwlock_unlock(&cg_mount_table_lock);
+
+	if (unchanged)
+		return 0;
+
 	pthread_rwlock_wrlock(&cg_mount_table_lock);
 
+	/* Another thread may have rebuilt the table meanwhile */
+	if (cgroup_initialized && !cg_mounts_changed())
+		goto unlock_exit;
+
+	cg_mounts_watch_start();
+
 	/* Free global variables filled by previous cgroup_init() */
 	cgroup_free_cg_mount_table();
 
@@ -1706,9 +1910,14 @@ int cgroup_init(void)
 	if (ret)
 		goto unlock_exit;
 
+	cgroup_set_cg_mnt_tbl_prefixes();
+
 	cgroup_initialized = 1;
 
 unlock_exit:
+	if (ret)
+		cg_mounts_watch_invalidate();
+
 	for (i = 0; controllers[i]; i++) {
 		free(controllers[i]);
 		controllers[i] = NULL;
@@ -1727,6 +1936,10 @@ static int cg_test_mounted_fs(void)
 	FILE *proc_mount = NULL;
 	int ret = 1;
 
+	/* cgroup_init() found cgroup mounts and nothing changed since */
+	if (cgroup_initialized && !cg_mounts_changed())
+		return 1;
+
 	proc_mount = fopen("/proc/self/mounts", "re");
 	if (proc_mount == NULL)
 		return 0;
@@ -1764,96 +1977,82 @@ static inline pid_t cg_gettid(void)
 	return syscall(__NR_gettid);
 }
 
-static char *cg_concat_path(const char *pref, const char *suf, char *path)
-{
-	if ((suf[strlen(suf)-1] == '/') || ((strlen(suf) == 0) && (pref[strlen(pref)-1] == '/')))
-		snprintf(path, FILENAME_MAX, "%s%s", pref, suf+((suf[0] == '/') ? 1 : 0));
-	else
-		snprintf(path, FILENAME_MAX, "%s%s/", pref, suf+((suf[0] == '/') ? 1 : 0));
-
-	path[FILENAME_MAX-1] = '\0';
-
-	return path;
-}
-
-/* Call with cg_mount_table_lock taken */
-/* path value have to have size at least FILENAME_MAX */
-char *cg_build_path_locked(const char *name, char *path, const char *type)
+/*
+ * Assemble <prefix><namespace>/<name>/ into path.  The prefix is copied
+ * as is from the mount table, so no allocation or formatting is required.
+ */
+static char *cg_build_path_prefix(const struct cg_path_prefix *prefix, const char *mount_path,
+				  const char *namespace, const char *name, char *path)
 {
-	char *tmp_systemd_default_cgrp, *_path = NULL;
-	/*
-	 * len is the allocation size for path, that stores:
-	 * cg_mount_table[i].mount.path + '/' + cg_namespace_table[i] + '/'
-	 */
-	int i, ret, len = (FILENAME_MAX * 2) + 2;
+	struct cg_path_prefix tmp_prefix;
+	size_t name_len;
+	bool trailing;
+	int len;
 
-	/*
-	 * systemd_default_cgroup can't be clobbered.   The user may pass
-	 * multiple cgroups, hence use temporary variable for manipulations
-	 * for example:
-	 * cgget -g cpu:/ -g cpu:cgrp1 -g cpu:/cgrp2
-	 */
-	tmp_systemd_default_cgrp = calloc(1, (sizeof(char) * len));
-	if (!tmp_systemd_default_cgrp) {
-		cgroup_err("Failed to allocate memory for tmp_systemd_default_cgroup\n");
-		goto out;
+	if (prefix->len == 0) {
+		/*
+		 * The prefixes are published by cgroup_init().  Compute it
+		 * on the stack if the mount table was populated by other
+		 * means, e.g. by the unit tests.
+		 */
+		cg_set_path_prefix(&tmp_prefix, mount_path);
+		prefix = &tmp_prefix;
 	}
 
-#ifdef WITH_SYSTEMD
 	/*
 	 * If the user specifies the name as /<cgroup-name>, they are
 	 * effectively overriding the systemd_default_cgroup but if the name
 	 * is "/", the cgroup root path is systemd_default_cgroup
 	 */
-	if (strlen(systemd_default_cgroup) && name && name[0] == '/' && name[1] != '\0')
-		tmp_systemd_default_cgrp[0] = '\0';
+	if (name && name[0] == '/' && name[1] != '\0')
+		len = cg_path_append(path, 0, prefix->path, prefix->mnt_len);
 	else
-		snprintf(tmp_systemd_default_cgrp, len, "%s/", systemd_default_cgroup);
+		len = cg_path_append(path, 0, prefix->path, prefix->len);
 
-	/* allocate more space for systemd_default_cgroup + '/' */
-	len += (FILENAME_MAX + 1);
-#endif
-	/*
-	 * Recent gcc are unhappy when sizeof(dest) <= sizeof(src) with
-	 * snprintf()'s.  Alternative is to use multiple strncpy()/strcat(),
-	 * work around it by allocating large temporary buffer _path and
-	 * copying the constructed _path into path.
-	 */
-	_path = malloc(len);
-	if (!_path) {
-		cgroup_err("Failed to allocate memory for _path\n");
-		goto out;
+	if (namespace) {
+		len = cg_path_append(path, len, namespace, strlen(namespace));
+		len = cg_path_append(path, len, "/", 1);
+	}
+
+	if (!name)
+		return path;
+
+	name_len = strlen(name);
+	if (name_len > 0)
+		trailing = (name[name_len - 1] == '/');
+	else
+		trailing = (path[len - 1] == '/');
+
+	if (name[0] == '/') {
+		name++;
+		name_len--;
 	}
 
+	len = cg_path_append(path, len, name, name_len);
+	if (!trailing)
+		len = cg_path_append(path, len, "/", 1);
+
+	if (len >= FILENAME_MAX - 1)
+		cgroup_dbg("filename too long: %s", path);
+
+	return path;
+}
+
+/* Call with cg_mount_table_lock taken */
+/* path value have to have size at least FILENAME_MAX */
+char *cg_build_path_locked(const char *name, char *path, const char *type)
+{
+	int i;
+
 	/*
 	 * If no type is specified, and there's a valid cgroup v2 mount, then
 	 * build up a path to this mount (and cgroup name if supplied).
 	 * This can be used to create a cgroup v2 cgroup that's not attached to
 	 * any controller.
 	 */
-	if (!type && strlen(cg_cgroup_v2_mount_path) > 0) {
-		ret = snprintf(_path, len, "%s/%s", cg_cgroup_v2_mount_path,
-			       tmp_systemd_default_cgrp);
-		if (ret >= FILENAME_MAX)
-			cgroup_dbg("filename too long: %s", _path);
-
-		strncpy(path, _path, FILENAME_MAX - 1);
-		path[FILENAME_MAX - 1] = '\0';
-
-		if (name) {
-			char *tmp;
-
-			tmp = strdup(path);
-			if (tmp == NULL) {
-				path = NULL;
-				goto out;
-			}
-
-			cg_concat_path(tmp, name, path);
-			free(tmp);
-		}
-		goto out;
-	}
+	if (!type && strlen(cg_cgroup_v2_mount_path) > 0)
+		return cg_build_path_prefix(&cg_cgroup_v2_prefix, cg_cgroup_v2_mount_path, NULL,
+					    name, path);
 
 	for (i = 0; cg_mount_table[i].name[0] != '\0'; i++) {
 		/* Two ways to successfully move forward here:
@@ -1864,53 +2063,114 @@ char *cg_build_path_locked(const char *name, char *path, const char *type)
 		 */
 		if ((type && strcmp(cg_mount_table[i].name, type) == 0) ||
 		    (type && strcmp(type, CGRP_FILE_PREFIX) == 0 &&
-		     cg_mount_table[i].version == CGROUP_V2)) {
+		     cg_mount_table[i].version == CGROUP_V2))
+			return cg_build_path_prefix(&cg_mount_table[i].prefix,
+						    cg_mount_table[i].mount.path,
+						    cg_namespace_table[i], name, path);
+	}
+
+	return NULL;
+}
 
-			if (cg_namespace_table[i])
-				ret = snprintf(_path, len, "%s/%s%s/", cg_mount_table[i].mount.path,
-					       tmp_systemd_default_cgrp, cg_namespace_table[i]);
-			else
-				ret = snprintf(_path, len, "%s/%s", cg_mount_table[i].mount.path,
-					       tmp_systemd_default_cgrp);
+char *cg_build_path(const char *name, char *path, const char *type)
+{
+	pthread_rwlock_rdlock(&cg_mount_table_lock);
+	path = cg_build_path_locked(name, path, type);
+	pthread_rwlock_unlock(&cg_mount_table_lock);
 
-			if (ret >= FILENAME_MAX)
-				cgroup_dbg("filename too long: %s", _path);
+	return path;
+}
 
-			strncpy(path, _path, FILENAME_MAX - 1);
-			path[FILENAME_MAX - 1] = '\0';
+bool cg_initialized(void)
+{
+	return cgroup_initialized;
+}
 
-			if (name) {
-				char *tmp;
+int cg_namespace_table_dup(char *table[CG_CONTROLLER_MAX])
+{
+	int i;
 
-				tmp = strdup(path);
-				if (tmp == NULL)
-					break;
+	memset(table, 0, CG_CONTROLLER_MAX * sizeof(*table));
 
-				cg_concat_path(tmp, name, path);
-				free(tmp);
-			}
-			goto out;
+	for (i = 0; i < CG_CONTROLLER_MAX; i++) {
+		if (!cg_namespace_table[i])
+			continue;
+
+		table[i] = strdup(cg_namespace_table[i]);
+		if (!table[i]) {
+			last_errno = errno;
+			cg_namespace_table_free(table);
+			return ECGOTHER;
 		}
 	}
-	path = NULL;
 
-out:
-	if (_path)
-		free(_path);
+	return 0;
+}
 
-	if (tmp_systemd_default_cgrp)
-		free(tmp_systemd_default_cgrp);
+void cg_namespace_table_free(char *table[CG_CONTROLLER_MAX])
+{
+	int i;
 
-	return path;
+	for (i = 0; i < CG_CONTROLLER_MAX; i++) {
+		free(table[i]);
+		table[i] = NULL;
+	}
 }
 
-char *cg_build_path(const char *name, char *path, const char *type)
+/* Call with cg_mount_table_lock taken */
+int cg_open_cgroup_file_locked(const char *name, const char *type, const char *file,
+			       int flags)
+{
+	char path[FILENAME_MAX];
+	int len;
+
+	if (!cg_build_path_locked(name, path, type)) {
+		errno = ENODEV;
+		return -1;
+	}
+
+	len = strlen(path);
+	if (file)
+		len = cg_path_append(path, len, file, strlen(file));
+	else
+		flags |= O_DIRECTORY;
+
+	if (len >= FILENAME_MAX - 1) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	return open(path, flags | O_CLOEXEC);
+}
+
+int cg_open_cgroup_file(const char *name, const char *type, const char *file, int flags)
 {
+	int fd;
+
 	pthread_rwlock_rdlock(&cg_mount_table_lock);
-	path = cg_build_path_locked(name, path, type);
+	fd = cg_open_cgroup_file_locked(name, type, file, flags);
 	pthread_rwlock_unlock(&cg_mount_table_lock);
 
-	return path;
+	return fd;
+}
+
+FILE *cg_fopenat(int dirfd, const char *file, const char *mode)
+{
+	int fd, saved_errno;
+	FILE *fp;
+
+	fd = openat(dirfd, file, (mode[0] == 'w' ? O_WRONLY : O_RDONLY) | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+
+	fp = fdopen(fd, mode);
+	if (!fp) {
+		saved_errno = errno;
+		close(fd);
+		errno = saved_errno;
+	}
+
+	return fp;
 }
 
 static int cgroup_get_cg_type(const char * const path, char * const type,
@@ -2064,46 +2324,6 @@ err:
 	return error;
 }
 
-static int __cgroup_attach_task_pid(char *path, pid_t tid)
-{
-	FILE *tasks = NULL;
-	int ret = 0;
-
-	tasks = fopen(path, "we");
-	if (!tasks) {
-		switch (errno) {
-		case EPERM:
-			ret = ECGROUPNOTOWNER;
-			break;
-		case ENOENT:
-			ret = ECGROUPNOTEXIST;
-			break;
-		default:
-			ret = ECGROUPNOTALLOWED;
-		}
-		goto err;
-	}
-	ret = fprintf(tasks, "%d", tid);
-	if (ret < 0) {
-		last_errno = errno;
-		ret = ECGOTHER;
-		goto err;
-	}
-	ret = fflush(tasks);
-	if (ret) {
-		last_errno = errno;
-		ret = ECGOTHER;
-		goto err;
-	}
-	fclose(tasks);
-	return 0;
-err:
-	cgroup_warn("cannot write tid %d to %s:%s\n", tid, path, strerror(errno));
-	if (tasks)
-		fclose(tasks);
-	return ret;
-}
-
 static int cgroup_build_tid_path(const char * const ctrl_name, char *path)
 {
 	char cg_type[CGV2_CONTROLLERS_LL_MAX];
@@ -2147,38 +2367,75 @@ static int cgroup_build_tid_path(const char * const ctrl_name, char *path)
 	return ret;
 }
 
-static int cgroup_attach_task_tid(struct cgroup *cgrp, pid_t tid, bool move_tids)
+/* Destination file of an attach operation in one hierarchy */
+struct cg_attach_dest {
+	char path[FILENAME_MAX];
+	/* Opened on the first write and reused for the following tasks */
+	int fd;
+	/* Writing a pid to cgroup.procs moves all the threads of the process */
+	bool whole_process;
+};
+
+/*
+ * Destination of an attach operation, i.e. the tasks, cgroup.procs or
+ * cgroup.threads file of every hierarchy of the cgroup.  It is resolved
+ * once per operation, so that attaching several tasks doesn't re-read
+ * cgroup.type and the parent's cgroup.subtree_control for every task.
+ */
+struct cg_attach_plan {
+	struct cg_attach_dest *dests;
+	int cnt;
+};
+
+static void cg_attach_plan_free(struct cg_attach_plan *plan)
 {
-	char path[FILENAME_MAX] = {0};
-	char *controller_name = NULL;
-	int empty_cgrp = 0;
-	int i, ret = 0;
+	int i;
 
-	if (!cgroup_initialized) {
-		cgroup_warn("libcgroup is not initialized\n");
-		return ECGROUPNOTINITIALIZED;
+	for (i = 0; i < plan->cnt; i++) {
+		if (plan->dests[i].fd >= 0)
+			close(plan->dests[i].fd);
 	}
 
-	/* if the cgroup is NULL, attach the task to the root cgroup. */
-	if (!cgrp) {
-		pthread_rwlock_rdlock(&cg_mount_table_lock);
-		for (i = 0; i < CG_CONTROLLER_MAX && cg_mount_table[i].name[0] != '\0'; i++) {
-			ret = cgroup_build_tasks_procs_path(path, sizeof(path), NULL,
-							    cg_mount_table[i].name);
-			if (ret)
-				return ret;
+	free(plan->dests);
+	plan->dests = NULL;
+	plan->cnt = 0;
+}
 
-			if (move_tids) {
-				ret = cgroup_build_tid_path(controller_name, path);
-				if (ret)
-					return ret;
-			}
+static bool cg_attach_plan_has_path(const struct cg_attach_plan *plan, const char *path)
+{
+	int i;
 
-			ret = __cgroup_attach_task_pid(path, tid);
-			if (ret) {
-				pthread_rwlock_unlock(&cg_mount_table_lock);
-				return ret;
-			}
+	for (i = 0; i < plan->cnt; i++) {
+		if (strcmp(plan->dests[i].path, path) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Resolve the destination files of the cgroup cgrp, or of the root cgroup
+ * of every hierarchy if cgrp is NULL.
+ */
+static int cg_attach_plan_build(struct cgroup *cgrp, bool move_tids, struct cg_attach_plan *plan)
+{
+	char root_names[CG_CONTROLLER_MAX][CONTROL_NAMELEN_MAX];
+	const char *ctrl_names[CG_CONTROLLER_MAX];
+	struct cg_attach_dest *dest;
+	const char *controller_name;
+	const char *cg_name = NULL;
+	const char *file_name;
+	int ctrl_cnt = 0;
+	int i, ret = 0;
+
+	memset(plan, 0, sizeof(*plan));
+
+	if (!cgrp) {
+		/* Attach the task to the root cgroup of every hierarchy. */
+		pthread_rwlock_rdlock(&cg_mount_table_lock);
+		for (i = 0; i < CG_CONTROLLER_MAX && cg_mount_table[i].name[0] != '\0'; i++) {
+			memcpy(root_names[i], cg_mount_table[i].name, CONTROL_NAMELEN_MAX);
+			ctrl_names[ctrl_cnt++] = root_names[i];
 		}
 		pthread_rwlock_unlock(&cg_mount_table_lock);
 	} else {
@@ -2188,42 +2445,199 @@ static int cgroup_attach_task_tid(struct cgroup *cgrp, pid_t tid, bool move_tids
 					    cgrp->controller[i]->name);
 				return ECGROUPSUBSYSNOTMOUNTED;
 			}
+			ctrl_names[ctrl_cnt++] = cgrp->controller[i]->name;
 		}
+		cg_name = cgrp->name;
+	}
 
-		if (cgrp->index == 0)
-			/* Valid empty cgroup v2 with no controllers added. */
-			empty_cgrp = 1;
-
-		for (i = 0, controller_name = NULL;
-		     empty_cgrp > 0 || i < cgrp->index;
-		     i++, empty_cgrp--) {
-
-			if (cgrp->controller[i])
-				controller_name = cgrp->controller[i]->name;
+	/* A valid empty cgroup v2 with no controllers added has one destination */
+	plan->dests = calloc(ctrl_cnt ? ctrl_cnt : 1, sizeof(*plan->dests));
+	if (!plan->dests) {
+		last_errno = errno;
+		return ECGOTHER;
+	}
 
-			ret = cgroupv2_controller_enabled(cgrp->name, controller_name);
-			if (ret)
-				return ret;
+	i = 0;
+	do {
+		controller_name = ctrl_cnt ? ctrl_names[i] : NULL;
+		dest = &plan->dests[plan->cnt];
 
-			ret = cgroup_build_tasks_procs_path(path, sizeof(path), cgrp->name,
-							    controller_name);
+		if (cgrp) {
+			ret = cgroupv2_controller_enabled(cg_name, controller_name);
 			if (ret)
-				return ret;
+				goto err;
+		}
 
-			if (move_tids) {
-				ret = cgroup_build_tid_path(controller_name, path);
-				if (ret)
-					return ret;
-			}
+		ret = cgroup_build_tasks_procs_path(dest->path, sizeof(dest->path), cg_name,
+						    controller_name);
+		if (ret)
+			goto err;
 
-			ret = __cgroup_attach_task_pid(path, tid);
+		if (move_tids) {
+			ret = cgroup_build_tid_path(controller_name, dest->path);
 			if (ret)
-				return ret;
+				goto err;
 		}
+
+		/*
+		 * Co-mounted controllers, e.g. cpu and cpuacct, resolve to the
+		 * same file.  Moving the task there once is enough.
+		 */
+		if (cg_attach_plan_has_path(plan, dest->path))
+			continue;
+
+		file_name = strrchr(dest->path, '/');
+		dest->whole_process = file_name && strcmp(file_name, "/cgroup.procs") == 0;
+		dest->fd = -1;
+		plan->cnt++;
+	} while (++i < ctrl_cnt);
+
+	return 0;
+
+err:
+	cg_attach_plan_free(plan);
+	return ret;
+}
+
+static int cg_attach_dest_open(struct cg_attach_dest *dest)
+{
+	if (dest->fd >= 0)
+		return 0;
+
+	dest->fd = open(dest->path, O_WRONLY | O_CLOEXEC);
+	if (dest->fd >= 0)
+		return 0;
+
+	cgroup_warn("cannot open %s:%s\n", dest->path, strerror(errno));
+
+	switch (errno) {
+	case EPERM:
+		return ECGROUPNOTOWNER;
+	case ENOENT:
+		return ECGROUPNOTEXIST;
+	default:
+		return ECGROUPNOTALLOWED;
+	}
+}
+
+static int cg_attach_dest_write(struct cg_attach_dest *dest, pid_t tid)
+{
+	char tid_str[16];
+	int len, ret;
+
+	ret = cg_attach_dest_open(dest);
+	if (ret)
+		return ret;
+
+	len = snprintf(tid_str, sizeof(tid_str), "%d", tid);
+	if (write(dest->fd, tid_str, len) < 0) {
+		last_errno = errno;
+		cgroup_warn("cannot write tid %d to %s:%s\n", tid, dest->path, strerror(errno));
+		return ECGOTHER;
+	}
+
+	return 0;
+}
+
+/*
+ * Attach the task tid.  If threads_only is set, the hierarchies where the
+ * process has already been moved as a whole are skipped.
+ */
+static int cg_attach_plan_apply(struct cg_attach_plan *plan, pid_t tid, bool threads_only)
+{
+	int i, ret;
+
+	for (i = 0; i < plan->cnt; i++) {
+		if (threads_only && plan->dests[i].whole_process)
+			continue;
+
+		ret = cg_attach_dest_write(&plan->dests[i], tid);
+		if (ret)
+			return ret;
 	}
+
 	return 0;
 }
 
+/* Returns true if the threads of a process have to be moved one by one */
+static bool cg_attach_plan_per_thread(const struct cg_attach_plan *plan)
+{
+	int i;
+
+	for (i = 0; i < plan->cnt; i++) {
+		if (!plan->dests[i].whole_process)
+			return true;
+	}
+
+	return false;
+}
+
+static int cgroup_attach_task_tid(struct cgroup *cgrp, pid_t tid, bool move_tids)
+{
+	struct cg_attach_plan plan;
+	int ret;
+
+	if (!cgroup_initialized) {
+		cgroup_warn("libcgroup is not initialized\n");
+		return ECGROUPNOTINITIALIZED;
+	}
+
+	ret = cg_attach_plan_build(cgrp, move_tids, &plan);
+	if (ret)
+		return ret;
+
+	ret = cg_attach_plan_apply(&plan, tid, 0);
+	cg_attach_plan_free(&plan);
+
+	return ret;
+}
+
+int cgroup_attach_tasks(struct cgroup *cgrp, const pid_t *tids, size_t n,
+			struct cgroup_attach_result *results)
+{
+	struct cg_attach_plan plan;
+	int first_ret = 0;
+	size_t i;
+	int ret;
+	int j;
+
+	if (!cgroup_initialized) {
+		cgroup_warn("libcgroup is not initialized\n");
+		return ECGROUPNOTINITIALIZED;
+	}
+
+	if (!tids && n > 0)
+		return ECGINVAL;
+
+	ret = cg_attach_plan_build(cgrp, 0, &plan);
+	if (ret)
+		return ret;
+
+	/* Open every destination before moving anything */
+	for (j = 0; j < plan.cnt; j++) {
+		ret = cg_attach_dest_open(&plan.dests[j]);
+		if (ret)
+			goto out;
+	}
+
+	for (i = 0; i < n; i++) {
+		ret = cg_attach_plan_apply(&plan, tids[i], 0);
+		if (results) {
+			results[i].ret = ret;
+			results[i].err = ret == ECGOTHER ? last_errno : 0;
+		}
+
+		if (ret && !first_ret)
+			first_ret = ret;
+	}
+	ret = first_ret;
+
+out:
+	cg_attach_plan_free(&plan);
+
+	return ret;
+}
+
 /**
  *  cgroup_attach_task_pid is used to assign tasks to a cgroup.
  *  struct cgroup *cgroup: The cgroup to assign the thread to.
@@ -2348,11 +2762,12 @@ static int cg_create_control_group(const char *path)
 }
 
 /*
- * set_control_value()
+ * cg_set_control_value_at()
  * This is the low level function for putting in a value in a control file.
- * This function takes in the complete path and sets the value in val in that file.
+ * This function takes in the path of the file relative to dirfd and sets
+ * the value in val in that file.
  */
-static int cg_set_control_value(char *path, const char *val)
+static int cg_set_control_value_at(int dirfd, const char *path, const char *val)
 {
 	char *str_val_start;
 	char *str_val;
@@ -2363,7 +2778,7 @@ static int cg_set_control_value(char *path, const char *val)
 	if (!cg_test_mounted_fs())
 		return ECGROUPNOTMOUNTED;
 
-	ctl_file = open(path, O_RDWR | O_CLOEXEC);
+	ctl_file = openat(dirfd, path, O_RDWR | O_CLOEXEC);
 
 	if (ctl_file == -1) {
 		if (errno == EPERM) {
@@ -2379,7 +2794,7 @@ static int cg_set_control_value(char *path, const char *val)
 			char *tasks_path;
 
 			path_dir_end = strrchr(path, '/');
-			if (path_dir_end == NULL)
+			if (path_dir_end == NULL && dirfd == AT_FDCWD)
 				return ECGROUPVALUENOTEXIST;
 
 			/* task_path contain: $path/tasks */
@@ -2392,7 +2807,7 @@ static int cg_set_control_value(char *path, const char *val)
 			strcat(tasks_path, "/tasks");
 
 			/* Test tasks file for read flag */
-			control_file = fopen(tasks_path, "re");
+			control_file = cg_fopenat(dirfd, tasks_path, "re");
 			if (!control_file) {
 				if (errno == ENOENT) {
 					free(tasks_path);
@@ -2453,6 +2868,15 @@ static int cg_set_control_value(char *path, const char *val)
 	return 0;
 }
 
+/*
+ * set_control_value()
+ * This function takes in the complete path and sets the value in val in that file.
+ */
+static int cg_set_control_value(char *path, const char *val)
+{
+	return cg_set_control_value_at(AT_FDCWD, path, val);
+}
+
 /**
  * Walk the settings in controller and write their values to disk
  *
@@ -2466,8 +2890,8 @@ STATIC int cgroup_set_values_recursive(const char * const base,
 {
 	struct control_value *cv;
 	struct stat path_stat;
-	int ret, j, error = 0;
-	char *path = NULL;
+	int j, error = 0;
+	int dirfd = -1;
 
 	for (j = 0; j < controller->index; j++) {
 		cv = controller->values[j];
@@ -2492,34 +2916,33 @@ STATIC int cgroup_set_values_recursive(const char * const base,
 		if (strcspn(cv->value, "\n")  < (strlen(cv->value) - 1))
 			continue;
 
-		ret = asprintf(&path, "%s%s", base, cv->name);
-		if (ret < 0) {
-			last_errno = errno;
-			error = ECGOTHER;
-			goto err;
+		/*
+		 * Resolve the cgroup directory once, the settings are
+		 * looked up relative to it.
+		 */
+		if (dirfd < 0) {
+			dirfd = open(base, O_PATH | O_DIRECTORY | O_CLOEXEC);
+			if (dirfd < 0) {
+				last_errno = errno;
+				error = ECGROUPVALUENOTEXIST;
+				goto err;
+			}
 		}
 
 		/* skip read-only settings */
-		ret = (stat(path, &path_stat));
-		if (ret < 0) {
+		if (fstatat(dirfd, cv->name, &path_stat, 0) < 0) {
 			last_errno = errno;
 			error = ECGROUPVALUENOTEXIST;
 			goto err;
 		}
 
 		/* 0200 == S_IWUSR */
-		if (!(path_stat.st_mode & 0200)) {
-			free(path);
-			path = NULL;
+		if (!(path_stat.st_mode & 0200))
 			continue;
-		}
-
-		cgroup_dbg("setting %s to \"%s\", pathlen %d\n", path, cv->value, ret);
 
-		error = cg_set_control_value(path, cv->value);
-		free(path);
-		path = NULL;
+		cgroup_dbg("setting %s%s to \"%s\"\n", base, cv->name, cv->value);
 
+		error = cg_set_control_value_at(dirfd, cv->name, cv->value);
 		if (error) {
 			/* Ignore the errors on deprecated settings */
 			if (last_errno == EOPNOTSUPP) {
@@ -2532,13 +2955,56 @@ STATIC int cgroup_set_values_recursive(const char * const base,
 	}
 
 err:
+	if (dirfd >= 0)
+		close(dirfd);
+
+	return error;
+}
+
+/*
+ * Parse the space separated list of controllers in the file at path,
+ * relative to dirfd, and check if ctrl_name is among them.
+ */
+static int cgroupv2_read_enabled(int dirfd, const char *path, const char *ctrl_name,
+				 bool * const enabled)
+{
+	char *saveptr = NULL, *token, *ret_c;
+	int error = ECGROUPNOTMOUNTED;
+	char buffer[FILENAME_MAX];
+	FILE *fp;
+
+	*enabled = false;
+
+	fp = cg_fopenat(dirfd, path, "re");
+	if (!fp) {
+		cgroup_warn("fopen failed\n");
+		last_errno = errno;
+		return ECGOTHER;
+	}
+
+	ret_c = fgets(buffer, sizeof(buffer), fp);
+	if (ret_c == NULL)
+		/* The subtree control file is empty */
+		goto out;
+
+	/* Remove the trailing newline */
+	ret_c[strlen(ret_c) - 1] = '\0';
+
 	/*
-	 * As currently written, path should always be null as we are\
-	 * exiting this function, but let's check just in case, and free it
-	 * if it's non-null
+	 * Split the enabled controllers by " " and evaluate if the
+	 * requested controller is enabled.
 	 */
-	if (path)
-		free(path);
+	token = strtok_r(buffer, " ", &saveptr);
+	do {
+		if (strncmp(ctrl_name, token, FILENAME_MAX) == 0) {
+			error = 0;
+			*enabled = true;
+			break;
+		}
+	} while ((token = strtok_r(NULL, " ", &saveptr)));
+
+out:
+	fclose(fp);
 
 	return error;
 }
@@ -2556,10 +3022,8 @@ err:
 STATIC int __cgroupv2_get_enabled(const char *path, const char *ctrl_name,
 				  bool * const enabled, int file_enum)
 {
-	char *path_copy = NULL, *saveptr = NULL, *token, *ret_c, *filename;
+	char *path_copy = NULL, *filename;
 	int ret, error = ECGROUPNOTMOUNTED;
-	char buffer[FILENAME_MAX];
-	FILE *fp = NULL;
 
 	if (!path || !ctrl_name || !enabled)
 		return ECGOTHER;
@@ -2589,40 +3053,11 @@ STATIC int __cgroupv2_get_enabled(const char *path, const char *ctrl_name,
 		goto out;
 	}
 
-	fp = fopen(path_copy, "re");
-	if (!fp) {
-		cgroup_warn("fopen failed\n");
-		last_errno = errno;
-		error = ECGOTHER;
-		goto out;
-	}
-
-	ret_c = fgets(buffer, sizeof(buffer), fp);
-	if (ret_c == NULL)
-		/* The subtree control file is empty */
-		goto out;
-
-	/* Remove the trailing newline */
-	ret_c[strlen(ret_c) - 1] = '\0';
-
-	/*
-	 * Split the enabled controllers by " " and evaluate if the
-	 * requested controller is enabled.
-	 */
-	token = strtok_r(buffer, " ", &saveptr);
-	do {
-		if (strncmp(ctrl_name, token, FILENAME_MAX) == 0) {
-			error = 0;
-			*enabled = true;
-			break;
-		}
-	} while ((token = strtok_r(NULL, " ", &saveptr)));
+	error = cgroupv2_read_enabled(AT_FDCWD, path_copy, ctrl_name, enabled);
 
 out:
 	if (path_copy)
 		free(path_copy);
-	if (fp)
-		fclose(fp);
 
 	return error;
 }
@@ -2652,6 +3087,19 @@ static int cgroupv2_get_controllers(const char *path, const char *ctrl_name,
 	return __cgroupv2_get_enabled(path, ctrl_name, enabled, 1);
 }
 
+/**
+ * Check if the requested cgroup controller is enabled in the cgroup.controllers
+ * file of the cgroup directory dirfd
+ *
+ * @param dirfd Cgroup directory fd
+ * @param ctrl_name Name of the controller to check
+ * @param output parameter that indicates whether the controller is enabled
+ */
+static int cgroupv2_get_controllers_at(int dirfd, const char *ctrl_name, bool * const enabled)
+{
+	return cgroupv2_read_enabled(dirfd, CGV2_CONTROLLERS_FILE, ctrl_name, enabled);
+}
+
 /**
  * Enable/Disable a controller in the cgroup v2 subtree_control file
  *
@@ -2854,6 +3302,8 @@ err:
 int cgroup_copy_controller_values(struct cgroup_controller * const dst,
 				  const struct cgroup_controller * const src)
 {
+	size_t value_size = 0, len;
+	char *value = NULL;
 	int i, ret = 0;
 
 	if (!dst || !src)
@@ -2866,19 +3316,33 @@ int cgroup_copy_controller_values(struct cgroup_controller * const dst,
 		struct control_value *src_val = src->values[i];
 		struct control_value *dst_val;
 
-		dst->values[i] = calloc(1, sizeof(struct control_value));
+		if (!dst->arena) {
+			ret = ECGINVAL;
+			goto err;
+		}
+
+		dst->values[i] = cg_arena_alloc(dst->arena, sizeof(struct control_value));
 		if (!dst->values[i]) {
-			last_errno = errno;
 			ret = ECGOTHER;
 			goto err;
 		}
 
 		dst_val = dst->values[i];
-		strncpy(dst_val->value, src_val->value, CG_CONTROL_VALUE_MAX);
-		dst_val->value[CG_CONTROL_VALUE_MAX - 1] = '\0';
+		if (src_val->unread) {
+			/* The copy may belong to another group, read the value now */
+			ret = cg_read_lazy_value(src, src_val, &value, &value_size, &len);
+			if (ret)
+				goto err;
+
+			ret = cg_set_value_len(dst, dst_val, value, len);
+		} else {
+			ret = cg_set_value(dst, dst_val, src_val->value);
+		}
+		if (ret)
+			goto err;
 
-		strncpy(dst_val->name, src_val->name, FILENAME_MAX);
-		dst_val->name[FILENAME_MAX - 1] = '\0';
+		/* The names are interned, the copy shares them */
+		dst_val->name = src_val->name;
 
 		if (src_val->multiline_value) {
 			dst_val->multiline_value = strdup(src_val->multiline_value);
@@ -2891,16 +3355,8 @@ int cgroup_copy_controller_values(struct cgroup_controller * const dst,
 			dst_val->multiline_value = NULL;
 		}
 
-		if (src_val->prev_name) {
-			dst_val->prev_name = strdup(src_val->prev_name);
-			if (!dst_val->prev_name) {
-				last_errno = errno;
-				ret = ECGOTHER;
-				goto err;
-			}
-		} else {
-			dst_val->prev_name = NULL;
-		}
+		dst_val->prev_name = src_val->prev_name;
+
 		/*
 		 * set dirty flag unconditionally, as we overwrite
 		 * destination controller values.
@@ -2908,21 +3364,19 @@ int cgroup_copy_controller_values(struct cgroup_controller * const dst,
 		dst_val->dirty = true;
 	}
 
+	free(value);
+
 	return ret;
 
 err:
-	dst->index = 0;
-	for (i = 0; i < src->index; i++) {
-		if (dst->values[i]) {
-			if (dst->values[i]->multiline_value)
-				free(dst->values[i]->multiline_value);
+	free(value);
 
-			if (dst->values[i]->prev_name)
-				free(dst->values[i]->prev_name);
-
-			free(dst->values[i]);
-		}
+	/* The values themselves stay in the arena of the cgroup */
+	for (i = 0; i < dst->index; i++) {
+		if (dst->values[i]->multiline_value)
+			free(dst->values[i]->multiline_value);
 	}
+	dst->index = 0;
 
 	return ret;
 }
@@ -2951,14 +3405,23 @@ int cgroup_copy_cgroup(struct cgroup *dst, struct cgroup *src)
 		struct cgroup_controller *src_ctlr = src->controller[i];
 		struct cgroup_controller *dst_ctlr;
 
-		dst->controller[i] = calloc(1, sizeof(struct cgroup_controller));
-		if (!dst->controller[i]) {
-			last_errno = errno;
+		if (!dst->arena) {
+			dst->arena = cg_arena_new();
+			if (!dst->arena) {
+				ret = ECGOTHER;
+				goto err;
+			}
+		}
+
+		dst->controller[i] = cg_arena_alloc(dst->arena, sizeof(struct cgroup_controller));
+		if (!dst->controller[i]) {
 			ret = ECGOTHER;
 			goto err;
 		}
 
 		dst_ctlr = dst->controller[i];
+		dst_ctlr->cgroup = dst;
+		dst_ctlr->arena = dst->arena;
 		ret = cgroup_copy_controller_values(dst_ctlr, src_ctlr);
 		if (ret)
 			goto err;
@@ -3370,45 +3833,341 @@ err_nomem:
 	return ret;
 }
 
+/*
+ * Move all processes from one task file to another, cnt receives the
+ * number of processes read from input_tasks if it isn't NULL.
+ */
+static int cg_move_task_files_cnt(int input_tasks, int output_tasks, int *cnt)
+{
+	size_t size = 0, len = 0;
+	char *buf = NULL, *tmp;
+	char *ptr, *end;
+	char tid_str[16];
+	ssize_t ret;
+	long tid;
+	int n;
+
+	/*
+	 * Read the whole list in one pass, the kernel generates the content
+	 * of the file again for every read() after a seek.
+	 */
+	do {
+		if (len + 1 >= size) {
+			size = size ? size * 2 : 4096;
+			tmp = realloc(buf, size);
+			if (!tmp) {
+				last_errno = errno;
+				free(buf);
+				return ECGOTHER;
+			}
+			buf = tmp;
+		}
+
+		ret = read(input_tasks, buf + len, size - len - 1);
+		if (ret > 0)
+			len += ret;
+	} while (ret > 0 || (ret < 0 && errno == EINTR));
+
+	if (ret < 0) {
+		last_errno = errno;
+		free(buf);
+		return ECGOTHER;
+	}
+	buf[len] = '\0';
+
+	if (cnt)
+		*cnt = 0;
+
+	for (ptr = buf; ; ptr = end) {
+		tid = strtol(ptr, &end, 10);
+		if (end == ptr)
+			break;
+
+		if (cnt)
+			(*cnt)++;
+
+		/* The kernel accepts only one process per write() call. */
+		n = snprintf(tid_str, sizeof(tid_str), "%ld", tid);
+		if (write(output_tasks, tid_str, n) < 0 && errno != ESRCH) {
+			last_errno = errno;
+			free(buf);
+			return ECGOTHER;
+		}
+	}
+
+	free(buf);
+
+	return 0;
+}
+
 /**
  * Move all processes from one task file to another.
  * @param input_tasks Pre-opened file to read tasks from.
  * @param output_tasks Pre-opened file to write tasks to.
  * @return 0 on success, >0 on error.
  */
-static int cg_move_task_files(FILE *input_tasks, FILE *output_tasks)
+STATIC int cg_move_task_files(int input_tasks, int output_tasks)
+{
+	return cg_move_task_files_cnt(input_tasks, output_tasks, NULL);
+}
+
+#define CG_EVENTS_POLL_MS	100
+#define CG_EVENTS_POLL_MAX	100
+
+/*
+ * Wait until the cgroup.events file of the group dirfd contains event,
+ * e.g. "populated 0".  cgroup.events signals POLLPRI when a key changes.
+ * Returns without error when the wait times out, the caller then fails
+ * on the next step.
+ */
+static void cg_wait_cgroup_event(int dirfd, const char *event)
+{
+	struct pollfd pfd;
+	char buf[256];
+	ssize_t len;
+	int i;
+
+	pfd.fd = openat(dirfd, "cgroup.events", O_RDONLY | O_CLOEXEC);
+	if (pfd.fd < 0)
+		return;
+	pfd.events = POLLPRI;
+
+	for (i = 0; i < CG_EVENTS_POLL_MAX; i++) {
+		len = pread(pfd.fd, buf, sizeof(buf) - 1, 0);
+		if (len < 0)
+			break;
+		buf[len] = '\0';
+
+		if (strstr(buf, event))
+			break;
+
+		poll(&pfd, 1, CG_EVENTS_POLL_MS);
+	}
+	close(pfd.fd);
+}
+
+/*
+ * Kill all the tasks of a cgroup v2 group and of its subgroups with
+ * cgroup.kill, and wait until the group is no longer populated.
+ *
+ * Returns ECGROUPUNSUPP if there is no cgroup.kill file, i.e. on cgroup v1,
+ * for the root group and on kernels older than 5.14.
+ */
+static int cg_kill_cgrp(const char *cgrp_name, const char *controller)
 {
+	char path[FILENAME_MAX];
+	int dirfd, fd;
 	int ret = 0;
-	int tids;
 
-	while (!feof(input_tasks)) {
-		ret = fscanf(input_tasks, "%d", &tids);
-		if (ret == EOF || ret == 0) {
-			ret = 0;
+	if (!cg_build_path(cgrp_name, path, controller))
+		return ECGROUPSUBSYSNOTMOUNTED;
+
+	dirfd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dirfd < 0) {
+		/* The group has been already removed */
+		if (errno == ENOENT)
+			return 0;
+
+		last_errno = errno;
+		return ECGOTHER;
+	}
+
+	fd = openat(dirfd, "cgroup.kill", O_WRONLY | O_CLOEXEC);
+	if (fd < 0) {
+		ret = errno == ENOENT ? ECGROUPUNSUPP : ECGOTHER;
+		last_errno = errno;
+		goto out;
+	}
+
+	cgroup_dbg("Killing tasks of %s\n", path);
+	if (write(fd, "1", 1) < 0) {
+		cgroup_warn("cannot kill tasks of %s: %s\n", path, strerror(errno));
+		last_errno = errno;
+		close(fd);
+		ret = ECGOTHER;
+		goto out;
+	}
+	close(fd);
+
+	/*
+	 * The tasks exit asynchronously.  If they don't exit in time, rmdir()
+	 * reports the group as busy.
+	 */
+	cg_wait_cgroup_event(dirfd, "populated 0");
+
+out:
+	close(dirfd);
+
+	return ret;
+}
+
+#define CG_MIGRATE_PASS_MAX	100
+#define CG_MIGRATE_PASS_DELAY_MS	10
+
+/*
+ * Freeze or thaw the cgroup v2 group of the cgroup.procs file procs_path.
+ * Returns ECGROUPUNSUPP if the group has no cgroup.freeze file, i.e. for
+ * the root group and on kernels older than 5.2.
+ */
+static int cg_freeze_procs_dir(const char *procs_path, bool freeze)
+{
+	char path[FILENAME_MAX];
+	int dirfd, fd;
+	int ret = 0;
+
+	snprintf(path, sizeof(path), "%s", procs_path);
+	dirfd = open(dirname(path), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dirfd < 0) {
+		last_errno = errno;
+		return ECGOTHER;
+	}
+
+	fd = openat(dirfd, "cgroup.freeze", O_WRONLY | O_CLOEXEC);
+	if (fd < 0) {
+		ret = errno == ENOENT ? ECGROUPUNSUPP : ECGOTHER;
+		last_errno = errno;
+		goto out;
+	}
+
+	if (write(fd, freeze ? "1" : "0", 1) < 0) {
+		cgroup_warn("cannot %s %s: %s\n", freeze ? "freeze" : "thaw", path,
+			    strerror(errno));
+		last_errno = errno;
+		ret = ECGOTHER;
+	}
+	close(fd);
+
+	/* The tasks are frozen asynchronously */
+	if (!ret && freeze)
+		cg_wait_cgroup_event(dirfd, "frozen 1");
+
+out:
+	close(dirfd);
+
+	return ret;
+}
+
+/*
+ * Move the tasks of the file src_path to the already opened file dst,
+ * until src_path is empty.  Processes forked meanwhile are caught by the
+ * next pass.
+ */
+static int cg_migrate_all_file(const char *src_path, struct cg_attach_dest *dst, bool freeze)
+{
+	bool frozen = false;
+	int src_fd, cnt;
+	int pass, ret;
+
+	/* Frozen tasks can't fork, the first pass then moves all of them */
+	if (freeze && dst->whole_process) {
+		ret = cg_freeze_procs_dir(src_path, true);
+		if (ret == 0)
+			frozen = true;
+		else
+			cgroup_dbg("cannot freeze %s, migrating without freezing\n", src_path);
+	}
+
+	for (pass = 0; pass < CG_MIGRATE_PASS_MAX; pass++) {
+		/*
+		 * Exiting tasks can't be moved but are listed until they are
+		 * reaped, give them some time after the second pass.
+		 */
+		if (pass > 1)
+			poll(NULL, 0, CG_MIGRATE_PASS_DELAY_MS);
+
+		/*
+		 * The file is opened for every pass, cgroup v1 keeps serving
+		 * the list of the first read to an opened tasks file for a
+		 * while.
+		 */
+		src_fd = open(src_path, O_RDONLY | O_CLOEXEC);
+		if (src_fd < 0) {
+			cgroup_warn("cannot open %s: %s\n", src_path, strerror(errno));
+			last_errno = errno;
+			ret = errno == ENOENT ? ECGROUPNOTEXIST : ECGOTHER;
 			break;
 		}
-		if (ret < 0)
-			break;
 
-		ret = fprintf(output_tasks, "%d", tids);
-		if (ret < 0 && errno != ESRCH)
+		ret = cg_move_task_files_cnt(src_fd, dst->fd, &cnt);
+		close(src_fd);
+		if (ret || cnt == 0)
 			break;
+	}
 
-		/* Flush the file, we need only one process per write() call. */
-		ret = fflush(output_tasks);
-		if (ret < 0) {
-			if (errno == ESRCH)
-				ret = 0;
-			else
-				break;
+	if (pass == CG_MIGRATE_PASS_MAX) {
+		cgroup_warn("%s is still populated after %d passes\n", src_path, pass);
+		ret = ECGNONEMPTY;
+	}
+
+	/* The moved tasks have already been thawed by the migration */
+	if (frozen)
+		cg_freeze_procs_dir(src_path, false);
+
+	return ret;
+}
+
+int cgroup_migrate_all(struct cgroup *src, struct cgroup *dst, int flags)
+{
+	struct cg_attach_plan src_plan = { 0 };
+	struct cg_attach_plan dst_plan = { 0 };
+	struct cgroup dst_cgrp;
+	int ret, i;
+
+	if (!cgroup_initialized) {
+		cgroup_warn("libcgroup is not initialized\n");
+		return ECGROUPNOTINITIALIZED;
+	}
+
+	if (!src || !dst)
+		return ECGINVAL;
+
+	/* The destination is resolved in the hierarchies of the source */
+	memset(&dst_cgrp, 0, sizeof(dst_cgrp));
+	strcpy(dst_cgrp.name, dst->name);
+	for (i = 0; i < src->index; i++) {
+		if (!cgroup_add_controller(&dst_cgrp, src->controller[i]->name)) {
+			ret = ECGINVAL;
+			goto out;
 		}
 	}
 
-	if (ret < 0) {
-		last_errno = errno;
-		return ECGOTHER;
+	ret = cg_attach_plan_build(src, 0, &src_plan);
+	if (ret)
+		goto out;
+
+	ret = cg_attach_plan_build(&dst_cgrp, 0, &dst_plan);
+	if (ret)
+		goto out;
+
+	/* Both plans hold one file per hierarchy, in the same order */
+	if (src_plan.cnt != dst_plan.cnt) {
+		ret = ECGINVAL;
+		goto out;
 	}
-	return 0;
+
+	for (i = 0; i < dst_plan.cnt; i++) {
+		ret = cg_attach_dest_open(&dst_plan.dests[i]);
+		if (ret)
+			goto out;
+	}
+
+	for (i = 0; i < dst_plan.cnt; i++) {
+		/* The tasks are already there */
+		if (strcmp(src_plan.dests[i].path, dst_plan.dests[i].path) == 0)
+			continue;
+
+		ret = cg_migrate_all_file(src_plan.dests[i].path, &dst_plan.dests[i],
+					  flags & CGFLAG_MIGRATE_FREEZE);
+		if (ret)
+			break;
+	}
+
+out:
+	cg_attach_plan_free(&src_plan);
+	cg_attach_plan_free(&dst_plan);
+	cgroup_free_controllers(&dst_cgrp);
+
+	return ret;
 }
 
 /**
@@ -3423,34 +4182,34 @@ static int cg_move_task_files(FILE *input_tasks, FILE *output_tasks)
  * @param cgrp_name Name of the group to remove.
  * @param controller  Name of the controller.
  * @param target_tasks Opened tasks file of the target group, where all
- *	processes should be moved.
+ *	processes should be moved, or -1 if the tasks have been killed.
  * @param flags Flag indicating whether the errors from task
  *	migration should be ignored (CGROUP_DELETE_IGNORE_MIGRATION) or not (0).
  * @return 0 on success, >0 on error.
  */
-static int cg_delete_cgrp_controller(char *cgrp_name, char *controller, FILE *target_tasks,
+static int cg_delete_cgrp_controller(char *cgrp_name, char *controller, int target_tasks,
 				     int flags)
 {
 	char path[FILENAME_MAX];
-	FILE *delete_tasks;
+	int delete_tasks;
 	int ret = 0;
 
 	cgroup_dbg("Removing group %s:%s\n", controller, cgrp_name);
 
-	if (!(flags & CGFLAG_DELETE_EMPTY_ONLY)) {
+	if (!(flags & CGFLAG_DELETE_EMPTY_ONLY) && target_tasks >= 0) {
 		/* Open tasks file of the group to delete. */
 		ret = cgroup_build_tasks_procs_path(path, sizeof(path), cgrp_name, controller);
 		if (ret != 0)
 			return ECGROUPSUBSYSNOTMOUNTED;
 
-		delete_tasks = fopen(path, "re");
-		if (delete_tasks) {
+		delete_tasks = open(path, O_RDONLY | O_CLOEXEC);
+		if (delete_tasks >= 0) {
 			ret = cg_move_task_files(delete_tasks, target_tasks);
 			if (ret != 0) {
 				cgroup_warn("removing tasks from %s failed: %s\n", path,
 					    cgroup_strerror(ret));
 			}
-			fclose(delete_tasks);
+			close(delete_tasks);
 		} else {
 			/*
 			 * Can't open the tasks file. If the file does not exist,
@@ -3490,13 +4249,13 @@ static int cg_delete_cgrp_controller(char *cgrp_name, char *controller, FILE *ta
  *
  * @param cgrp_name The group to delete.
  * @param controller The controller, where to delete.
- * @param target_tasks Opened file, where all tasks should be moved.
+ * @param target_tasks Opened file, where all tasks should be moved, or -1.
  * @param flags Combination of CGFLAG_DELETE_* flags. The function assumes
  *	that CGFLAG_DELETE_RECURSIVE is set.
  * @param delete_root Whether the group itself should be removed(1) or not(0).
  */
 static int cg_delete_cgrp_controller_recursive(char *cgrp_name, char *controller,
-					       FILE *target_tasks, int flags, int delete_root)
+					       int target_tasks, int flags, int delete_root)
 {
 	char child_name[FILENAME_MAX + 1];
 	struct cgroup_file_info info;
@@ -3545,56 +4304,306 @@ static int cg_delete_cgrp_controller_recursive(char *cgrp_name, char *controller
 	return ret;
 }
 
-/**
- * cgroup_delete cgroup deletes a control group.
- * struct cgroup *cgrp takes the group which is to be deleted.
- *
- * returns 0 on success.
+/* Upper bound of the threads deleting one subtree */
+#define CG_DELETE_THREADS_MAX	16
+
+/* Group of a subtree deleted with CGFLAG_DELETE_PARALLEL */
+struct cg_delete_node {
+	char *name;
+	/* Index of the parent node, -1 for the root of the subtree */
+	int parent;
+	/* Number of subgroups that still have to be removed */
+	int pending;
+};
+
+/*
+ * The groups of a subtree, deleted by a pool of threads.  A group is queued
+ * once all its subgroups are removed, i.e. the leaves come first.
  */
-int cgroup_delete_cgroup(struct cgroup *cgrp, int ignore_migration)
+struct cg_delete_pool {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct cg_delete_node *nodes;
+	int node_cnt;
+	/* Groups ready to be removed */
+	int *queue;
+	int head;
+	int tail;
+	/* Number of groups being removed right now */
+	int active;
+	char *controller;
+	int target_tasks;
+	int flags;
+	int delete_root;
+	/* Namespaces of the calling thread, the paths are built with them */
+	char *namespaces[CG_CONTROLLER_MAX];
+	/* First error and its errno */
+	int ret;
+	int err;
+};
+
+static void *cg_delete_worker(void *arg)
 {
-	int flags = ignore_migration ? CGFLAG_DELETE_IGNORE_MIGRATION : 0;
+	struct cg_delete_pool *pool = arg;
+	struct cg_delete_node *node;
+	int parent;
+	int idx;
+	int ret;
 
-	return cgroup_delete_cgroup_ext(cgrp, flags);
+	pthread_mutex_lock(&pool->lock);
+	while (1) {
+		while (pool->head == pool->tail && pool->active > 0)
+			pthread_cond_wait(&pool->cond, &pool->lock);
+
+		/* Nothing queued and nothing in progress, the work is done */
+		if (pool->head == pool->tail)
+			break;
+
+		idx = pool->queue[pool->head++];
+		pool->active++;
+		pthread_mutex_unlock(&pool->lock);
+
+		node = &pool->nodes[idx];
+		ret = cg_delete_cgrp_controller(node->name, pool->controller, pool->target_tasks,
+						pool->flags);
+
+		pthread_mutex_lock(&pool->lock);
+		pool->active--;
+
+		if (ret) {
+			if (!pool->ret) {
+				pool->ret = ret;
+				pool->err = last_errno;
+			}
+			/* Stop scheduling, the groups in progress are finished */
+			pool->head = pool->tail;
+		} else if (!pool->ret) {
+			parent = node->parent;
+			if (parent >= 0 && --pool->nodes[parent].pending == 0 &&
+			    (parent > 0 || pool->delete_root))
+				pool->queue[pool->tail++] = parent;
+		}
+
+		pthread_cond_broadcast(&pool->cond);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
 }
 
-int cgroup_delete_cgroup_ext(struct cgroup *cgrp, int flags)
+/* Entry point of the threads of the pool, other than the calling thread */
+static void *cg_delete_thread(void *arg)
 {
-	int first_error = 0, first_errno = 0;
-	int cgrp_del_on_shared_mnt = 0;
-	char parent_path[FILENAME_MAX];
-	char *controller_name = NULL;
-	FILE *parent_tasks = NULL;
-	char *parent_name = NULL;
-	int delete_group = 1;
-	int empty_cgrp = 0;
-	int i, ret;
+	struct cg_delete_pool *pool = arg;
 
-	if (!cgroup_initialized)
-		return ECGROUPNOTINITIALIZED;
+	memcpy(cg_namespace_table, pool->namespaces, sizeof(cg_namespace_table));
+	cg_delete_worker(pool);
+	memset(cg_namespace_table, 0, sizeof(cg_namespace_table));
 
-	if (!cgrp)
-		return ECGROUPNOTALLOWED;
+	return NULL;
+}
 
-	if ((flags & CGFLAG_DELETE_RECURSIVE)
-	    && (flags & CGFLAG_DELETE_EMPTY_ONLY))
-		return ECGINVAL;
+/**
+ * Recursively delete one control group like
+ * cg_delete_cgrp_controller_recursive(), but remove independent subgroups
+ * concurrently.
+ */
+static int cg_delete_cgrp_controller_parallel(char *cgrp_name, char *controller,
+					      int target_tasks, int flags, int delete_root)
+{
+	pthread_t threads[CG_DELETE_THREADS_MAX];
+	int *stack = NULL, *tmp_stack;
+	struct cg_delete_pool pool;
+	struct cgroup_file_info info;
+	struct cg_delete_node *tmp;
+	int thread_cnt, started = 0;
+	int nodes_size = 0, stack_size = 0;
+	int level, group_len;
+	void *handle = NULL;
+	long cpus;
+	int ret, i;
 
-	if (cgrp->index == 0)
-		/* Valid empty cgroup v2 with not controllers added. */
-		empty_cgrp = 1;
+	cgroup_dbg("Recursively removing %s:%s in parallel\n", controller, cgrp_name);
 
-	for (i = 0; i < cgrp->index; i++) {
-		if (!cgroup_test_subsys_mounted(cgrp->controller[i]->name))
-			return ECGROUPSUBSYSNOTMOUNTED;
+	memset(&pool, 0, sizeof(pool));
+	pool.controller = controller;
+	pool.target_tasks = target_tasks;
+	pool.flags = flags;
+	pool.delete_root = delete_root;
+
+	ret = cgroup_walk_tree_begin(controller, cgrp_name, 0, &handle, &info, &level);
+	if (ret == 0)
+		ret = cgroup_walk_tree_set_flags(&handle, CGROUP_WALK_TYPE_PRE_DIR);
+
+	if (ret != 0) {
+		cgroup_walk_tree_end(&handle);
+		return ret;
 	}
 
+	group_len = strlen(info.full_path);
+
 	/*
-	 * Remove the group from all controllers and in the case of cgroup
-	 * with no controllers, perform all actions of a single controller.
+	 * Collect the groups in pre-order, the parent of a group is the last
+	 * group seen one level above it.
 	 */
-	for (i = 0; empty_cgrp > 0 || i < cgrp->index; i++, empty_cgrp--) {
-
+	do {
+		if (info.type != CGROUP_FILE_TYPE_DIR)
+			continue;
+
+		if (pool.node_cnt == nodes_size) {
+			nodes_size = nodes_size ? nodes_size * 2 : 64;
+			tmp = realloc(pool.nodes, nodes_size * sizeof(*pool.nodes));
+			if (!tmp)
+				goto oom;
+			pool.nodes = tmp;
+		}
+
+		if (info.depth >= stack_size) {
+			stack_size = info.depth + 64;
+			tmp_stack = realloc(stack, stack_size * sizeof(*stack));
+			if (!tmp_stack)
+				goto oom;
+			stack = tmp_stack;
+		}
+
+		if (asprintf(&pool.nodes[pool.node_cnt].name, "%s/%s", cgrp_name,
+			     info.full_path + group_len) < 0)
+			goto oom;
+
+		pool.nodes[pool.node_cnt].parent = info.depth > 0 ? stack[info.depth - 1] : -1;
+		pool.nodes[pool.node_cnt].pending = 0;
+		if (info.depth > 0)
+			pool.nodes[stack[info.depth - 1]].pending++;
+
+		stack[info.depth] = pool.node_cnt++;
+	} while ((ret = cgroup_walk_tree_next(0, &handle, &info, level)) == 0);
+
+	cgroup_walk_tree_end(&handle);
+	free(stack);
+	stack = NULL;
+
+	if (ret != ECGEOF)
+		goto out;
+	ret = 0;
+
+	pool.queue = calloc(pool.node_cnt, sizeof(*pool.queue));
+	if (!pool.queue)
+		goto oom;
+
+	for (i = 0; i < pool.node_cnt; i++) {
+		if (pool.nodes[i].pending == 0 && (i > 0 || delete_root))
+			pool.queue[pool.tail++] = i;
+	}
+
+	ret = cg_namespace_table_dup(pool.namespaces);
+	if (ret)
+		goto out;
+
+	pthread_mutex_init(&pool.lock, NULL);
+	pthread_cond_init(&pool.cond, NULL);
+
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	thread_cnt = cpus > 0 ? cpus : 1;
+	if (thread_cnt > CG_DELETE_THREADS_MAX)
+		thread_cnt = CG_DELETE_THREADS_MAX;
+	if (thread_cnt > pool.tail)
+		thread_cnt = pool.tail;
+
+	/* The calling thread is one of the workers */
+	for (i = 1; i < thread_cnt; i++) {
+		if (pthread_create(&threads[started], NULL, cg_delete_thread, &pool))
+			break;
+		started++;
+	}
+
+	cg_delete_worker(&pool);
+
+	for (i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_cond_destroy(&pool.cond);
+	pthread_mutex_destroy(&pool.lock);
+	cg_namespace_table_free(pool.namespaces);
+
+	ret = pool.ret;
+	if (ret)
+		last_errno = pool.err;
+
+	goto out;
+
+oom:
+	last_errno = errno;
+	ret = ECGOTHER;
+	if (handle)
+		cgroup_walk_tree_end(&handle);
+out:
+	for (i = 0; i < pool.node_cnt; i++)
+		free(pool.nodes[i].name);
+	free(pool.nodes);
+	free(pool.queue);
+	free(stack);
+
+	return ret;
+}
+
+/**
+ * cgroup_delete cgroup deletes a control group.
+ * struct cgroup *cgrp takes the group which is to be deleted.
+ *
+ * returns 0 on success.
+ */
+int cgroup_delete_cgroup(struct cgroup *cgrp, int ignore_migration)
+{
+	int flags = ignore_migration ? CGFLAG_DELETE_IGNORE_MIGRATION : 0;
+
+	return cgroup_delete_cgroup_ext(cgrp, flags);
+}
+
+int cgroup_delete_cgroup_ext(struct cgroup *cgrp, int flags)
+{
+	int first_error = 0, first_errno = 0;
+	int cgrp_del_on_shared_mnt = 0;
+	char parent_path[FILENAME_MAX];
+	char *controller_name = NULL;
+	char *parent_name = NULL;
+	int parent_tasks = -1;
+	int delete_group = 1;
+	int empty_cgrp = 0;
+	int killed;
+	int i, ret;
+
+	if (!cgroup_initialized)
+		return ECGROUPNOTINITIALIZED;
+
+	if (!cgrp)
+		return ECGROUPNOTALLOWED;
+
+	if ((flags & CGFLAG_DELETE_RECURSIVE)
+	    && (flags & CGFLAG_DELETE_EMPTY_ONLY))
+		return ECGINVAL;
+
+	/*
+	 * cgroup.kill also kills the tasks of the subgroups, which only a
+	 * recursive delete removes.
+	 */
+	if ((flags & CGFLAG_DELETE_KILL) && !(flags & CGFLAG_DELETE_RECURSIVE))
+		return ECGINVAL;
+
+	if (cgrp->index == 0)
+		/* Valid empty cgroup v2 with not controllers added. */
+		empty_cgrp = 1;
+
+	for (i = 0; i < cgrp->index; i++) {
+		if (!cgroup_test_subsys_mounted(cgrp->controller[i]->name))
+			return ECGROUPSUBSYSNOTMOUNTED;
+	}
+
+	/*
+	 * Remove the group from all controllers and in the case of cgroup
+	 * with no controllers, perform all actions of a single controller.
+	 */
+	for (i = 0; empty_cgrp > 0 || i < cgrp->index; i++, empty_cgrp--) {
+
 		ret = 0;
 		controller_name = NULL;
 
@@ -3649,7 +4658,27 @@ int cgroup_delete_cgroup_ext(struct cgroup *cgrp, int flags)
 			}
 		}
 
-		if (parent_name) {
+		/*
+		 * Kill the tasks rather than moving them to the parent.  The
+		 * root group has no cgroup.kill and cgroup v1 groups neither,
+		 * their tasks are moved as usual.
+		 */
+		killed = 0;
+		if ((flags & CGFLAG_DELETE_KILL) && parent_name && delete_group) {
+			ret = cg_kill_cgrp(cgrp->name, controller_name);
+			if (ret && ret != ECGROUPUNSUPP) {
+				if (first_error == 0) {
+					first_errno = last_errno;
+					first_error = ret;
+				}
+				free(parent_name);
+				parent_name = NULL;
+				continue;
+			}
+			killed = !ret;
+		}
+
+		if (parent_name && !killed) {
 			/* Tasks need to be moved, pre-open target tasks file */
 			ret = cgroup_build_tasks_procs_path(parent_path, sizeof(parent_path),
 							    parent_name, controller_name);
@@ -3660,8 +4689,8 @@ int cgroup_delete_cgroup_ext(struct cgroup *cgrp, int flags)
 				continue;
 			}
 
-			parent_tasks = fopen(parent_path, "we");
-			if (!parent_tasks) {
+			parent_tasks = open(parent_path, O_WRONLY | O_CLOEXEC);
+			if (parent_tasks < 0) {
 				if (first_error == 0) {
 					cgroup_warn("cannot open tasks file %s: %s\n", parent_path,
 						    strerror(errno));
@@ -3672,7 +4701,11 @@ int cgroup_delete_cgroup_ext(struct cgroup *cgrp, int flags)
 				continue;
 			}
 		}
-		if (flags & CGFLAG_DELETE_RECURSIVE) {
+		if ((flags & CGFLAG_DELETE_RECURSIVE) && (flags & CGFLAG_DELETE_PARALLEL)) {
+			ret = cg_delete_cgrp_controller_parallel(cgrp->name, controller_name,
+								 parent_tasks, flags,
+								 delete_group);
+		} else if (flags & CGFLAG_DELETE_RECURSIVE) {
 			ret = cg_delete_cgrp_controller_recursive(cgrp->name, controller_name,
 								    parent_tasks, flags,
 								    delete_group);
@@ -3681,9 +4714,9 @@ int cgroup_delete_cgroup_ext(struct cgroup *cgrp, int flags)
 							flags);
 		}
 
-		if (parent_tasks) {
-			fclose(parent_tasks);
-			parent_tasks = NULL;
+		if (parent_tasks >= 0) {
+			close(parent_tasks);
+			parent_tasks = -1;
 		}
 		free(parent_name);
 		parent_name = NULL;
@@ -3716,242 +4749,561 @@ int cgroup_delete_cgroup_ext(struct cgroup *cgrp, int flags)
 	return first_error;
 }
 
-/*
- * This function should really have more checks, but this version will assume
- * that the callers have taken care of everything. Including the locking.
- */
-static int cg_rd_ctrl_file(const char *subsys, const char *cgrp, const char *file, char **value)
+int cg_read_fd_all(int fd, char **buf, size_t *size, size_t *len)
 {
-	char path[FILENAME_MAX];
-	FILE *ctrl_file = NULL;
-	int ret;
+	size_t read_len = 0;
+	size_t new_size;
+	ssize_t ret;
+	char *tmp;
 
-	if (!cg_build_path_locked(cgrp, path, subsys))
-		return ECGFAIL;
+	while (true) {
+		/* Keep room for at least one byte and the NUL */
+		if (*size < read_len + 2) {
+			new_size = *size ? *size * 2 : CG_CONTROL_VALUE_MAX;
 
-	strncat(path, file, sizeof(path) - strlen(path) - 1);
-	ctrl_file = fopen(path, "re");
-	if (!ctrl_file)
-		return ECGROUPVALUENOTEXIST;
+			tmp = realloc(*buf, new_size);
+			if (!tmp) {
+				last_errno = errno;
+				return ECGOTHER;
+			}
 
-	*value = calloc(CG_CONTROL_VALUE_MAX, 1);
-	if (!*value) {
-		fclose(ctrl_file);
-		last_errno = errno;
-		return ECGOTHER;
-	}
+			*buf = tmp;
+			*size = new_size;
+		}
 
-	/* Using %as crashes when we try to read from files like memory.stat */
-	ret = fread(*value, 1, CG_CONTROL_VALUE_MAX-1, ctrl_file);
-	if (ret < 0) {
-		free(*value);
-		*value = NULL;
-	} else {
-		/* Remove trailing \n */
-		if (ret > 0 && (*value)[ret-1] == '\n')
-			(*value)[ret-1] = '\0';
+		/* Reading from offset 0 makes the kernel regenerate the content */
+		ret = pread(fd, *buf + read_len, *size - 1 - read_len, read_len);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+
+			last_errno = errno;
+			return ECGOTHER;
+		}
+		if (ret == 0)
+			break;
+
+		read_len += ret;
 	}
 
-	fclose(ctrl_file);
+	/* Remove trailing \n */
+	if (read_len > 0 && (*buf)[read_len - 1] == '\n')
+		read_len--;
+	(*buf)[read_len] = '\0';
+
+	if (len)
+		*len = read_len;
 
 	return 0;
 }
 
 /*
- * Call this function with required locks taken.
+ * Read the setting file of the cgroup directory dirfd into *buf, see
+ * cg_read_fd_all().  Values of any size, e.g. memory.stat on large NUMA
+ * machines, are read intact.
+ *
+ * This function should really have more checks, but this version will assume
+ * that the callers have taken care of everything. Including the locking.
  */
-int cgroup_fill_cgc(struct dirent *ctrl_dir, struct cgroup *cgrp, struct cgroup_controller *cgc,
-		    int cg_index)
+static int cg_rd_ctrl_file_at(int dirfd, const char *file, char **buf, size_t *size, size_t *len)
+{
+	int ctrl_file;
+	int error;
+
+	ctrl_file = openat(dirfd, file, O_RDONLY | O_CLOEXEC);
+	if (ctrl_file < 0)
+		return ECGROUPVALUENOTEXIST;
+
+	error = cg_read_fd_all(ctrl_file, buf, size, len);
+	close(ctrl_file);
+
+	return error;
+}
+
+/*
+ * Store the owner of the setting file name as the owner of the cgroup.
+ *
+ * We have already stored the tasks_uid & tasks_gid. This check is
+ * to avoid the overwriting of the values stored in
+ * control_uid & cotrol_gid. tasks file will have the uid and gid of
+ * the user who is capable of putting a task to this cgroup.
+ * control_uid and control_gid is meant for the users who are capable
+ * of managing the cgroup shares.
+ */
+static int cg_fill_owner_at(int dirfd, const char *name, struct cgroup *cgrp)
 {
-	char path[FILENAME_MAX+1];
 	struct stat stat_buffer;
-	char *ctrl_value = NULL;
-	char *ctrl_name = NULL;
-	char *ctrl_file = NULL;
-	char *tmp_path = NULL;
-	char *d_name = NULL;
-	char *buffer = NULL;
-	int tmp_len = 0;
-	int error = 0;
 
-	d_name = strdup(ctrl_dir->d_name);
+	if (fstatat(dirfd, name, &stat_buffer, 0))
+		return ECGFAIL;
 
-	if (!d_name) {
-		error = ECGOTHER;
-		cgroup_err("strdup failed to allocate memory: %s\n", strerror(errno));
-		goto fill_error;
+	if (strcmp(name, "tasks")) {
+		cgrp->control_uid = stat_buffer.st_uid;
+		cgrp->control_gid = stat_buffer.st_gid;
 	}
 
-	if (!strcmp(d_name, ".") || !strcmp(d_name, "..")) {
-		error = ECGINVAL;
-		goto fill_error;
-	}
+	return 0;
+}
 
-	/*
-	 * This part really needs to be optimized out. Probably use some
-	 * sort of a flag, but this is fine for now.
-	 */
-	cg_build_path_locked(cgrp->name, path, cg_mount_table[cg_index].name);
-	strncat(path, d_name, sizeof(path) - strlen(path) - 1);
+/*
+ * Settings that cgroup v2 hands over to the delegatee of a group, along
+ * with the cgroup.* files, when CGV2_DELEGATE_FILE can't be read.
+ */
+static const char * const cg_delegated_files_dflt[] = {
+	"memory.oom.group",
+	"memory.reclaim",
+	NULL,
+};
 
-	error = stat(path, &stat_buffer);
-	if (error) {
-		error = ECGFAIL;
-		goto fill_error;
-	}
+/* The delegated files listed by the kernel, see cg_read_delegated_files() */
+static pthread_once_t cg_delegate_once = PTHREAD_ONCE_INIT;
+static const char * const *cg_delegated_files = cg_delegated_files_dflt;
+static const char *cg_delegate_names[64];
+static char cg_delegate_buf[4096];
 
-	/*
-	 * We have already stored the tasks_uid & tasks_gid. This check is
-	 * to avoid the overwriting of the values stored in
-	 * control_uid & cotrol_gid. tasks file will have the uid and gid of
-	 * the user who is capable of putting a task to this cgroup.
-	 * control_uid and control_gid is meant for the users who are capable
-	 * of managing the cgroup shares.
-	 *
-	 * The strstr() function will return the pointer to the
-	 * beginning of the sub string "/tasks".
-	 */
-	tmp_len = strlen(path) - strlen("/tasks");
+/*
+ * Read the list of the delegated files once, it depends on the kernel only.
+ * cg_delegated_files_dflt is kept if it can't be read whole.
+ */
+static void cg_read_delegated_files(void)
+{
+	char *saveptr = NULL;
+	ssize_t len;
+	char *name;
+	int cnt = 0;
+	int fd;
 
-	/* tmp_path would be pointing to the last six characters */
-	tmp_path = (char *)path + tmp_len;
+	fd = open(CGV2_DELEGATE_FILE, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return;
 
-	/*
-	 * Checking to see, if this is actually a 'tasks' file We need to
-	 * compare the last 6 bytes
-	 */
-	if (strcmp(tmp_path, "/tasks")) {
-		cgrp->control_uid = stat_buffer.st_uid;
-		cgrp->control_gid = stat_buffer.st_gid;
-	}
+	len = read(fd, cg_delegate_buf, sizeof(cg_delegate_buf) - 1);
+	close(fd);
+	if (len <= 0 || len == sizeof(cg_delegate_buf) - 1)
+		return;
+	cg_delegate_buf[len] = '\0';
 
-	ctrl_name = strtok_r(d_name, ".", &buffer);
-	if (!ctrl_name) {
-		error = ECGFAIL;
-		goto fill_error;
+	for (name = strtok_r(cg_delegate_buf, "\n", &saveptr); name;
+	     name = strtok_r(NULL, "\n", &saveptr)) {
+		if (cnt == ARRAY_SIZE(cg_delegate_names) - 1)
+			return;
+		cg_delegate_names[cnt++] = name;
 	}
+	cg_delegate_names[cnt] = NULL;
 
-	ctrl_file = strtok_r(NULL, ".", &buffer);
-	if (!ctrl_file) {
-		error = ECGINVAL;
-		goto fill_error;
-	}
+	cg_delegated_files = cg_delegate_names;
+}
+
+/*
+ * Returns true if the file name is a setting of controller that isn't
+ * delegated, i.e. whose owner is the owner of the settings of the cgroup.
+ */
+static bool cg_is_owner_file(const char *name, const char *controller)
+{
+	size_t len = strlen(controller);
+	int i;
+
+	if (strncmp(name, controller, len) || name[len] != '.')
+		return false;
 
-	if (strcmp(ctrl_name, cg_mount_table[cg_index].name) == 0) {
-		error = cg_rd_ctrl_file(cg_mount_table[cg_index].name, cgrp->name,
-					ctrl_dir->d_name, &ctrl_value);
-		if (error || !ctrl_value)
-			goto fill_error;
+	pthread_once(&cg_delegate_once, cg_read_delegated_files);
 
-		if (cgroup_add_value_string(cgc, ctrl_dir->d_name, ctrl_value)) {
-			error = ECGFAIL;
-			goto fill_error;
-		}
+	for (i = 0; cg_delegated_files[i]; i++) {
+		if (!strcmp(name, cg_delegated_files[i]))
+			return false;
 	}
-fill_error:
-	if (ctrl_value)
-		free(ctrl_value);
-	if (d_name)
-		free(d_name);
 
-	return error;
+	return true;
 }
 
 /*
- * cgroup_get_cgroup reads the cgroup data from the filesystem.
- * struct cgroup has the name of the group to be populated
- *
- * return 0 on success.
+ * Add the value of the setting file name to cgc, if the file belongs to
+ * the controller of cgc, i.e. its name is <controller>.<setting>.  *buf is
+ * a scratch buffer of *size bytes for the value, see cg_read_fd_all().  With
+ * lazy, only the name is added and the value is read on first access.
+ * Call this function with required locks taken.
  */
-int cgroup_get_cgroup(struct cgroup *cgrp)
+static int cg_fill_value_at(int dirfd, const char *name, struct cgroup_controller *cgc,
+			    int cg_index, char **buf, size_t *size, bool lazy)
 {
-	char cgrp_ctrl_path[FILENAME_MAX];
-	struct dirent *ctrl_dir = NULL;
-	char mnt_path[FILENAME_MAX];
-	int initial_controller_cnt;
-	char *control_path = NULL;
-	int controller_cnt = 0;
-	DIR *dir = NULL;
+	const char *ctrl_name = cg_mount_table[cg_index].name;
+	struct control_value *val;
+	size_t ctrl_len, len;
 	int error;
-	int i, j;
-	int ret;
 
-	if (!cgroup_initialized) {
-		/* ECGROUPNOTINITIALIZED */
-		return ECGROUPNOTINITIALIZED;
-	}
+	if (!strcmp(name, ".") || !strcmp(name, ".."))
+		return ECGINVAL;
 
-	if (!cgrp) {
-		/* ECGROUPNOTALLOWED */
-		return ECGROUPNOTALLOWED;
+	/* Files without a dot, e.g. tasks, aren't settings */
+	if (name[0] == '.' || !strchr(name, '.'))
+		return ECGINVAL;
+
+	ctrl_len = strlen(ctrl_name);
+	if (strncmp(name, ctrl_name, ctrl_len) || name[ctrl_len] != '.')
+		return 0;
+
+	if (lazy) {
+		/* Only the name is stored, the value is read on first access */
+		if (cgroup_add_value_string(cgc, name, NULL))
+			return ECGFAIL;
+
+		cgc->values[cgc->index - 1]->unread = true;
+		return 0;
 	}
 
-	initial_controller_cnt = cgrp->index;
+	error = cg_rd_ctrl_file_at(dirfd, name, buf, size, &len);
+	if (error)
+		return error;
 
-	pthread_rwlock_rdlock(&cg_mount_table_lock);
-	for (i = 0; i < CG_CONTROLLER_MAX && cg_mount_table[i].name[0] != '\0'; i++) {
-		struct cgroup_controller *cgc;
-		struct stat stat_buffer;
-		int mnt_path_len;
+	/* The value may exceed the limit of cgroup_add_value_string() */
+	if (cgroup_add_value_string(cgc, name, NULL))
+		return ECGFAIL;
 
-		if (initial_controller_cnt > 0) {
-			bool skip_this_controller = true;
+	val = cgc->values[cgc->index - 1];
+	if (cg_set_value_len(cgc, val, *buf, len))
+		return ECGFAIL;
+	val->dirty = true;
 
-			/*
-			 * The user has specified a list of controllers they are interested
-			 * in.  Only operate on the specified controllers
-			 */
-			for (j = 0; j < cgrp->index; j++) {
-				if (strncmp(cg_mount_table[i].name, cgrp->controller[j]->name,
-					    CONTROL_NAMELEN_MAX) == 0)
-					skip_this_controller = false;
-			}
+	return 0;
+}
 
-			if (skip_this_controller)
-				continue;
-		}
+/*
+ * Read the values of cgc from index first on, that were added unread, from
+ * the cgroup directory dirfd in one batch.  With drop, the settings that
+ * can't be read, e.g. write-only files, are removed from cgc; otherwise
+ * the first error is returned.
+ * Call this function with required locks taken.
+ */
+static int cg_fill_batch_at(int dirfd, struct cgroup_controller *cgc, int first,
+			    struct cg_read_batch *batch, bool drop)
+{
+	struct control_value *val;
+	struct cg_read_file *file;
+	int error, i, cnt;
 
-		if (!cg_build_path_locked(NULL, mnt_path, cg_mount_table[i].name))
-			continue;
+	batch->cnt = 0;
+	for (i = first; i < cgc->index; i++) {
+		error = cg_read_batch_add(batch, dirfd, cgc->values[i]->name);
+		if (error)
+			return error;
+	}
 
-		mnt_path_len = strlen(mnt_path);
-		strncat(mnt_path, cgrp->name, FILENAME_MAX - mnt_path_len - 1);
-		mnt_path[sizeof(mnt_path) - 1] = '\0';
+	cg_read_batch_run(batch);
 
-		if (access(mnt_path, F_OK))
-			continue;
+	for (i = first, cnt = first; i < cgc->index; i++) {
+		val = cgc->values[i];
+		file = &batch->files[i - first];
 
-		if (!cg_build_path_locked(cgrp->name, cgrp_ctrl_path, cg_mount_table[i].name)) {
-			/* This fails when the cgroup does not exist for that controller. */
+		if (file->error) {
+			if (!drop)
+				return file->error;
+			/* The room of the name stays in the arena until the group is freed */
 			continue;
 		}
 
-		/* Get the uid and gid information. */
-		if (cg_mount_table[i].version == CGROUP_V1) {
-			ret = asprintf(&control_path, "%s/tasks", cgrp_ctrl_path);
+		if (cg_set_value_len(cgc, val, file->buf, file->len))
+			return ECGFAIL;
+		val->unread = false;
+		val->dirty = true;
+		cgc->values[cnt++] = val;
+	}
+	cgc->index = cnt;
 
-			if (ret < 0) {
-				last_errno = errno;
-				error = ECGOTHER;
-				goto unlock_error;
+	return 0;
+}
+
+/*
+ * Read only the settings already present in cgc from the cgroup directory
+ * dirfd, in one batch.  With lazy, the values are left to be read on first
+ * access.
+ * Call this function with required locks taken.
+ */
+static int cg_fill_requested_at(int dirfd, struct cgroup *cgrp, struct cgroup_controller *cgc,
+				struct cg_read_batch *batch, bool lazy)
+{
+	int owner = 0;
+	int error;
+	int i;
+
+	/* The setting files share the owner, stat only one */
+	for (i = 0; i < cgc->index; i++) {
+		if (cg_is_owner_file(cgc->values[i]->name, cgc->name)) {
+			owner = i;
+			break;
+		}
+	}
+
+	error = cg_fill_owner_at(dirfd, cgc->values[owner]->name, cgrp);
+	if (error)
+		return errno == ENOENT ? ECGROUPVALUENOTEXIST : error;
+
+	for (i = 0; i < cgc->index; i++)
+		cgc->values[i]->unread = true;
+
+	if (lazy)
+		return 0;
+
+	return cg_fill_batch_at(dirfd, cgc, 0, batch, false);
+}
+
+/*
+ * Read the value val of the controller cgc, that was left unread by
+ * cgroup_get_cgroup_ext(), into *buf, see cg_read_fd_all().
+ */
+int cg_read_lazy_value(const struct cgroup_controller * const cgc,
+		       const struct control_value * const val, char **buf, size_t *size,
+		       size_t *len)
+{
+	int dirfd, error;
+
+	if (!cgc->cgroup)
+		return ECGINVAL;
+
+	pthread_rwlock_rdlock(&cg_mount_table_lock);
+	dirfd = cg_open_cgroup_file_locked(cgc->cgroup->name, cgc->name, NULL,
+					   O_PATH | O_DIRECTORY);
+	pthread_rwlock_unlock(&cg_mount_table_lock);
+	if (dirfd < 0) {
+		if (errno == ENOENT)
+			return ECGROUPNOTEXIST;
+
+		last_errno = errno;
+		return ECGOTHER;
+	}
+
+	error = cg_rd_ctrl_file_at(dirfd, val->name, buf, size, len);
+	close(dirfd);
+
+	return error;
+}
+
+/*
+ * Read the value val of cgc if it was left unread by cgroup_get_cgroup_ext(),
+ * see CGFLAG_GET_LAZY.
+ */
+int cg_load_lazy_value(struct cgroup_controller *cgc, struct control_value *val)
+{
+	size_t size = 0, len;
+	char *value = NULL;
+	int error;
+
+	if (!val->unread)
+		return 0;
+
+	error = cg_read_lazy_value(cgc, val, &value, &size, &len);
+	if (!error)
+		error = cg_set_value_len(cgc, val, value, len);
+	free(value);
+	if (error)
+		return error;
+
+	val->unread = false;
+
+	return 0;
+}
+
+/*
+ * Fill cgc with the setting ctrl_dir of the cgroup directory dirfd.
+ * Call this function with required locks taken.
+ */
+static int cgroup_fill_cgc_at(int dirfd, struct dirent *ctrl_dir, struct cgroup *cgrp,
+			      struct cgroup_controller *cgc, int cg_index)
+{
+	size_t size = 0;
+	char *value = NULL;
+	int error;
+
+	if (!strcmp(ctrl_dir->d_name, ".") || !strcmp(ctrl_dir->d_name, ".."))
+		return ECGINVAL;
+
+	error = cg_fill_owner_at(dirfd, ctrl_dir->d_name, cgrp);
+	if (error)
+		return error;
+
+	error = cg_fill_value_at(dirfd, ctrl_dir->d_name, cgc, cg_index, &value, &size, false);
+	free(value);
+
+	return error;
+}
+
+/*
+ * Fill cgc with all the settings of the cgroup directory stream dir.  The
+ * names are gathered from readdir first, and the values are read in one
+ * batch; the settings that can't be read are dropped.  With lazy, the
+ * values are left to be read on first access.
+ * Call this function with required locks taken.
+ */
+static int cg_fill_dir(DIR *dir, struct cgroup *cgrp, struct cgroup_controller *cgc,
+		       int cg_index, struct cg_read_batch *batch, bool lazy)
+{
+	char owner_file[NAME_MAX + 1] = { '\0' };
+	struct dirent *ctrl_dir;
+	bool owner_read = false;
+	int first = cgc->index;
+	int error;
+
+	while ((ctrl_dir = readdir(dir)) != NULL) {
+		/* Skip over non regular files */
+		if (ctrl_dir->d_type != DT_REG)
+			continue;
+
+		/*
+		 * The setting files share the owner, stat only one.
+		 * The cgroup.* files may be delegated to another user.
+		 */
+		if (!owner_read && cg_is_owner_file(ctrl_dir->d_name, cgc->name)) {
+			error = cg_fill_owner_at(dirfd(dir), ctrl_dir->d_name, cgrp);
+			if (error)
+				return error;
+			owner_read = true;
+		} else if (!owner_read && strcmp(ctrl_dir->d_name, "tasks")) {
+			/* As before, the last file if the controller has no settings */
+			snprintf(owner_file, sizeof(owner_file), "%s", ctrl_dir->d_name);
+		}
+
+		error = cg_fill_value_at(dirfd(dir), ctrl_dir->d_name, cgc, cg_index, NULL,
+					 NULL, true);
+		if (error == ECGFAIL)
+			return error;
+	}
+
+	if (!owner_read && owner_file[0] != '\0') {
+		error = cg_fill_owner_at(dirfd(dir), owner_file, cgrp);
+		if (error)
+			return error;
+	}
+
+	if (lazy)
+		return 0;
+
+	return cg_fill_batch_at(dirfd(dir), cgc, first, batch, true);
+}
+
+/*
+ * Call this function with required locks taken.
+ */
+int cgroup_fill_cgc_dir(DIR *dir, struct cgroup *cgrp, struct cgroup_controller *cgc,
+			int cg_index)
+{
+	struct cg_read_batch batch = {0};
+	int error;
+
+	error = cg_fill_dir(dir, cgrp, cgc, cg_index, &batch, false);
+	cg_read_batch_free(&batch);
+
+	return error;
+}
+
+/*
+ * Call this function with required locks taken.
+ */
+int cgroup_fill_cgc(struct dirent *ctrl_dir, struct cgroup *cgrp, struct cgroup_controller *cgc,
+		    int cg_index)
+{
+	int dirfd, error;
+
+	dirfd = cg_open_cgroup_file_locked(cgrp->name, cg_mount_table[cg_index].name, NULL,
+					   O_PATH);
+	if (dirfd < 0)
+		return ECGFAIL;
+
+	error = cgroup_fill_cgc_at(dirfd, ctrl_dir, cgrp, cgc, cg_index);
+	close(dirfd);
+
+	return error;
+}
+
+/*
+ * cgroup_get_cgroup reads the cgroup data from the filesystem.
+ * struct cgroup has the name of the group to be populated
+ *
+ * return 0 on success.
+ */
+int cgroup_get_cgroup(struct cgroup *cgrp)
+{
+	return cgroup_get_cgroup_ext(cgrp, 0);
+}
+
+int cgroup_get_cgroup_ext(struct cgroup *cgrp, int flags)
+{
+	bool lazy = flags & CGFLAG_GET_LAZY;
+	/* The values are read in batches, then copied to their cgc */
+	struct cg_read_batch batch = {0};
+	int initial_controller_cnt;
+	int controller_cnt = 0;
+	int cgrp_dirfd = -1;
+	DIR *dir = NULL;
+	int error;
+	int i, j;
+
+	if (!cgroup_initialized) {
+		/* ECGROUPNOTINITIALIZED */
+		return ECGROUPNOTINITIALIZED;
+	}
+
+	if (!cgrp) {
+		/* ECGROUPNOTALLOWED */
+		return ECGROUPNOTALLOWED;
+	}
+
+	initial_controller_cnt = cgrp->index;
+
+	/* The ring is reused by the controllers, until the end of the call */
+	batch.keep_ring = true;
+
+	pthread_rwlock_rdlock(&cg_mount_table_lock);
+	for (i = 0; i < CG_CONTROLLER_MAX && cg_mount_table[i].name[0] != '\0'; i++) {
+		struct cgroup_controller *cgc;
+		struct stat stat_buffer;
+
+		if (initial_controller_cnt > 0) {
+			bool skip_this_controller = true;
+
+			/*
+			 * The user has specified a list of controllers they are interested
+			 * in.  Only operate on the specified controllers
+			 */
+			for (j = 0; j < cgrp->index; j++) {
+				if (strncmp(cg_mount_table[i].name, cgrp->controller[j]->name,
+					    CONTROL_NAMELEN_MAX) == 0)
+					skip_this_controller = false;
 			}
 
-			if (stat(control_path, &stat_buffer)) {
+			if (skip_this_controller)
+				continue;
+		}
+
+		/*
+		 * Open the cgroup directory once, everything else is read
+		 * relative to it.  This fails when the cgroup does not exist
+		 * for that controller.
+		 */
+		cgrp_dirfd = cg_open_cgroup_file_locked(cgrp->name, cg_mount_table[i].name, NULL,
+							O_RDONLY);
+		if (cgrp_dirfd < 0) {
+			if (errno == ENOENT || errno == ENOTDIR || errno == ENODEV)
+				continue;
+
+			last_errno = errno;
+			error = ECGOTHER;
+			goto unlock_error;
+		}
+
+		/* Get the uid and gid information. */
+		if (cg_mount_table[i].version == CGROUP_V1) {
+			if (fstatat(cgrp_dirfd, "tasks", &stat_buffer, 0)) {
 				last_errno = errno;
-				free(control_path);
 				error = ECGOTHER;
 				goto unlock_error;
 			}
 
 			cgrp->tasks_uid = stat_buffer.st_uid;
 			cgrp->tasks_gid = stat_buffer.st_gid;
-
-			free(control_path);
 		} else { /* cgroup v2 */
 			bool enabled;
 
-			error = cgroupv2_get_controllers(cgrp_ctrl_path, cg_mount_table[i].name,
-							 &enabled);
+			error = cgroupv2_get_controllers_at(cgrp_dirfd, cg_mount_table[i].name,
+							    &enabled);
 			if (error == ECGROUPNOTMOUNTED) {
 				/*
 				 * This controller isn't enabled.  Only hide it from the
@@ -3962,6 +5314,8 @@ int cgroup_get_cgroup(struct cgroup *cgrp)
 				 * interested in this controller and we should not remove it.
 				 */
 				if (initial_controller_cnt == 0) {
+					close(cgrp_dirfd);
+					cgrp_dirfd = -1;
 					controller_cnt++;
 					continue;
 				}
@@ -3979,30 +5333,36 @@ int cgroup_get_cgroup(struct cgroup *cgrp)
 			goto unlock_error;
 		}
 
-		dir = opendir(cgrp_ctrl_path);
+		controller_cnt++;
+
+		if (cgc->index > 0) {
+			/* The caller asked for these settings only */
+			error = cg_fill_requested_at(cgrp_dirfd, cgrp, cgc, &batch, lazy);
+			close(cgrp_dirfd);
+			cgrp_dirfd = -1;
+			if (error)
+				goto unlock_error;
+
+			goto fill_done;
+		}
+
+		/* The directory stream takes over cgrp_dirfd */
+		dir = fdopendir(cgrp_dirfd);
 		if (!dir) {
 			last_errno = errno;
 			error = ECGOTHER;
 			goto unlock_error;
 		}
+		cgrp_dirfd = -1;
 
-		controller_cnt++;
-
-		while ((ctrl_dir = readdir(dir)) != NULL) {
-			/* Skip over non regular files */
-			if (ctrl_dir->d_type != DT_REG)
-				continue;
-
-			error = cgroup_fill_cgc(ctrl_dir, cgrp, cgc, i);
-			for (j = 0; j < cgc->index; j++)
-				cgc->values[j]->dirty = false;
-
-			if (error == ECGFAIL) {
-				closedir(dir);
-				goto unlock_error;
-			}
-		}
+		error = cg_fill_dir(dir, cgrp, cgc, i, &batch, lazy);
 		closedir(dir);
+		if (error)
+			goto unlock_error;
+
+fill_done:
+		for (j = 0; j < cgc->index; j++)
+			cgc->values[j]->dirty = false;
 
 		if (!strcmp(cgc->name, "memory")) {
 			/*
@@ -4041,11 +5401,15 @@ int cgroup_get_cgroup(struct cgroup *cgrp)
 	}
 
 	pthread_rwlock_unlock(&cg_mount_table_lock);
+	cg_read_batch_free(&batch);
 
 	return 0;
 
 unlock_error:
 	pthread_rwlock_unlock(&cg_mount_table_lock);
+	cg_read_batch_free(&batch);
+	if (cgrp_dirfd >= 0)
+		close(cgrp_dirfd);
 	/*
 	 * XX: Need to figure out how to cleanup? Cleanup just the stuff
 	 * we added, or the whole structure.
@@ -4656,7 +6020,12 @@ end:
 	return ret;
 }
 
-int cgroup_change_cgroup_flags(uid_t uid, gid_t gid, const char *procname, pid_t pid, int flags)
+/*
+ * Move pid to the group of the rule matching it, or queue the move to
+ * migrator if it isn't NULL.
+ */
+static int cg_change_cgroup_flags(uid_t uid, gid_t gid, const char *procname, pid_t pid,
+				  int flags, struct cgroup_migrator *migrator)
 {
 	/* Temporary pointer to a rule */
 	struct cgroup_rule *tmp = NULL;
@@ -4833,8 +6202,12 @@ int cgroup_change_cgroup_flags(uid_t uid, gid_t gid, const char *procname, pid_t
 		}
 
 		/* Apply the rule */
-		ret = cgroup_change_cgroup_path(newdest, pid,
-						(const char * const *)tmp->controllers);
+		if (migrator)
+			ret = cgroup_migrator_add(migrator, newdest,
+						  (const char * const *)tmp->controllers, pid);
+		else
+			ret = cgroup_change_cgroup_path(newdest, pid,
+							(const char * const *)tmp->controllers);
 		if (ret) {
 			cgroup_warn("failed to apply the rule. Error was: %d\n", ret);
 			goto finished;
@@ -4853,6 +6226,20 @@ finished:
 	return ret;
 }
 
+int cgroup_change_cgroup_flags(uid_t uid, gid_t gid, const char *procname, pid_t pid, int flags)
+{
+	return cg_change_cgroup_flags(uid, gid, procname, pid, flags, NULL);
+}
+
+int cgroup_migrator_classify(struct cgroup_migrator *migrator, uid_t uid, gid_t gid,
+			     const char *procname, pid_t pid, int flags)
+{
+	if (!migrator)
+		return ECGINVAL;
+
+	return cg_change_cgroup_flags(uid, gid, procname, pid, flags, migrator);
+}
+
 int cgroup_change_cgroup_uid_gid_flags(uid_t uid, gid_t gid, pid_t pid, int flags)
 {
 	return cgroup_change_cgroup_flags(uid, gid, NULL, pid, flags);
@@ -4873,28 +6260,14 @@ int cgroup_change_cgroup_uid_gid(uid_t uid, gid_t gid, pid_t pid)
 	return cgroup_change_cgroup_uid_gid_flags(uid, gid, pid, 0);
 }
 
-/**
- * Changes the cgroup of a program based on the path provided.  In this case,
- * the user must already know into which cgroup the task should be placed and
- * no rules will be parsed.
- *
- *  returns 0 on success.
+/*
+ * Fill in cgrp with the cgroup dest and the given controllers, like
+ * cg_prepare_cgroup() does.
  */
-int cgroup_change_cgroup_path(const char *dest, pid_t pid, const char *const controllers[])
+static int cg_prepare_cgroup_path(struct cgroup *cgrp, pid_t pid, const char *dest,
+				  const char * const controllers[])
 {
-	struct dirent *task_dir = NULL;
-	char path[FILENAME_MAX];
-	struct cgroup cgrp;
-	int nr, ret;
-	pid_t tid;
-	DIR *dir;
-
-	if (!cgroup_initialized) {
-		cgroup_warn("libcgroup is not initialized\n");
-		return ECGROUPNOTINITIALIZED;
-	}
-	memset(&cgrp, 0, sizeof(struct cgroup));
-
+	memset(cgrp, 0, sizeof(struct cgroup));
 
 	if (is_cgroup_mode_unified() && !controllers) {
 		/*
@@ -4902,31 +6275,47 @@ int cgroup_change_cgroup_path(const char *dest, pid_t pid, const char *const con
 		 * cgroup v2 systems.  The hierarchy will be the same regardless of
 		 * whether controllers are provided or not.
 		 */
-		strncpy(cgrp.name, dest, FILENAME_MAX);
-		cgrp.name[FILENAME_MAX-1] = '\0';
-	} else {
-		if (!controllers)
-			return ECGINVAL;
-
-		ret = cg_prepare_cgroup(&cgrp, pid, dest, controllers);
-		if (ret)
-			return ret;
+		strncpy(cgrp->name, dest, FILENAME_MAX);
+		cgrp->name[FILENAME_MAX-1] = '\0';
+		return 0;
 	}
 
+	if (!controllers)
+		return ECGINVAL;
+
+	return cg_prepare_cgroup(cgrp, pid, dest, controllers);
+}
+
+/* Attach the process pid and all its threads */
+static int cg_attach_plan_apply_process(struct cg_attach_plan *plan, pid_t pid)
+{
+	struct dirent *task_dir = NULL;
+	char path[FILENAME_MAX];
+	int nr, ret;
+	pid_t tid;
+	DIR *dir;
+
 	/* Add process to cgroup */
-	ret = cgroup_attach_task_pid(&cgrp, pid);
+	ret = cg_attach_plan_apply(plan, pid, 0);
 	if (ret) {
 		cgroup_warn("cgroup_attach_task_pid failed: %d\n", ret);
-		goto finished;
+		return ret;
 	}
 
+	/*
+	 * On cgroup v2 the write to cgroup.procs has already moved all the
+	 * threads.  The tasks file on v1, and cgroup.threads in threaded
+	 * subtrees, only move the given thread.
+	 */
+	if (!cg_attach_plan_per_thread(plan))
+		return 0;
+
 	/* Add all threads to cgroup */
 	snprintf(path, FILENAME_MAX, "/proc/%d/task/", pid);
 	dir = opendir(path);
 	if (!dir) {
 		last_errno = errno;
-		ret = ECGOTHER;
-		goto finished;
+		return ECGOTHER;
 	}
 
 	while ((task_dir = readdir(dir)) != NULL) {
@@ -4937,7 +6326,7 @@ int cgroup_change_cgroup_path(const char *dest, pid_t pid, const char *const con
 		if (tid == pid)
 			continue;
 
-		ret = cgroup_attach_task_pid(&cgrp, tid);
+		ret = cg_attach_plan_apply(plan, tid, 1);
 		if (ret) {
 			cgroup_warn("cgroup_attach_task_pid failed: %d\n", ret);
 			break;
@@ -4946,12 +6335,487 @@ int cgroup_change_cgroup_path(const char *dest, pid_t pid, const char *const con
 
 	closedir(dir);
 
+	return ret;
+}
+
+/**
+ * Changes the cgroup of a program based on the path provided.  In this case,
+ * the user must already know into which cgroup the task should be placed and
+ * no rules will be parsed.
+ *
+ *  returns 0 on success.
+ */
+int cgroup_change_cgroup_path(const char *dest, pid_t pid, const char *const controllers[])
+{
+	struct cg_attach_plan plan = { 0 };
+	struct cgroup cgrp;
+	int ret;
+
+	if (!cgroup_initialized) {
+		cgroup_warn("libcgroup is not initialized\n");
+		return ECGROUPNOTINITIALIZED;
+	}
+
+	ret = cg_prepare_cgroup_path(&cgrp, pid, dest, controllers);
+	if (ret)
+		return ret;
+
+	/*
+	 * Resolve the destination once, it's the same for the process and
+	 * all its threads
+	 */
+	ret = cg_attach_plan_build(&cgrp, 0, &plan);
+	if (ret)
+		goto finished;
+
+	ret = cg_attach_plan_apply_process(&plan, pid);
+
 finished:
+	cg_attach_plan_free(&plan);
+	cgroup_free_controllers(&cgrp);
+
+	return ret;
+}
+
+static uint64_t cg_migrator_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int cgroup_migrator_create(unsigned int rate, unsigned int burst,
+			   struct cgroup_migrator **migrator)
+{
+	if (!migrator)
+		return ECGINVAL;
+
+	*migrator = calloc(1, sizeof(**migrator));
+	if (!*migrator) {
+		last_errno = errno;
+		return ECGOTHER;
+	}
+
+	(*migrator)->rate = rate;
+	(*migrator)->burst = burst ? burst : 1;
+	(*migrator)->tokens = (*migrator)->burst;
+
+	return 0;
+}
+
+/* Find the queue of the destination path, or add one */
+static int cg_migrator_get_dest(struct cgroup_migrator *migrator, const char *path,
+				const char * const controllers[],
+				struct cgroup_migrator_dest **dest)
+{
+	char ctrls[FILENAME_MAX] = "";
+	struct cgroup_migrator_dest *itr;
+	size_t len = 0;
+	int i;
+
+	for (i = 0; controllers && controllers[i] && i < CG_CONTROLLER_MAX; i++) {
+		len += snprintf(ctrls + len, sizeof(ctrls) - len, "%s%s", i ? "," : "",
+				controllers[i]);
+		if (len >= sizeof(ctrls))
+			return ECGINVAL;
+	}
+
+	for (itr = migrator->dests; itr; itr = itr->next) {
+		if (strcmp(itr->name, path) == 0 && strcmp(itr->controllers, ctrls) == 0) {
+			*dest = itr;
+			return 0;
+		}
+	}
+
+	if (strlen(path) >= FILENAME_MAX)
+		return ECGINVAL;
+
+	itr = calloc(1, sizeof(*itr));
+	if (!itr) {
+		last_errno = errno;
+		return ECGOTHER;
+	}
+
+	strcpy(itr->name, path);
+	strcpy(itr->controllers, ctrls);
+
+	if (migrator->tail)
+		migrator->tail->next = itr;
+	else
+		migrator->dests = itr;
+	migrator->tail = itr;
+
+	*dest = itr;
+
+	return 0;
+}
+
+int cgroup_migrator_add(struct cgroup_migrator *migrator, const char *path,
+			const char * const controllers[], pid_t pid)
+{
+	struct cgroup_migrator_dest *dest;
+	uint64_t *queued_ns;
+	size_t size;
+	pid_t *pids;
+	int ret;
+
+	if (!migrator || !path)
+		return ECGINVAL;
+
+	ret = cg_migrator_get_dest(migrator, path, controllers, &dest);
+	if (ret)
+		return ret;
+
+	if (dest->cnt == dest->size) {
+		size = dest->size ? dest->size * 2 : 64;
+
+		pids = realloc(dest->pids, size * sizeof(*pids));
+		if (!pids) {
+			last_errno = errno;
+			return ECGOTHER;
+		}
+		dest->pids = pids;
+
+		queued_ns = realloc(dest->queued_ns, size * sizeof(*queued_ns));
+		if (!queued_ns) {
+			last_errno = errno;
+			return ECGOTHER;
+		}
+		dest->queued_ns = queued_ns;
+
+		dest->size = size;
+	}
+
+	dest->pids[dest->cnt] = pid;
+	dest->queued_ns[dest->cnt] = cg_migrator_now_ns();
+	dest->cnt++;
+
+	return 0;
+}
+
+/* Wait for a token of the bucket, if the migrator is rate limited */
+static void cg_migrator_take_token(struct cgroup_migrator *migrator)
+{
+	struct timespec ts;
+	uint64_t now, wait_ns;
+
+	if (!migrator->rate)
+		return;
+
+	while (1) {
+		now = cg_migrator_now_ns();
+		if (migrator->refill_ns) {
+			migrator->tokens += (double)(now - migrator->refill_ns) *
+					    migrator->rate / 1e9;
+			if (migrator->tokens > migrator->burst)
+				migrator->tokens = migrator->burst;
+		}
+		migrator->refill_ns = now;
+
+		if (migrator->tokens >= 1)
+			break;
+
+		wait_ns = (1 - migrator->tokens) * 1e9 / migrator->rate + 1;
+		ts.tv_sec = wait_ns / 1000000000ULL;
+		ts.tv_nsec = wait_ns % 1000000000ULL;
+		nanosleep(&ts, NULL);
+	}
+
+	migrator->tokens -= 1;
+}
+
+static void cg_migrator_free_dest(struct cgroup_migrator_dest *dest)
+{
+	free(dest->pids);
+	free(dest->queued_ns);
+	free(dest);
+}
+
+/* Move the processes queued for dest, the destination is resolved once */
+static int cg_migrator_flush_dest(struct cgroup_migrator *migrator,
+				  struct cgroup_migrator_dest *dest)
+{
+	const char *controllers[CG_CONTROLLER_MAX + 1];
+	struct cgroup_migrator_stats *stats = &migrator->stats;
+	struct cg_attach_plan plan = { 0 };
+	char ctrls[FILENAME_MAX];
+	uint64_t latency_ns;
+	struct cgroup cgrp;
+	int first_ret = 0;
+	char *saveptr;
+	int i = 0;
+	size_t j;
+	int ret;
+
+	stats->batches++;
+
+	strcpy(ctrls, dest->controllers);
+	controllers[0] = strtok_r(ctrls, ",", &saveptr);
+	while (controllers[i] && i < CG_CONTROLLER_MAX)
+		controllers[++i] = strtok_r(NULL, ",", &saveptr);
+	controllers[i] = NULL;
+
+	ret = cg_prepare_cgroup_path(&cgrp, dest->pids[0], dest->name,
+				     controllers[0] ? controllers : NULL);
+	if (ret)
+		goto fail_all;
+
+	ret = cg_attach_plan_build(&cgrp, 0, &plan);
+	cgroup_free_controllers(&cgrp);
+	if (ret)
+		goto fail_all;
+
+	for (i = 0; i < plan.cnt; i++) {
+		ret = cg_attach_dest_open(&plan.dests[i]);
+		if (ret)
+			goto fail_all;
+	}
+
+	for (j = 0; j < dest->cnt; j++) {
+		cg_migrator_take_token(migrator);
+
+		ret = cg_attach_plan_apply_process(&plan, dest->pids[j]);
+		if (ret) {
+			stats->failed++;
+			if (!first_ret)
+				first_ret = ret;
+			continue;
+		}
+
+		latency_ns = cg_migrator_now_ns() - dest->queued_ns[j];
+		migrator->latency_ns += latency_ns;
+		if (latency_ns / 1000 > stats->max_latency_us)
+			stats->max_latency_us = latency_ns / 1000;
+		stats->moved++;
+	}
+
+	cg_attach_plan_free(&plan);
+
+	return first_ret;
+
+fail_all:
+	cgroup_warn("cannot move %zu processes to %s: %s\n", dest->cnt, dest->name,
+		    cgroup_strerror(ret));
+	cg_attach_plan_free(&plan);
+	stats->failed += dest->cnt;
+
+	return ret;
+}
+
+int cgroup_migrator_flush(struct cgroup_migrator *migrator)
+{
+	struct cgroup_migrator_dest *dest;
+	uint64_t start_ns;
+	int first_ret = 0;
+	int ret;
+
+	if (!cgroup_initialized) {
+		cgroup_warn("libcgroup is not initialized\n");
+		return ECGROUPNOTINITIALIZED;
+	}
+
+	if (!migrator)
+		return ECGINVAL;
+
+	start_ns = cg_migrator_now_ns();
+
+	while ((dest = migrator->dests) != NULL) {
+		migrator->dests = dest->next;
+
+		if (dest->cnt) {
+			ret = cg_migrator_flush_dest(migrator, dest);
+			if (ret && !first_ret)
+				first_ret = ret;
+		}
+
+		cg_migrator_free_dest(dest);
+	}
+	migrator->tail = NULL;
+
+	migrator->flush_ns += cg_migrator_now_ns() - start_ns;
+
+	return first_ret;
+}
+
+int cgroup_migrator_get_stats(const struct cgroup_migrator *migrator,
+			      struct cgroup_migrator_stats *stats)
+{
+	if (!migrator || !stats)
+		return ECGINVAL;
+
+	*stats = migrator->stats;
+
+	if (migrator->flush_ns)
+		stats->moves_per_sec = stats->moved * 1e9 / migrator->flush_ns;
+	if (stats->moved)
+		stats->avg_latency_us = migrator->latency_ns / stats->moved / 1000;
+
+	return 0;
+}
+
+void cgroup_migrator_free(struct cgroup_migrator **migrator)
+{
+	struct cgroup_migrator_dest *dest;
+
+	if (!migrator || !*migrator)
+		return;
+
+	while ((dest = (*migrator)->dests) != NULL) {
+		(*migrator)->dests = dest->next;
+		cg_migrator_free_dest(dest);
+	}
+
+	free(*migrator);
+	*migrator = NULL;
+}
+
+#ifndef CLONE_INTO_CGROUP
+#define CLONE_INTO_CGROUP	0x200000000ULL
+#endif
+
+/*
+ * struct clone_args of clone3(), up to the cgroup member, i.e.
+ * CLONE_ARGS_SIZE_VER2.  Defined here as the system headers may predate
+ * CLONE_INTO_CGROUP.
+ */
+struct cg_clone_args {
+	uint64_t flags;
+	uint64_t pidfd;
+	uint64_t child_tid;
+	uint64_t parent_tid;
+	uint64_t exit_signal;
+	uint64_t stack;
+	uint64_t stack_size;
+	uint64_t tls;
+	uint64_t set_tid;
+	uint64_t set_tid_size;
+	uint64_t cgroup;
+};
+
+/*
+ * Create a child process directly in the cgroup v2 directory dirfd, there
+ * is no migration, neither of the parent nor of the child.
+ */
+static int cg_clone3_into(int dirfd, pid_t *pid)
+{
+#ifdef __NR_clone3
+	struct cg_clone_args args;
+	long ret;
+
+	memset(&args, 0, sizeof(args));
+	args.flags = CLONE_INTO_CGROUP;
+	args.exit_signal = SIGCHLD;
+	args.cgroup = dirfd;
+
+	ret = syscall(__NR_clone3, &args, sizeof(args));
+	if (ret >= 0) {
+		*pid = ret;
+		return 0;
+	}
+
+	switch (errno) {
+	case ENOSYS:
+	case E2BIG:
+		/* clone3() or CLONE_INTO_CGROUP isn't known to the kernel */
+		cgroup_dbg("clone3(CLONE_INTO_CGROUP) is not supported\n");
+		return ECGROUPUNSUPP;
+	case EPERM:
+	case EACCES:
+		return ECGROUPNOTOWNER;
+	default:
+		last_errno = errno;
+		return ECGOTHER;
+	}
+#else
+	return ECGROUPUNSUPP;
+#endif
+}
+
+int cgroup_clone_into_cgroup_path(const char *dest, const char * const controllers[], pid_t *pid)
+{
+	struct cg_attach_plan plan = { 0 };
+	struct cgroup cgrp;
+	char *file_name;
+	int dirfd;
+	int ret;
+
+	if (!cgroup_initialized) {
+		cgroup_warn("libcgroup is not initialized\n");
+		return ECGROUPNOTINITIALIZED;
+	}
+
+	if (!dest || !pid)
+		return ECGINVAL;
+
+	ret = cg_prepare_cgroup_path(&cgrp, getpid(), dest, controllers);
+	if (ret)
+		return ret;
+
+	ret = cg_attach_plan_build(&cgrp, 0, &plan);
+	if (ret)
+		goto out;
+
+	/*
+	 * The child can be born in a single cgroup v2 directory only.  The
+	 * tasks file of cgroup v1 hierarchies, and the cgroup.threads file of
+	 * threaded cgroups, need a migration.
+	 */
+	if (plan.cnt != 1 || !plan.dests[0].whole_process) {
+		cgroup_dbg("cgroup %s can't be used with CLONE_INTO_CGROUP\n", dest);
+		ret = ECGROUPUNSUPP;
+		goto out;
+	}
+
+	/* The directory of cgroup.procs is the cgroup */
+	file_name = strrchr(plan.dests[0].path, '/');
+	*file_name = '\0';
+
+	dirfd = open(plan.dests[0].path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dirfd < 0) {
+		last_errno = errno;
+		ret = errno == ENOENT ? ECGROUPNOTEXIST : ECGOTHER;
+		goto out;
+	}
+
+	/*
+	 * The child of the raw clone3() must not call free() or anything else
+	 * that isn't async-signal-safe, release everything before.
+	 */
+	cg_attach_plan_free(&plan);
+	cgroup_free_controllers(&cgrp);
+
+	/* Both the parent and the child return from here */
+	ret = cg_clone3_into(dirfd, pid);
+	close(dirfd);
+
+	return ret;
+
+out:
+	cg_attach_plan_free(&plan);
 	cgroup_free_controllers(&cgrp);
 
 	return ret;
 }
 
+/* Parse CGROUP_MIGRATE_RATE, i.e. rate[:burst] */
+static void cg_migrate_rate_from_env(unsigned int *rate, unsigned int *burst)
+{
+	char *rate_str = getenv("CGROUP_MIGRATE_RATE");
+
+	*rate = 0;
+	*burst = 0;
+
+	if (!rate_str)
+		return;
+
+	if (sscanf(rate_str, "%u:%u", rate, burst) < 1) {
+		cgroup_warn("invalid CGROUP_MIGRATE_RATE %s\n", rate_str);
+		*rate = 0;
+	}
+}
+
 /**
  * Changes the cgroup of all running PIDs based on the rules in the config file.
  * If a rule exists for a PID, then the PID is placed in the correct group.
@@ -4962,13 +6826,24 @@ finished:
  */
 int cgroup_change_all_cgroups(void)
 {
+	struct cgroup_migrator_stats stats;
+	struct cgroup_migrator *migrator;
 	struct dirent *pid_dir = NULL;
+	unsigned int rate, burst;
 	char *path = "/proc/";
 	DIR *dir;
+	int ret;
+
+	cg_migrate_rate_from_env(&rate, &burst);
+	ret = cgroup_migrator_create(rate, burst, &migrator);
+	if (ret)
+		return -ret;
 
 	dir = opendir(path);
-	if (!dir)
+	if (!dir) {
+		cgroup_migrator_free(&migrator);
 		return -ECGOTHER;
+	}
 
 	while ((pid_dir = readdir(dir)) != NULL) {
 		int err, pid;
@@ -4988,7 +6863,8 @@ int cgroup_change_all_cgroups(void)
 		if (err)
 			continue;
 
-		err = cgroup_change_cgroup_flags(euid, egid, procname, pid, CGFLAG_USECACHE);
+		err = cgroup_migrator_classify(migrator, euid, egid, procname, pid,
+					       CGFLAG_USECACHE);
 		if (err)
 			cgroup_dbg("cgroup change pid %i failed\n", pid);
 
@@ -4996,6 +6872,17 @@ int cgroup_change_all_cgroups(void)
 	}
 
 	closedir(dir);
+
+	/* Processes that exited in the meantime fail to move, it's fine */
+	cgroup_migrator_flush(migrator);
+
+	cgroup_migrator_get_stats(migrator, &stats);
+	cgroup_dbg("moved %lu processes, %lu failed, %.0f moves/s, queue latency ",
+		   stats.moved, stats.failed, stats.moves_per_sec);
+	cgroup_dbg("avg %lu us max %lu us\n", stats.avg_latency_us, stats.max_latency_us);
+
+	cgroup_migrator_free(&migrator);
+
 	return 0;
 }
 
@@ -5545,11 +7432,10 @@ int cgroup_read_value_next(void **handle, char *buffer, int max)
 int cgroup_read_value_begin(const char * const controller, const char *path,
 			    const char * const name, void **handle, char *buffer, int max)
 {
-	char stat_file[FILENAME_MAX + sizeof(name)];
-	char stat_path[FILENAME_MAX];
 	char *ret_c = NULL;
 	int ret = 0;
 	FILE *fp;
+	int fd;
 
 	if (!cgroup_initialized)
 		return ECGROUPNOTINITIALIZED;
@@ -5557,12 +7443,14 @@ int cgroup_read_value_begin(const char * const controller, const char *path,
 	if (!buffer || !handle)
 		return ECGINVAL;
 
-	if (!cg_build_path(path, stat_path, controller))
+	fd = cg_open_cgroup_file(path, controller, name, O_RDONLY);
+	if (fd < 0 && errno == ENODEV)
 		return ECGOTHER;
 
-	snprintf(stat_file, sizeof(stat_file), "%s/%s", stat_path, name);
-	fp = fopen(stat_file, "re");
+	fp = fd < 0 ? NULL : fdopen(fd, "re");
 	if (!fp) {
+		if (fd >= 0)
+			close(fd);
 		cgroup_warn("fopen failed\n");
 		last_errno = errno;
 		*handle = NULL;
@@ -5619,10 +7507,10 @@ int cgroup_read_stats_next(void **handle, struct cgroup_stat *cgrp_stat)
 int cgroup_read_stats_begin(const char *controller, const char *path, void **handle,
 			    struct cgroup_stat *cgrp_stat)
 {
-	char stat_file[FILENAME_MAX + sizeof(".stat")];
-	char stat_path[FILENAME_MAX];
+	char stat_file[CONTROL_NAMELEN_MAX + sizeof(".stat")];
 	int ret = 0;
 	FILE *fp;
+	int fd;
 
 	if (!cgroup_initialized)
 		return ECGROUPNOTINITIALIZED;
@@ -5630,13 +7518,16 @@ int cgroup_read_stats_begin(const char *controller, const char *path, void **han
 	if (!cgrp_stat || !handle)
 		return ECGINVAL;
 
-	if (!cg_build_path(path, stat_path, controller))
-		return ECGOTHER;
+	snprintf(stat_file, sizeof(stat_file), "%s.stat", controller);
 
-	snprintf(stat_file, sizeof(stat_file), "%s/%s.stat", stat_path, controller);
+	fd = cg_open_cgroup_file(path, controller, stat_file, O_RDONLY);
+	if (fd < 0 && errno == ENODEV)
+		return ECGOTHER;
 
-	fp = fopen(stat_file, "re");
+	fp = fd < 0 ? NULL : fdopen(fd, "re");
 	if (!fp) {
+		if (fd >= 0)
+			close(fd);
 		cgroup_warn("fopen failed\n");
 		return ECGINVAL;
 	}
@@ -5647,7 +7538,37 @@ int cgroup_read_stats_begin(const char *controller, const char *path, void **han
 	return ret;
 }
 
-int cgroup_get_task_end(void **handle)
+int cgroup_read_stats_typed(const char *controller, const char *path, const char *name,
+			    struct cgroup_stats *stats)
+{
+	int fd, ret;
+
+	if (!cgroup_initialized)
+		return ECGROUPNOTINITIALIZED;
+
+	if (!controller || !path || !name || !stats)
+		return ECGINVAL;
+
+	fd = cg_open_cgroup_file(path, controller, name, O_RDONLY);
+	if (fd < 0) {
+		if (errno == ENODEV)
+			return ECGROUPSUBSYSNOTMOUNTED;
+		if (errno == ENOENT)
+			return ECGROUPVALUENOTEXIST;
+
+		last_errno = errno;
+		return ECGOTHER;
+	}
+
+	ret = cg_read_fd_all(fd, &stats->buf, &stats->buf_size, NULL);
+	close(fd);
+	if (ret)
+		return ret;
+
+	return cgroup_parse_stats(stats->buf, stats);
+}
+
+int cgroup_get_task_end(void **handle)
 {
 	if (!cgroup_initialized)
 		return ECGROUPNOTINITIALIZED;
@@ -5685,28 +7606,22 @@ int cgroup_get_task_next(void **handle, pid_t *pid)
 
 int cgroup_get_task_begin(const char *cgrp, const char *controller, void **handle, pid_t *pid)
 {
-	char path[FILENAME_MAX];
-	char *fullpath = NULL;
 	int ret = 0;
+	int fd;
 
 	if (!cgroup_initialized)
 		return ECGROUPNOTINITIALIZED;
 
-	if (!cg_build_path(cgrp, path, controller))
-		return ECGOTHER;
-
-	ret = asprintf(&fullpath, "%s/tasks", path);
-
-	if (ret < 0) {
+	fd = cg_open_cgroup_file(cgrp, controller, "tasks", O_RDONLY);
+	if (fd < 0) {
 		last_errno = errno;
 		return ECGOTHER;
 	}
 
-	*handle = (void *) fopen(fullpath, "re");
-	free(fullpath);
-
+	*handle = (void *) fdopen(fd, "re");
 	if (!*handle) {
 		last_errno = errno;
+		close(fd);
 		return ECGOTHER;
 	}
 	ret = cgroup_get_task_next(handle, pid);
@@ -6328,69 +8243,150 @@ static int pid_compare(const void *a, const void *b)
 	return (*pid1 - *pid2);
 }
 
-/* pids needs to be completely uninitialized so that we can set it up
- *
- * Caller must free up pids.
+/* Size of the chunks cgroup.procs and cgroup.threads are read in */
+#define CG_PIDS_CHUNK		16384
+/* Initial size of a list of pids */
+#define CG_PIDS_MIN		64
+
+/* Append pid to the list *pids of *size pids, n of which are used */
+static int cg_pids_append(pid_t **pids, int *size, int n, long pid)
+{
+	pid_t *new_pids;
+	int new_size;
+
+	if (n == *size) {
+		new_size = *size ? *size * 2 : CG_PIDS_MIN;
+
+		new_pids = realloc(*pids, new_size * sizeof(pid_t));
+		if (!new_pids) {
+			last_errno = errno;
+			return ECGOTHER;
+		}
+
+		*pids = new_pids;
+		*size = new_size;
+	}
+
+	(*pids)[n] = pid;
+
+	return 0;
+}
+
+/*
+ * Read the pids of the file path, one per line, into *pids, a buffer of
+ * *size pids, NULL or allocated with malloc(), that is grown as needed.
+ * The file is read in chunks and scanned by hand, much faster than with
+ * fscanf() for large groups.
  */
-static int read_pids(char *path, pid_t **pids, int *size)
+static int cg_read_pids(const char *path, pid_t **pids, int *size, int *cnt, int flags)
 {
-	int tot_pids = 16;
-	pid_t *tmp_list;
-	FILE *pid_file;
+	bool count_only = flags & CGFLAG_GET_PIDS_COUNT;
+	char chunk[CG_PIDS_CHUNK];
+	bool in_pid = false;
+	const char *p, *end;
+	int error = 0;
+	long pid = 0;
+	ssize_t ret;
 	int n = 0;
-	int err;
+	int fd;
 
-	pid_file = fopen(path, "r");
-	if (!pid_file) {
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
 		last_errno = errno;
-		*pids = NULL;
-		*size = 0;
-		if (errno == ENOENT)
-			return ECGROUPUNSUPP;
-		else
-			return ECGOTHER;
+		return errno == ENOENT ? ECGROUPUNSUPP : ECGOTHER;
 	}
 
-	/* Keep doubling the memory allocated if needed */
-	tmp_list = malloc(sizeof(pid_t) * tot_pids);
-	if (!tmp_list) {
-		last_errno = errno;
-		fclose(pid_file);
-		return ECGOTHER;
+	/* The list is allocated even if empty, as cgroup_get_procs() always did */
+	if (!count_only && *size == 0) {
+		error = cg_pids_append(pids, size, 0, 0);
+		if (error)
+			goto out;
 	}
 
-	while (!feof(pid_file)) {
-		while (!feof(pid_file) && n < tot_pids) {
-			pid_t pid;
+	while ((ret = read(fd, chunk, sizeof(chunk))) != 0) {
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			last_errno = errno;
+			error = ECGOTHER;
+			goto out;
+		}
 
-			err = fscanf(pid_file, "%u", &pid);
-			if (err == EOF)
-				break;
-			tmp_list[n] = pid;
-			n++;
+		end = chunk + ret;
+
+		if (count_only) {
+			/* One pid per line, count the lines */
+			for (p = chunk; (p = memchr(p, '\n', end - p)) != NULL; p++)
+				n++;
+			in_pid = end[-1] != '\n';
+			continue;
 		}
-		if (!feof(pid_file)) {
-			pid_t *orig_list = tmp_list;
 
-			tot_pids *= 2;
-			tmp_list = realloc(tmp_list, sizeof(pid_t) * tot_pids);
-			if (!tmp_list) {
-				last_errno = errno;
-				fclose(pid_file);
-				free(orig_list);
-				*pids = NULL;
-				*size = 0;
-				return ECGOTHER;
+		for (p = chunk; p < end; p++) {
+			if (*p >= '0' && *p <= '9') {
+				pid = pid * 10 + (*p - '0');
+				if (pid > INT_MAX) {
+					error = ECGINVAL;
+					goto out;
+				}
+				in_pid = true;
+				continue;
+			}
+
+			if (*p != '\n') {
+				error = ECGINVAL;
+				goto out;
 			}
+
+			if (!in_pid)
+				continue;
+
+			error = cg_pids_append(pids, size, n++, pid);
+			if (error)
+				goto out;
+			pid = 0;
+			in_pid = false;
 		}
 	}
-	fclose(pid_file);
 
-	*size = n;
-	qsort(tmp_list, n, sizeof(pid_t), &pid_compare);
-	*pids = tmp_list;
+	/* The last line may miss its newline */
+	if (in_pid) {
+		if (!count_only)
+			error = cg_pids_append(pids, size, n, pid);
+		n++;
+	}
 
-	return 0;
+	if (!error && (flags & CGFLAG_GET_PIDS_SORT) && !count_only)
+		qsort(*pids, n, sizeof(pid_t), &pid_compare);
+
+out:
+	close(fd);
+	if (!error)
+		*cnt = n;
+
+	return error;
+}
+
+/*
+ * pids needs to be completely uninitialized so that we can set it up
+ *
+ * Caller must free up pids.
+ */
+static int read_pids(char *path, pid_t **pids, int *size)
+{
+	int pids_size = 0;
+	int ret;
+
+	*pids = NULL;
+
+	ret = cg_read_pids(path, pids, &pids_size, size, CGFLAG_GET_PIDS_SORT);
+	if (ret) {
+		free(*pids);
+		*pids = NULL;
+		*size = 0;
+	}
+
+	return ret;
 }
 
 int cgroup_get_procs(const char *name, const char *controller, pid_t **pids, int *size)
@@ -6413,6 +8409,392 @@ int cgroup_get_threads(const char *name, const char *controller, pid_t **pids, i
 	return read_pids(cgroup_path, pids, size);
 }
 
+/* Read the pids of file, cgroup.procs or cgroup.threads, of the cgroup name */
+static int cg_get_pids_ext(const char *name, const char *controller, const char *file,
+			   pid_t **pids, int *size, int *cnt, int flags)
+{
+	char cgroup_path[FILENAME_MAX];
+
+	if (!cgroup_initialized)
+		return ECGROUPNOTINITIALIZED;
+
+	if (!cnt || (!(flags & CGFLAG_GET_PIDS_COUNT) && (!pids || !size)))
+		return ECGINVAL;
+
+	if (!cg_build_path(name, cgroup_path, controller))
+		return ECGROUPSUBSYSNOTMOUNTED;
+	strncat(cgroup_path, file, FILENAME_MAX - strlen(cgroup_path) - 1);
+
+	return cg_read_pids(cgroup_path, pids, size, cnt, flags);
+}
+
+int cgroup_get_procs_ext(const char *name, const char *controller, pid_t **pids, int *size,
+			 int *cnt, int flags)
+{
+	return cg_get_pids_ext(name, controller, "/cgroup.procs", pids, size, cnt, flags);
+}
+
+int cgroup_get_threads_ext(const char *name, const char *controller, pid_t **pids, int *size,
+			   int *cnt, int flags)
+{
+	return cg_get_pids_ext(name, controller, "/cgroup.threads", pids, size, cnt, flags);
+}
+
+/*
+ * Add the directory of the cgroup in the hierarchy of controller to the
+ * handle.  Controllers sharing a hierarchy share the directory.
+ * Call with cg_mount_table_lock taken.
+ */
+static int cgroup_handle_add_controller(struct cgroup_handle *handle, const char *controller)
+{
+	struct stat st;
+	int dirfd;
+	int i;
+
+	if (handle->ctrl_cnt >= CG_CONTROLLER_MAX)
+		return ECGMAXVALUESEXCEEDED;
+
+	dirfd = cg_open_cgroup_file_locked(handle->name, controller, NULL, O_PATH);
+	if (dirfd < 0) {
+		if (errno == ENODEV)
+			return ECGROUPSUBSYSNOTMOUNTED;
+		if (errno == ENOENT || errno == ENOTDIR)
+			return ECGROUPNOTEXIST;
+
+		last_errno = errno;
+		return ECGOTHER;
+	}
+
+	if (fstat(dirfd, &st)) {
+		last_errno = errno;
+		close(dirfd);
+		return ECGOTHER;
+	}
+
+	for (i = 0; i < handle->dir_cnt; i++) {
+		if (handle->dir_dev[i] == st.st_dev && handle->dir_ino[i] == st.st_ino)
+			break;
+	}
+
+	if (i < handle->dir_cnt) {
+		close(dirfd);
+	} else {
+		handle->dirfds[i] = dirfd;
+		handle->dir_dev[i] = st.st_dev;
+		handle->dir_ino[i] = st.st_ino;
+		cgroup_get_controller_version(controller, &handle->dir_version[i]);
+		handle->dir_cnt++;
+	}
+
+	snprintf(handle->controllers[handle->ctrl_cnt], CONTROL_NAMELEN_MAX, "%s", controller);
+	handle->ctrl_dir[handle->ctrl_cnt] = i;
+	handle->ctrl_cnt++;
+
+	return 0;
+}
+
+int cgroup_open(const char *name, const char * const controllers[],
+		struct cgroup_handle **handle)
+{
+	struct cgroup_handle *new_handle;
+	int ret = 0;
+	int i;
+
+	if (!cgroup_initialized)
+		return ECGROUPNOTINITIALIZED;
+
+	if (!name || !handle)
+		return ECGINVAL;
+
+	new_handle = calloc(1, sizeof(*new_handle));
+	if (!new_handle) {
+		last_errno = errno;
+		return ECGOTHER;
+	}
+
+	snprintf(new_handle->name, sizeof(new_handle->name), "%s", name);
+
+	pthread_rwlock_rdlock(&cg_mount_table_lock);
+	if (controllers) {
+		for (i = 0; controllers[i]; i++) {
+			ret = cgroup_handle_add_controller(new_handle, controllers[i]);
+			if (ret)
+				break;
+		}
+	} else {
+		for (i = 0; i < CG_CONTROLLER_MAX && cg_mount_table[i].name[0] != '\0'; i++) {
+			/* Skip the hierarchies the cgroup doesn't exist in */
+			ret = cgroup_handle_add_controller(new_handle, cg_mount_table[i].name);
+			if (ret && ret != ECGROUPNOTEXIST)
+				break;
+			ret = 0;
+		}
+	}
+	pthread_rwlock_unlock(&cg_mount_table_lock);
+
+	if (!ret && new_handle->dir_cnt == 0)
+		ret = ECGROUPNOTEXIST;
+
+	if (ret) {
+		cgroup_close(new_handle);
+		return ret;
+	}
+
+	*handle = new_handle;
+
+	return 0;
+}
+
+void cgroup_close(struct cgroup_handle *handle)
+{
+	struct cgroup_handle_file *file, *next;
+	int i;
+
+	if (!handle)
+		return;
+
+	for (file = handle->files; file; file = next) {
+		next = file->next;
+		close(file->fd);
+		free(file->name);
+		free(file);
+	}
+
+	for (i = 0; i < handle->dir_cnt; i++)
+		close(handle->dirfds[i]);
+
+	free(handle);
+}
+
+/*
+ * Return the directory the parameter name lives in, based on its
+ * controller prefix, or -1 if the controller isn't part of the handle.
+ */
+static int cgroup_handle_find_dir(const struct cgroup_handle *handle, const char *name)
+{
+	size_t ctrl_len;
+	const char *dot;
+	int i;
+
+	/* Files without a prefix, e.g. tasks, exist in every v1 hierarchy */
+	dot = strchr(name, '.');
+	if (!dot) {
+		for (i = 0; i < handle->dir_cnt; i++) {
+			if (handle->dir_version[i] == CGROUP_V1)
+				return i;
+		}
+
+		return -1;
+	}
+
+	ctrl_len = dot - name;
+	for (i = 0; i < handle->ctrl_cnt; i++) {
+		if (strlen(handle->controllers[i]) == ctrl_len &&
+		    strncmp(handle->controllers[i], name, ctrl_len) == 0)
+			return handle->ctrl_dir[i];
+	}
+
+	/* cgroup.* files exist in every hierarchy */
+	if (ctrl_len == strlen(CGRP_FILE_PREFIX) &&
+	    strncmp(name, CGRP_FILE_PREFIX, ctrl_len) == 0)
+		return 0;
+
+	return -1;
+}
+
+/*
+ * Return the cached fd of the file name in the directory dir, open it if
+ * it's not cached yet.  Returns -1 and sets errno on failure.
+ */
+static int cgroup_handle_get_fd(struct cgroup_handle *handle, int dir, const char *name,
+				int flags)
+{
+	struct cgroup_handle_file *file;
+	int fd;
+
+	for (file = handle->files; file; file = file->next) {
+		if (file->dir == dir && file->flags == flags && strcmp(file->name, name) == 0)
+			return file->fd;
+	}
+
+	fd = openat(handle->dirfds[dir], name, flags | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	file = calloc(1, sizeof(*file));
+	if (file)
+		file->name = strdup(name);
+
+	if (!file || !file->name) {
+		free(file);
+		close(fd);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	file->dir = dir;
+	file->flags = flags;
+	file->fd = fd;
+	file->next = handle->files;
+	handle->files = file;
+
+	return fd;
+}
+
+int cgroup_handle_read(struct cgroup_handle *handle, const char *name, char *value,
+		       size_t len)
+{
+	size_t read_len = 0;
+	ssize_t ret;
+	int dir, fd;
+
+	if (!handle || !name || !value || len == 0)
+		return ECGINVAL;
+
+	dir = cgroup_handle_find_dir(handle, name);
+	if (dir < 0)
+		return ECGROUPSUBSYSNOTMOUNTED;
+
+	fd = cgroup_handle_get_fd(handle, dir, name, O_RDONLY);
+	if (fd < 0) {
+		last_errno = errno;
+		return errno == ENOENT ? ECGROUPVALUENOTEXIST : ECGOTHER;
+	}
+
+	/* Reading from offset 0 makes the kernel regenerate the content */
+	while (read_len < len - 1) {
+		ret = pread(fd, value + read_len, len - 1 - read_len, read_len);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+
+			last_errno = errno;
+			value[0] = '\0';
+			return ECGOTHER;
+		}
+		if (ret == 0)
+			break;
+
+		read_len += ret;
+	}
+
+	if (read_len > 0 && value[read_len - 1] == '\n')
+		read_len--;
+	value[read_len] = '\0';
+
+	return 0;
+}
+
+int cgroup_handle_read_all(struct cgroup_handle *handle, const char *name, char **value,
+			   size_t *size)
+{
+	int dir, fd;
+
+	if (!handle || !name || !value || !size)
+		return ECGINVAL;
+
+	dir = cgroup_handle_find_dir(handle, name);
+	if (dir < 0)
+		return ECGROUPSUBSYSNOTMOUNTED;
+
+	fd = cgroup_handle_get_fd(handle, dir, name, O_RDONLY);
+	if (fd < 0) {
+		last_errno = errno;
+		return errno == ENOENT ? ECGROUPVALUENOTEXIST : ECGOTHER;
+	}
+
+	return cg_read_fd_all(fd, value, size, NULL);
+}
+
+int cgroup_handle_read_stats(struct cgroup_handle *handle, const char *name,
+			     struct cgroup_stats *stats)
+{
+	int ret;
+
+	if (!stats)
+		return ECGINVAL;
+
+	ret = cgroup_handle_read_all(handle, name, &stats->buf, &stats->buf_size);
+	if (ret)
+		return ret;
+
+	return cgroup_parse_stats(stats->buf, stats);
+}
+
+int cgroup_handle_write(struct cgroup_handle *handle, const char *name, const char *value)
+{
+	const char *line, *end;
+	size_t line_len;
+	int dir, fd;
+
+	if (!handle || !name || !value)
+		return ECGINVAL;
+
+	dir = cgroup_handle_find_dir(handle, name);
+	if (dir < 0)
+		return ECGROUPSUBSYSNOTMOUNTED;
+
+	fd = cgroup_handle_get_fd(handle, dir, name, O_WRONLY);
+	if (fd < 0) {
+		last_errno = errno;
+		return errno == ENOENT ? ECGROUPVALUENOTEXIST : ECGOTHER;
+	}
+
+	/* Every line is a separate write, like cg_set_control_value() does */
+	for (line = value; *line != '\0'; line = end) {
+		end = strchr(line, '\n');
+		if (!end)
+			end = line + strlen(line);
+
+		line_len = end - line;
+		if (*end == '\n')
+			end++;
+
+		if (line_len == 0)
+			continue;
+
+		if (pwrite(fd, line, line_len, 0) < 0) {
+			last_errno = errno;
+			return ECGOTHER;
+		}
+	}
+
+	return 0;
+}
+
+int cgroup_handle_attach(struct cgroup_handle *handle, pid_t pid)
+{
+	char pid_str[16];
+	int pid_len;
+	int fd, i;
+
+	if (!handle)
+		return ECGINVAL;
+
+	pid_len = snprintf(pid_str, sizeof(pid_str), "%d", pid);
+
+	for (i = 0; i < handle->dir_cnt; i++) {
+		fd = cgroup_handle_get_fd(handle, i, "cgroup.procs", O_WRONLY);
+		if (fd < 0 || pwrite(fd, pid_str, pid_len, 0) < 0) {
+			last_errno = errno;
+			cgroup_warn("cannot attach pid %d to %s: %s\n", pid, handle->name,
+				    strerror(errno));
+
+			switch (errno) {
+			case EPERM:
+			case EACCES:
+				return ECGROUPNOTOWNER;
+			case ENOENT:
+				return ECGROUPNOTEXIST;
+			default:
+				return ECGOTHER;
+			}
+		}
+	}
+
+	return 0;
+}
+
 int cgroup_dictionary_create(struct cgroup_dictionary **dict,
 			     int flags)
 {
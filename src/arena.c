@@ -0,0 +1,258 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+/**
+ * Compact storage of the setting names and values
+ *
+ * A setting value used to embed buffers for the longest name and value,
+ * about 8 KB, even for a value like "max".  The names are now interned, i.e.
+ * every distinct name is stored once per process.  The controllers of a
+ * cgroup and their values live in a bump arena of the cgroup, so building
+ * a cgroup takes a handful of allocations and freeing it even fewer.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <libcgroup.h>
+#include <libcgroup-internal.h>
+
+#include <pthread.h>
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+/* The chunks double from the minimum to the maximum size */
+#define CG_ARENA_CHUNK_MIN	1024
+#define CG_ARENA_CHUNK_MAX	16384
+
+/* The interned names are looked up in an open addressing hash table */
+#define CG_INTERN_MIN_SIZE	256
+
+struct cg_arena_chunk {
+	struct cg_arena_chunk *next;
+	size_t size;
+	size_t used;
+	alignas(max_align_t) char data[];
+};
+
+/* The arena is kept in its first chunk */
+struct cg_arena {
+	struct cg_arena_chunk *chunks;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	struct cg_arena *arena;
+	const char **names;
+	size_t size;
+	size_t cnt;
+} cg_intern = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static struct cg_arena_chunk *cg_arena_new_chunk(size_t size)
+{
+	struct cg_arena_chunk *chunk;
+
+	chunk = malloc(sizeof(*chunk) + size);
+	if (!chunk) {
+		last_errno = errno;
+		return NULL;
+	}
+
+	chunk->next = NULL;
+	chunk->size = size;
+	chunk->used = 0;
+
+	return chunk;
+}
+
+struct cg_arena *cg_arena_new(void)
+{
+	struct cg_arena_chunk *chunk;
+	struct cg_arena *arena;
+
+	chunk = cg_arena_new_chunk(CG_ARENA_CHUNK_MIN);
+	if (!chunk)
+		return NULL;
+
+	arena = (struct cg_arena *)chunk->data;
+	chunk->used = (sizeof(*arena) + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+	arena->chunks = chunk;
+
+	return arena;
+}
+
+void *cg_arena_alloc(struct cg_arena *arena, size_t size)
+{
+	struct cg_arena_chunk *chunk = arena->chunks;
+	size_t chunk_size;
+	void *mem;
+
+	size = (size + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+
+	if (chunk->size - chunk->used < size) {
+		chunk_size = chunk->size * 2;
+		if (chunk_size > CG_ARENA_CHUNK_MAX)
+			chunk_size = CG_ARENA_CHUNK_MAX;
+
+		/* Large allocations get a chunk of their own */
+		if (size > chunk_size)
+			chunk_size = size;
+
+		chunk = cg_arena_new_chunk(chunk_size);
+		if (!chunk)
+			return NULL;
+
+		if (chunk_size > CG_ARENA_CHUNK_MAX) {
+			/* Keep allocating from the current chunk */
+			chunk->next = arena->chunks->next;
+			arena->chunks->next = chunk;
+		} else {
+			chunk->next = arena->chunks;
+			arena->chunks = chunk;
+		}
+	}
+
+	mem = chunk->data + chunk->used;
+	chunk->used += size;
+	memset(mem, 0, size);
+
+	return mem;
+}
+
+void cg_arena_free(struct cg_arena *arena)
+{
+	struct cg_arena_chunk *chunk, *next;
+
+	if (!arena)
+		return;
+
+	/* One of the chunks holds the arena itself */
+	for (chunk = arena->chunks; chunk; chunk = next) {
+		next = chunk->next;
+		free(chunk);
+	}
+}
+
+/* FNV-1a */
+static size_t cg_intern_hash(const char *name, size_t len)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= (unsigned char)name[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+static int cg_intern_grow(void)
+{
+	size_t size = cg_intern.size ? cg_intern.size * 2 : CG_INTERN_MIN_SIZE;
+	const char **names;
+	size_t i, j;
+
+	names = calloc(size, sizeof(*names));
+	if (!names) {
+		last_errno = errno;
+		return ECGOTHER;
+	}
+
+	for (i = 0; i < cg_intern.size; i++) {
+		if (!cg_intern.names[i])
+			continue;
+
+		j = cg_intern_hash(cg_intern.names[i], strlen(cg_intern.names[i])) & (size - 1);
+		while (names[j])
+			j = (j + 1) & (size - 1);
+		names[j] = cg_intern.names[i];
+	}
+
+	free(cg_intern.names);
+	cg_intern.names = names;
+	cg_intern.size = size;
+
+	return 0;
+}
+
+const char *cg_intern_name(const char *name)
+{
+	const char *interned = NULL;
+	size_t len, i;
+	char *copy;
+
+	len = strnlen(name, FILENAME_MAX - 1);
+
+	pthread_mutex_lock(&cg_intern.lock);
+
+	/* Keep the table at most half full */
+	if (cg_intern.cnt * 2 >= cg_intern.size && cg_intern_grow())
+		goto out;
+
+	i = cg_intern_hash(name, len) & (cg_intern.size - 1);
+	while (cg_intern.names[i]) {
+		if (!strncmp(cg_intern.names[i], name, len) && cg_intern.names[i][len] == '\0') {
+			interned = cg_intern.names[i];
+			goto out;
+		}
+		i = (i + 1) & (cg_intern.size - 1);
+	}
+
+	if (!cg_intern.arena) {
+		cg_intern.arena = cg_arena_new();
+		if (!cg_intern.arena)
+			goto out;
+	}
+
+	copy = cg_arena_alloc(cg_intern.arena, len + 1);
+	if (!copy)
+		goto out;
+
+	memcpy(copy, name, len);
+	copy[len] = '\0';
+
+	cg_intern.names[i] = copy;
+	cg_intern.cnt++;
+	interned = copy;
+
+out:
+	pthread_mutex_unlock(&cg_intern.lock);
+
+	return interned;
+}
+
+int cg_set_value_len(struct cgroup_controller *cgc, struct control_value *val,
+		     const char *value, size_t len)
+{
+	char *mem;
+
+	if (len >= val->value_size) {
+		if (!cgc->arena)
+			return ECGINVAL;
+
+		/* The old room stays in the arena until the cgroup is freed */
+		mem = cg_arena_alloc(cgc->arena, len + 1);
+		if (!mem)
+			return ECGOTHER;
+
+		val->value = mem;
+		val->value_size = len + 1;
+	}
+
+	memmove(val->value, value, len);
+	val->value[len] = '\0';
+	val->value_len = len;
+
+	return 0;
+}
+
+int cg_set_value(struct cgroup_controller *cgc, struct control_value *val, const char *value)
+{
+	return cg_set_value_len(cgc, val, value, strlen(value));
+}
@@ -0,0 +1,526 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+/**
+ * Batched reads of many small files
+ *
+ * Reading a setting costs three system calls: openat, read and close.  When
+ * io_uring is available, the files of a batch are opened, read and closed by
+ * linked requests submitted together, i.e. with a single system call for
+ * many files.  The files are opened as direct descriptors, so the read
+ * doesn't need the fd returned by the open.  Without io_uring, or when it
+ * can't be used, e.g. it is disabled by a seccomp policy, the files are read
+ * one by one.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <libcgroup.h>
+#include <libcgroup-internal.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#ifdef HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#endif
+
+/* Initial size of the buffer of a file, grown to the largest value read */
+#define CG_READ_BUF_MIN		1024
+
+/* Initial number of files of a batch */
+#define CG_READ_BATCH_MIN	16
+
+int cg_read_batch_add(struct cg_read_batch *batch, int dirfd, const char *name)
+{
+	struct cg_read_file *files;
+	int size;
+
+	if (batch->cnt == batch->size) {
+		size = batch->size ? batch->size * 2 : CG_READ_BATCH_MIN;
+
+		files = realloc(batch->files, size * sizeof(*files));
+		if (!files) {
+			last_errno = errno;
+			return ECGOTHER;
+		}
+
+		/* The buffers of the files are kept from one batch to the next */
+		memset(files + batch->size, 0, (size - batch->size) * sizeof(*files));
+		batch->files = files;
+		batch->size = size;
+	}
+
+	batch->files[batch->cnt].dirfd = dirfd;
+	batch->files[batch->cnt].name = name;
+	batch->files[batch->cnt].len = 0;
+	batch->files[batch->cnt].error = 0;
+	batch->cnt++;
+
+	return 0;
+}
+
+static void cg_read_file_sync(struct cg_read_file *file)
+{
+	int fd;
+
+	fd = openat(file->dirfd, file->name, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		file->error = errno == ENOENT ? ECGROUPVALUENOTEXIST : ECGOTHER;
+		last_errno = errno;
+		return;
+	}
+
+	file->error = cg_read_fd_all(fd, &file->buf, &file->buf_size, &file->len);
+	close(fd);
+}
+
+#ifdef HAVE_LINUX_IO_URING_H
+
+/* Files in flight, each takes three submission entries */
+#define CG_URING_FILES		32
+#define CG_URING_ENTRIES	128
+
+/* The request of a file a completion is for, in the user data */
+#define CG_URING_OPEN		0
+#define CG_URING_READ		1
+#define CG_URING_CLOSE		2
+#define CG_URING_DATA(idx, op)	(((u_int64_t)(idx) << 2) | (op))
+
+/* The ring of a batch, see cg_uring_get() */
+struct cg_uring {
+	/* The process the ring was set up by, a forked child sets up its own */
+	pid_t pid;
+	int fd;
+	void *ring;
+	size_t ring_size;
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+	unsigned int *sq_head;
+	unsigned int *sq_tail;
+	unsigned int *sq_mask;
+	unsigned int *sq_array;
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int *cq_mask;
+	struct io_uring_cqe *cqes;
+};
+
+static pthread_once_t cg_uring_once = PTHREAD_ONCE_INIT;
+static bool cg_uring_supported;
+
+static void cg_uring_free(struct cg_uring *uring)
+{
+	if (uring->sqes)
+		munmap(uring->sqes, uring->sqes_size);
+	if (uring->ring)
+		munmap(uring->ring, uring->ring_size);
+	close(uring->fd);
+	free(uring);
+}
+
+static struct cg_uring *cg_uring_new(void)
+{
+	struct io_uring_params params;
+	int fds[CG_URING_FILES];
+	struct cg_uring *uring;
+	size_t cq_size;
+	unsigned int i;
+	void *ring;
+
+	uring = calloc(1, sizeof(*uring));
+	if (!uring)
+		return NULL;
+	uring->pid = getpid();
+
+	memset(&params, 0, sizeof(params));
+	uring->fd = syscall(__NR_io_uring_setup, CG_URING_ENTRIES, &params);
+	if (uring->fd < 0) {
+		free(uring);
+		return NULL;
+	}
+
+	/*
+	 * Skipping the completions of the opens, and with it the direct
+	 * descriptors, came with Linux 5.17.
+	 */
+	if (!(params.features & IORING_FEAT_SINGLE_MMAP) ||
+	    !(params.features & IORING_FEAT_CQE_SKIP))
+		goto err;
+
+	uring->ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if (cq_size > uring->ring_size)
+		uring->ring_size = cq_size;
+
+	ring = mmap(NULL, uring->ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		    uring->fd, IORING_OFF_SQ_RING);
+	if (ring == MAP_FAILED)
+		goto err;
+	uring->ring = ring;
+
+	uring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	uring->sqes = mmap(NULL, uring->sqes_size, PROT_READ | PROT_WRITE,
+			   MAP_SHARED | MAP_POPULATE, uring->fd, IORING_OFF_SQES);
+	if (uring->sqes == MAP_FAILED) {
+		uring->sqes = NULL;
+		goto err;
+	}
+
+	uring->sq_head = (unsigned int *)((char *)ring + params.sq_off.head);
+	uring->sq_tail = (unsigned int *)((char *)ring + params.sq_off.tail);
+	uring->sq_mask = (unsigned int *)((char *)ring + params.sq_off.ring_mask);
+	uring->sq_array = (unsigned int *)((char *)ring + params.sq_off.array);
+	uring->cq_head = (unsigned int *)((char *)ring + params.cq_off.head);
+	uring->cq_tail = (unsigned int *)((char *)ring + params.cq_off.tail);
+	uring->cq_mask = (unsigned int *)((char *)ring + params.cq_off.ring_mask);
+	uring->cqes = (struct io_uring_cqe *)((char *)ring + params.cq_off.cqes);
+
+	/* The entries are used in order, map them once */
+	for (i = 0; i < params.sq_entries; i++)
+		uring->sq_array[i] = i;
+
+	/* The slots of the direct descriptors, one per file in flight */
+	for (i = 0; i < CG_URING_FILES; i++)
+		fds[i] = -1;
+	if (syscall(__NR_io_uring_register, uring->fd, IORING_REGISTER_FILES, fds,
+		    CG_URING_FILES) < 0)
+		goto err;
+
+	return uring;
+
+err:
+	cg_uring_free(uring);
+
+	return NULL;
+}
+
+static void cg_uring_probe(void)
+{
+	struct cg_uring *uring;
+
+	uring = cg_uring_new();
+	if (!uring) {
+		cgroup_dbg("io_uring isn't available, the files are read one by one\n");
+		return;
+	}
+
+	cg_uring_free(uring);
+	cg_uring_supported = true;
+}
+
+/* Free the ring of batch */
+static void cg_uring_put(struct cg_read_batch *batch)
+{
+	if (!batch->uring)
+		return;
+
+	cg_uring_free(batch->uring);
+	batch->uring = NULL;
+}
+
+/* Get the ring of batch, set up on its first run, see keep_ring */
+static struct cg_uring *cg_uring_get(struct cg_read_batch *batch)
+{
+	pthread_once(&cg_uring_once, cg_uring_probe);
+
+	if (!cg_uring_supported || batch->uring_failed)
+		return NULL;
+
+	/*
+	 * The ring kept by the batch of a forked child is the one of its
+	 * parent, their submissions and completions would mix.  Only the
+	 * mappings and the fd of the child are released, the parent keeps
+	 * using the ring.
+	 */
+	if (batch->uring && batch->uring->pid != getpid())
+		cg_uring_put(batch);
+
+	if (!batch->uring) {
+		batch->uring = cg_uring_new();
+		if (!batch->uring)
+			batch->uring_failed = true;
+	}
+
+	return batch->uring;
+}
+
+static struct io_uring_sqe *cg_uring_next_sqe(struct cg_uring *uring, unsigned int *tail)
+{
+	struct io_uring_sqe *sqe = &uring->sqes[*tail & *uring->sq_mask];
+
+	memset(sqe, 0, sizeof(*sqe));
+	(*tail)++;
+
+	return sqe;
+}
+
+/* Queue the open, read and close of file, in slot of the direct descriptors */
+static void cg_uring_queue_file(struct cg_uring *uring, unsigned int *tail,
+				struct cg_read_file *file, int idx, int slot)
+{
+	struct io_uring_sqe *sqe;
+
+	/* A hard link runs the close even if the read fails or is short */
+	sqe = cg_uring_next_sqe(uring, tail);
+	sqe->opcode = IORING_OP_OPENAT;
+	sqe->fd = file->dirfd;
+	sqe->addr = (unsigned long)file->name;
+	sqe->open_flags = O_RDONLY;
+	sqe->file_index = slot + 1;
+	sqe->flags = IOSQE_IO_HARDLINK | IOSQE_CQE_SKIP_SUCCESS;
+	sqe->user_data = CG_URING_DATA(idx, CG_URING_OPEN);
+
+	sqe = cg_uring_next_sqe(uring, tail);
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = slot;
+	sqe->addr = (unsigned long)file->buf;
+	sqe->len = file->buf_size - 1;
+	sqe->off = 0;
+	sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+	sqe->user_data = CG_URING_DATA(idx, CG_URING_READ);
+
+	sqe = cg_uring_next_sqe(uring, tail);
+	sqe->opcode = IORING_OP_CLOSE;
+	sqe->file_index = slot + 1;
+	sqe->user_data = CG_URING_DATA(idx, CG_URING_CLOSE);
+}
+
+/*
+ * Handle a completion.  A file whose read filled its buffer is marked with
+ * error -1, to be read again with a larger buffer.  Returns the number of
+ * completions of the file still expected, i.e. the read and the close.
+ */
+static int cg_uring_complete(struct cg_read_batch *batch, struct io_uring_cqe *cqe)
+{
+	struct cg_read_file *file = &batch->files[cqe->user_data >> 2];
+	size_t len;
+
+	switch (cqe->user_data & 3) {
+	case CG_URING_OPEN:
+		/* The read and the close fail on the empty slot */
+		file->error = cqe->res == -ENOENT ? ECGROUPVALUENOTEXIST : ECGOTHER;
+		last_errno = -cqe->res;
+		return 0;
+	case CG_URING_READ:
+		if (file->error)
+			return 1;
+
+		if (cqe->res < 0) {
+			file->error = ECGOTHER;
+			last_errno = -cqe->res;
+			return 1;
+		}
+
+		len = cqe->res;
+		if (len == file->buf_size - 1) {
+			file->error = -1;
+			return 1;
+		}
+
+		/* Remove trailing \n */
+		if (len > 0 && file->buf[len - 1] == '\n')
+			len--;
+		file->buf[len] = '\0';
+		file->len = len;
+		return 1;
+	default:
+		return 1;
+	}
+}
+
+/* Handle the completions posted, returns the number of reads and closes */
+static int cg_uring_reap(struct cg_uring *uring, struct cg_read_batch *batch)
+{
+	unsigned int head = *uring->cq_head;
+	int done = 0;
+
+	while (head != __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE)) {
+		done += cg_uring_complete(batch, &uring->cqes[head & *uring->cq_mask]);
+		head++;
+	}
+	__atomic_store_n(uring->cq_head, head, __ATOMIC_RELEASE);
+
+	return done;
+}
+
+/*
+ * The number of reads and closes of cnt files queued from the entry start
+ * that the kernel took.  A chain cut by the end of a submission runs
+ * without its missing requests, and the open completes only on failure.
+ */
+static int cg_uring_submitted(struct cg_uring *uring, unsigned int start, int cnt)
+{
+	unsigned int taken = __atomic_load_n(uring->sq_head, __ATOMIC_ACQUIRE) - start;
+	unsigned int n;
+	int expected = 0;
+	int i;
+
+	for (i = 0; i < cnt && taken > 3 * i; i++) {
+		n = taken - 3 * i < 3 ? taken - 3 * i : 3;
+		expected += n - 1;
+	}
+
+	return expected;
+}
+
+/*
+ * Read the files [first, first + cnt) of batch, cnt <= CG_URING_FILES.  On
+ * failure, the requests the kernel took are waited for, as they write to
+ * the buffers of the files.  If even that fails, the buffers are left to
+ * the kernel and the files get new ones.
+ */
+static int cg_uring_read(struct cg_uring *uring, struct cg_read_batch *batch, int first, int cnt)
+{
+	unsigned int start = *uring->sq_tail;
+	unsigned int tail = start;
+	unsigned int to_submit;
+	int expected = 2 * cnt;
+	int ret, i;
+
+	for (i = 0; i < cnt; i++)
+		cg_uring_queue_file(uring, &tail, &batch->files[first + i], first + i, i);
+	__atomic_store_n(uring->sq_tail, tail, __ATOMIC_RELEASE);
+
+	to_submit = 3 * cnt;
+
+	/*
+	 * Wait for the reads and the closes of all the files, the slots of
+	 * the direct descriptors are reused by the next files.
+	 */
+	while (expected > 0) {
+		ret = syscall(__NR_io_uring_enter, uring->fd, to_submit, 1,
+			      IORING_ENTER_GETEVENTS, NULL, 0);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+
+			last_errno = errno;
+			goto drain;
+		}
+		to_submit -= (unsigned int)ret < to_submit ? ret : to_submit;
+
+		expected -= cg_uring_reap(uring, batch);
+	}
+
+	return 0;
+
+drain:
+	expected -= 2 * cnt - cg_uring_submitted(uring, start, cnt);
+	while (expected > 0) {
+		ret = syscall(__NR_io_uring_enter, uring->fd, 0, 1, IORING_ENTER_GETEVENTS,
+			      NULL, 0);
+		if (ret < 0 && errno != EINTR) {
+			for (i = first; i < first + cnt; i++) {
+				batch->files[i].buf = NULL;
+				batch->files[i].buf_size = 0;
+			}
+			break;
+		}
+
+		expected -= cg_uring_reap(uring, batch);
+	}
+
+	return ECGOTHER;
+}
+
+static int cg_read_batch_uring(struct cg_read_batch *batch)
+{
+	struct cg_uring *uring;
+	struct cg_read_file *file;
+	int i, cnt, ret;
+	char *buf;
+
+	uring = cg_uring_get(batch);
+	if (!uring)
+		return ECGOTHER;
+
+	for (i = 0; i < batch->cnt; i++) {
+		file = &batch->files[i];
+		if (file->buf_size >= CG_READ_BUF_MIN)
+			continue;
+
+		buf = realloc(file->buf, CG_READ_BUF_MIN);
+		if (!buf) {
+			last_errno = errno;
+			return ECGOTHER;
+		}
+
+		file->buf = buf;
+		file->buf_size = CG_READ_BUF_MIN;
+	}
+
+	for (i = 0; i < batch->cnt; i += cnt) {
+		cnt = batch->cnt - i < CG_URING_FILES ? batch->cnt - i : CG_URING_FILES;
+
+		ret = cg_uring_read(uring, batch, i, cnt);
+		if (ret) {
+			/*
+			 * The state of the ring is unknown, stop using it.  Its
+			 * entries that weren't submitted never run.
+			 */
+			cg_uring_put(batch);
+			batch->uring_failed = true;
+			return ret;
+		}
+	}
+
+	/* Files larger than their buffer */
+	for (i = 0; i < batch->cnt; i++) {
+		if (batch->files[i].error == -1)
+			cg_read_file_sync(&batch->files[i]);
+	}
+
+	return 0;
+}
+
+#else
+
+static void cg_uring_put(struct cg_read_batch *batch)
+{
+}
+
+static int cg_read_batch_uring(struct cg_read_batch *batch)
+{
+	return ECGOTHER;
+}
+
+#endif /* HAVE_LINUX_IO_URING_H */
+
+void cg_read_batch_run(struct cg_read_batch *batch)
+{
+	int i;
+
+	/* Single files aren't worth a ring */
+	if (batch->cnt > 1 && !cg_read_batch_uring(batch))
+		goto out;
+
+	for (i = 0; i < batch->cnt; i++) {
+		batch->files[i].error = 0;
+		batch->files[i].len = 0;
+		cg_read_file_sync(&batch->files[i]);
+	}
+
+out:
+	if (!batch->keep_ring)
+		cg_uring_put(batch);
+}
+
+void cg_read_batch_free(struct cg_read_batch *batch)
+{
+	int i;
+
+	cg_uring_put(batch);
+
+	for (i = 0; i < batch->size; i++)
+		free(batch->files[i].buf);
+
+	free(batch->files);
+	memset(batch, 0, sizeof(*batch));
+}
@@ -0,0 +1,472 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+/**
+ * Parallel collection of the files of a subtree
+ *
+ * Scraping a few files of every group with cgroup_walk_tree_begin() and one
+ * open per file by path runs on a single thread and walks the whole path of
+ * every file.  Here every worker thread has its own queue of groups: it
+ * takes the last group it queued, i.e. it goes deep in its own subtree,
+ * and takes the first group of another queue, i.e. a large subtree, when
+ * its own queue is empty.  The files are opened relative to the directory
+ * of their group, in one batch, see cg_read_batch_run().
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <libcgroup.h>
+#include <libcgroup-internal.h>
+
+#include <sys/stat.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <errno.h>
+
+/* Upper bound of the threads collecting one subtree */
+#define CG_COLLECT_THREADS_MAX	64
+
+/* Initial size of a queue of groups */
+#define CG_COLLECT_QUEUE_MIN	64
+
+/*
+ * Groups queued by one worker, as paths relative to the root of the subtree.
+ * The owner pushes and pops at the tail, the other workers steal at the
+ * head.
+ */
+struct cg_collect_queue {
+	pthread_mutex_t lock;
+	char **paths;
+	int head;
+	int tail;
+	int size;
+};
+
+struct cg_collect_pool {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct cg_collect_queue queues[CG_COLLECT_THREADS_MAX];
+	int thread_cnt;
+	/* Groups pushed so far, and groups queued or being collected */
+	unsigned long pushed;
+	int pending;
+	bool stop;
+	/* First error and its errno */
+	int ret;
+	int err;
+
+	int root_fd;
+	const char *root;
+	const char * const *files;
+	int file_cnt;
+	cgroup_collect_callback cb;
+	void *arg;
+};
+
+struct cg_collect_worker {
+	struct cg_collect_pool *pool;
+	int id;
+	struct cgroup_file_value *values;
+	/* The files of a group, their buffers and ring are reused by the next group */
+	struct cg_read_batch batch;
+};
+
+static int cg_collect_queue_push(struct cg_collect_queue *queue, char *path)
+{
+	char **paths;
+	int size;
+
+	pthread_mutex_lock(&queue->lock);
+
+	if (queue->tail == queue->size) {
+		if (queue->head > 0) {
+			/* Reuse the room left by the stolen groups */
+			memmove(queue->paths, queue->paths + queue->head,
+				(queue->tail - queue->head) * sizeof(*queue->paths));
+			queue->tail -= queue->head;
+			queue->head = 0;
+		} else {
+			size = queue->size ? queue->size * 2 : CG_COLLECT_QUEUE_MIN;
+			paths = realloc(queue->paths, size * sizeof(*paths));
+			if (!paths) {
+				pthread_mutex_unlock(&queue->lock);
+				last_errno = errno;
+				return ECGOTHER;
+			}
+
+			queue->paths = paths;
+			queue->size = size;
+		}
+	}
+
+	queue->paths[queue->tail++] = path;
+	pthread_mutex_unlock(&queue->lock);
+
+	return 0;
+}
+
+static char *cg_collect_queue_pop(struct cg_collect_queue *queue, bool steal)
+{
+	char *path = NULL;
+
+	pthread_mutex_lock(&queue->lock);
+	if (queue->head < queue->tail) {
+		if (steal)
+			path = queue->paths[queue->head++];
+		else
+			path = queue->paths[--queue->tail];
+
+		if (queue->head == queue->tail) {
+			queue->head = 0;
+			queue->tail = 0;
+		}
+	}
+	pthread_mutex_unlock(&queue->lock);
+
+	return path;
+}
+
+static void cg_collect_fail(struct cg_collect_pool *pool, int ret, int err)
+{
+	pthread_mutex_lock(&pool->lock);
+	if (!pool->ret) {
+		pool->ret = ret;
+		pool->err = err;
+	}
+	pool->stop = true;
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/* Queue the group path of the worker, path is freed on failure */
+static int cg_collect_add(struct cg_collect_worker *worker, char *path)
+{
+	struct cg_collect_pool *pool = worker->pool;
+	int ret;
+
+	/*
+	 * Count the group before it can be taken, the worker that collects
+	 * it decrements pending.  The group of the caller is pending, so
+	 * pending can't drop to zero when the push fails.
+	 */
+	pthread_mutex_lock(&pool->lock);
+	pool->pending++;
+	pthread_mutex_unlock(&pool->lock);
+
+	ret = cg_collect_queue_push(&pool->queues[worker->id], path);
+
+	pthread_mutex_lock(&pool->lock);
+	if (ret) {
+		pool->pending--;
+	} else {
+		pool->pushed++;
+		pthread_cond_signal(&pool->cond);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	if (ret)
+		free(path);
+
+	return ret;
+}
+
+/* Take the next group from the queue of the worker or from another queue */
+static char *cg_collect_next(struct cg_collect_worker *worker)
+{
+	struct cg_collect_pool *pool = worker->pool;
+	unsigned long pushed;
+	char *path;
+	int i;
+
+	while (1) {
+		/* A group pushed after this is found by the scan or ends the wait */
+		pthread_mutex_lock(&pool->lock);
+		pushed = pool->pushed;
+		pthread_mutex_unlock(&pool->lock);
+
+		path = cg_collect_queue_pop(&pool->queues[worker->id], false);
+		for (i = 1; !path && i < pool->thread_cnt; i++)
+			path = cg_collect_queue_pop(&pool->queues[(worker->id + i) % pool->thread_cnt],
+						    true);
+		if (path)
+			return path;
+
+		/*
+		 * All the queues were empty, wait for new groups until all the
+		 * groups are collected.
+		 */
+		pthread_mutex_lock(&pool->lock);
+		while (!pool->stop && pool->pushed == pushed && pool->pending > 0)
+			pthread_cond_wait(&pool->cond, &pool->lock);
+
+		if (pool->stop || pool->pending == 0) {
+			pthread_mutex_unlock(&pool->lock);
+			return NULL;
+		}
+		pthread_mutex_unlock(&pool->lock);
+	}
+}
+
+static int cg_collect_read_files(struct cg_collect_worker *worker, int dirfd)
+{
+	struct cg_collect_pool *pool = worker->pool;
+	struct cg_read_file *file;
+	int ret, i;
+
+	worker->batch.cnt = 0;
+	for (i = 0; i < pool->file_cnt; i++) {
+		ret = cg_read_batch_add(&worker->batch, dirfd, pool->files[i]);
+		if (ret)
+			return ret;
+	}
+
+	cg_read_batch_run(&worker->batch);
+
+	for (i = 0; i < pool->file_cnt; i++) {
+		file = &worker->batch.files[i];
+		worker->values[i].value = file->error ? NULL : file->buf;
+		worker->values[i].len = file->error ? 0 : file->len;
+		worker->values[i].error = file->error;
+	}
+
+	return 0;
+}
+
+/* Queue the subgroups of the group path, whose directory is dir */
+static int cg_collect_add_children(struct cg_collect_worker *worker, const char *path, DIR *dir)
+{
+	struct dirent *ent;
+	struct stat st;
+	char *child;
+	int ret;
+
+	while ((ent = readdir(dir)) != NULL) {
+		if (!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, ".."))
+			continue;
+
+		if (ent->d_type == DT_UNKNOWN) {
+			if (fstatat(dirfd(dir), ent->d_name, &st, AT_SYMLINK_NOFOLLOW) ||
+			    !S_ISDIR(st.st_mode))
+				continue;
+		} else if (ent->d_type != DT_DIR) {
+			continue;
+		}
+
+		if (asprintf(&child, "%s%s%s", path, path[0] ? "/" : "", ent->d_name) < 0) {
+			last_errno = errno;
+			return ECGOTHER;
+		}
+
+		ret = cg_collect_add(worker, child);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static int cg_collect_group(struct cg_collect_worker *worker, const char *path)
+{
+	struct cg_collect_pool *pool = worker->pool;
+	char full_path[FILENAME_MAX];
+	DIR *dir;
+	int ret;
+	int fd;
+
+	fd = openat(pool->root_fd, path[0] ? path : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0) {
+		/* The group was removed since it was queued */
+		if (errno == ENOENT)
+			return 0;
+
+		last_errno = errno;
+		return ECGOTHER;
+	}
+
+	/* The directory stream takes over fd */
+	dir = fdopendir(fd);
+	if (!dir) {
+		last_errno = errno;
+		close(fd);
+		return ECGOTHER;
+	}
+
+	/* Queue the subgroups first, the idle workers can take them meanwhile */
+	ret = cg_collect_add_children(worker, path, dir);
+	if (ret)
+		goto out;
+
+	ret = cg_collect_read_files(worker, dirfd(dir));
+	if (ret)
+		goto out;
+
+	snprintf(full_path, sizeof(full_path), "%s%s%s", pool->root,
+		 path[0] && strcmp(pool->root, "/") ? "/" : "", path);
+
+	ret = pool->cb(full_path, worker->values, pool->file_cnt, pool->arg);
+
+out:
+	closedir(dir);
+
+	return ret;
+}
+
+static void *cg_collect_worker(void *arg)
+{
+	struct cg_collect_worker *worker = arg;
+	struct cg_collect_pool *pool = worker->pool;
+	char *path;
+	int ret;
+
+	while ((path = cg_collect_next(worker)) != NULL) {
+		ret = cg_collect_group(worker, path);
+		free(path);
+
+		if (ret)
+			cg_collect_fail(pool, ret, last_errno);
+
+		pthread_mutex_lock(&pool->lock);
+		if (--pool->pending == 0)
+			pthread_cond_broadcast(&pool->cond);
+		pthread_mutex_unlock(&pool->lock);
+	}
+
+	return NULL;
+}
+
+static int cg_collect_worker_init(struct cg_collect_worker *worker, struct cg_collect_pool *pool,
+				  int id)
+{
+	int i;
+
+	worker->pool = pool;
+	worker->id = id;
+	worker->values = calloc(pool->file_cnt, sizeof(*worker->values));
+	if (!worker->values && pool->file_cnt) {
+		last_errno = errno;
+		return ECGOTHER;
+	}
+
+	for (i = 0; i < pool->file_cnt; i++)
+		worker->values[i].name = pool->files[i];
+
+	/* The ring is reused by all the groups of the worker */
+	worker->batch.keep_ring = true;
+
+	return 0;
+}
+
+static void cg_collect_worker_free(struct cg_collect_worker *worker)
+{
+	cg_read_batch_free(&worker->batch);
+	free(worker->values);
+}
+
+int cgroup_collect_subtree(const char *controller, const char *root, const char * const *files,
+			   cgroup_collect_callback cb, void *arg, int nthreads)
+{
+	struct cg_collect_worker workers[CG_COLLECT_THREADS_MAX];
+	pthread_t threads[CG_COLLECT_THREADS_MAX];
+	struct cg_collect_pool pool;
+	int started = 0;
+	char *path;
+	long cpus;
+	int ret, i;
+
+	if (!cg_initialized())
+		return ECGROUPNOTINITIALIZED;
+
+	if (!root || !files || !cb || nthreads < 0)
+		return ECGINVAL;
+
+	memset(&pool, 0, sizeof(pool));
+	memset(workers, 0, sizeof(workers));
+
+	while (files[pool.file_cnt])
+		pool.file_cnt++;
+
+	pool.root = root[0] ? root : "/";
+	pool.files = files;
+	pool.cb = cb;
+	pool.arg = arg;
+
+	if (nthreads == 0) {
+		cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = cpus > 0 ? cpus : 1;
+	}
+	pool.thread_cnt = nthreads < CG_COLLECT_THREADS_MAX ? nthreads : CG_COLLECT_THREADS_MAX;
+
+	pool.root_fd = cg_open_cgroup_file(root, controller, NULL, O_RDONLY | O_DIRECTORY);
+	if (pool.root_fd < 0) {
+		if (errno == ENODEV)
+			return ECGROUPSUBSYSNOTMOUNTED;
+		if (errno == ENOENT)
+			return ECGROUPNOTEXIST;
+
+		last_errno = errno;
+		return ECGOTHER;
+	}
+
+	pthread_mutex_init(&pool.lock, NULL);
+	pthread_cond_init(&pool.cond, NULL);
+	for (i = 0; i < pool.thread_cnt; i++)
+		pthread_mutex_init(&pool.queues[i].lock, NULL);
+
+	for (i = 0; i < pool.thread_cnt; i++) {
+		ret = cg_collect_worker_init(&workers[i], &pool, i);
+		if (ret)
+			goto out;
+	}
+
+	path = strdup("");
+	if (!path) {
+		last_errno = errno;
+		ret = ECGOTHER;
+		goto out;
+	}
+
+	ret = cg_collect_add(&workers[0], path);
+	if (ret)
+		goto out;
+
+	/* The calling thread is one of the workers */
+	for (i = 1; i < pool.thread_cnt; i++) {
+		if (pthread_create(&threads[started], NULL, cg_collect_worker, &workers[i]))
+			break;
+		started++;
+	}
+
+	/* The queues of the workers that couldn't be started stay empty */
+	cg_collect_worker(&workers[0]);
+
+	for (i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+
+	ret = pool.ret;
+	if (ret)
+		last_errno = pool.err;
+
+out:
+	for (i = 0; i < pool.thread_cnt; i++) {
+		/* Groups left when the collection was stopped */
+		while ((path = cg_collect_queue_pop(&pool.queues[i], false)) != NULL)
+			free(path);
+		free(pool.queues[i].paths);
+
+		if (workers[i].pool)
+			cg_collect_worker_free(&workers[i]);
+	}
+
+	for (i = 0; i < pool.thread_cnt; i++)
+		pthread_mutex_destroy(&pool.queues[i].lock);
+	pthread_cond_destroy(&pool.cond);
+	pthread_mutex_destroy(&pool.lock);
+	close(pool.root_fd);
+
+	return ret;
+}
@@ -1338,9 +1338,11 @@ int cgroup_config_load_config(const char *pathname)
 	 * delegate settings, in that case the last parsed one overwrites
 	 * the systemd_default_cgroup.
 	 */
-	if (strlen(tmp_systemd_default_cgroup))
+	if (strlen(tmp_systemd_default_cgroup)) {
 		snprintf(systemd_default_cgroup, sizeof(systemd_default_cgroup),
 			 "%s", tmp_systemd_default_cgroup);
+		cg_refresh_mount_prefixes();
+	}
 #endif
 
 	cgroup_free_config();
@@ -1809,16 +1811,15 @@ int cgroup_add_cgroup_templates(int offset)
  */
 int cgroup_expand_template_table(void)
 {
-	int i;
-
 	template_table = realloc(template_table,
 				 (template_table_index + config_template_table_index)
 				 *sizeof(struct cgroup));
 	if (template_table == NULL)
 		return -ECGOTHER;
 
-	for (i = 0; i < config_template_table_index; i++)
-		template_table[i + template_table_index].index = 0;
+	/* The new entries have no controllers and no arena yet */
+	memset(template_table + template_table_index, 0,
+	       config_template_table_index * sizeof(struct cgroup));
 
 	template_table_index += config_template_table_index;
 
@@ -2317,6 +2318,8 @@ int cgroup_set_default_systemd_cgroup(void)
 		goto err;
 	}
 
+	cg_refresh_mount_prefixes();
+
 	if (systemd_default_cgroup_exists()) {
 		pthread_rwlock_unlock(&systemd_default_cgroup_lock);
 		return 1;
@@ -2325,6 +2328,7 @@ err:
 	pthread_rwlock_unlock(&systemd_default_cgroup_lock);
 	cgroup_dbg(", continuing without systemd default cgroup.\n", systemd_default_cgroup);
 	systemd_default_cgroup[0] = '\0';
+	cg_refresh_mount_prefixes();
 
 	return 0;
 }
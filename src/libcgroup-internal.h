@@ -21,6 +21,7 @@ extern "C" {
 #include <dirent.h>
 #include <limits.h>
 #include <mntent.h>
+#include <stdint.h>
 #include <setjmp.h>
 #include <fts.h>
 
@@ -78,6 +79,7 @@ extern "C" {
 /* cgroup v2 files */
 #define CGV2_CONTROLLERS_FILE   "cgroup.controllers"
 #define CGV2_SUBTREE_CTRL_FILE  "cgroup.subtree_control"
+#define CGV2_DELEGATE_FILE      "/sys/kernel/cgroup/delegate"
 
 /* maximum line length when reading the cgroup.controllers file */
 #define CGV2_CONTROLLERS_LL_MAX	100
@@ -95,9 +97,27 @@ extern "C" {
 
 #define ARRAY_SIZE(x)	(sizeof(x) / sizeof((x)[0]))
 
+/* Number of the keys of enum cgroup_stat_key */
+#define CG_STAT_KEY_CNT	__CG_STAT_KEY_MAX
+
+/*
+ * Bump allocator.  Memory is handed out from large chunks and released all
+ * at once by cg_arena_free().
+ */
+struct cg_arena;
+
 struct control_value {
-	char name[FILENAME_MAX];
-	char value[CG_CONTROL_VALUE_MAX];
+	/* Interned by cg_intern_name(), never freed */
+	const char *name;
+
+	/*
+	 * NUL terminated value of value_len bytes, stored in the arena of the
+	 * cgroup.  It's rewritten in place as long as it fits into
+	 * value_size bytes, see cg_set_value().
+	 */
+	char *value;
+	size_t value_len;
+	size_t value_size;
 
 	/* cgget uses this field for values that span multiple lines */
 	char *multiline_value;
@@ -105,10 +125,14 @@ struct control_value {
 	/*
 	 * The abstraction layer uses prev_name when there's an
 	 * N->1 or 1->N relationship between cgroup v1 and v2 settings.
+	 * It's interned like name.
 	 */
-	char *prev_name;
+	const char *prev_name;
 
 	bool dirty;
+
+	/* The value is read on first access, see CGFLAG_GET_LAZY */
+	bool unread;
 };
 
 struct cgroup_controller {
@@ -117,6 +141,9 @@ struct cgroup_controller {
 	struct cgroup *cgroup;
 	int index;
 	enum cg_version_t version;
+
+	/* Arena of the cgroup, it holds the controller and its values */
+	struct cg_arena *arena;
 };
 
 struct cgroup {
@@ -130,6 +157,12 @@ struct cgroup {
 	gid_t control_gid;
 	mode_t control_fperm;
 	mode_t control_dperm;
+
+	/*
+	 * Holds the controllers and their values, created with the first
+	 * controller and freed by cgroup_free_controllers()
+	 */
+	struct cg_arena *arena;
 };
 
 struct cg_mount_point {
@@ -137,6 +170,19 @@ struct cg_mount_point {
 	struct cg_mount_point *next;
 };
 
+/*
+ * Resolved path prefix of a hierarchy, i.e. "<mount point>/<systemd default
+ * cgroup>/".  It's computed when the mount table is published so that
+ * cg_build_path_locked() only has to copy it.
+ */
+struct cg_path_prefix {
+	char path[FILENAME_MAX];
+	/* Length of "<mount point>/", without the systemd default cgroup */
+	int mnt_len;
+	/* Length of the whole prefix, 0 if the prefix hasn't been computed */
+	int len;
+};
+
 struct cg_mount_table_s {
 	/** Controller name. */
 	char name[CONTROL_NAMELEN_MAX];
@@ -147,6 +193,8 @@ struct cg_mount_table_s {
 	int index;
 	int shared_mnt;
 	enum cg_version_t version;
+	/** Path prefix of the first mount point. */
+	struct cg_path_prefix prefix;
 };
 
 struct cgroup_rules_data {
@@ -223,6 +271,126 @@ struct cgroup_dictionary_iterator {
 	struct cgroup_dictionary_item *item;
 };
 
+/** Control file of a cgroup_handle, opened on first use. */
+struct cgroup_handle_file {
+	char *name;
+	/* Index of the directory in cgroup_handle.dirfds[] */
+	int dir;
+	/* O_RDONLY or O_WRONLY */
+	int flags;
+	int fd;
+	struct cgroup_handle_file *next;
+};
+
+/**
+ * Opened cgroup.  Every hierarchy the cgroup is part of is represented
+ * by one directory fd, the controllers are mapped to these directories.
+ * This structure should be opaque to users of the handle.
+ */
+struct cgroup_handle {
+	char name[FILENAME_MAX];
+	char controllers[CG_CONTROLLER_MAX][CONTROL_NAMELEN_MAX];
+	/* Index of the directory of each controller in dirfds[] */
+	int ctrl_dir[CG_CONTROLLER_MAX];
+	int ctrl_cnt;
+	int dirfds[CG_CONTROLLER_MAX];
+	dev_t dir_dev[CG_CONTROLLER_MAX];
+	ino_t dir_ino[CG_CONTROLLER_MAX];
+	/* Version of the hierarchy of each directory */
+	enum cg_version_t dir_version[CG_CONTROLLER_MAX];
+	int dir_cnt;
+	struct cgroup_handle_file *files;
+};
+
+/* Group of a cgroup_pool */
+struct cgroup_pool_member {
+	struct cgroup *cgrp;
+	struct cgroup_pool_member *next;
+};
+
+/**
+ * Pool of pre-created groups under a parent group.  The groups move from
+ * the ready list to the busy list when acquired, to the released list when
+ * released, and back to the ready list once the background thread has
+ * reset them.
+ */
+struct cgroup_pool {
+	char parent[FILENAME_MAX];
+	/* Controllers, values and permissions of every group */
+	struct cgroup *tmpl;
+	/* Number of ready groups the pool maintains */
+	int size;
+	unsigned long next_id;
+	struct cgroup_pool_member *ready;
+	int ready_cnt;
+	struct cgroup_pool_member *busy;
+	struct cgroup_pool_member *released;
+	/* Namespaces of the creator, the background thread builds paths with them */
+	char *namespaces[CG_CONTROLLER_MAX];
+	/* Creating a group failed, don't retry until the next request */
+	bool failed;
+	bool stop;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+};
+
+/* Tasks queued for one destination of a cgroup_migrator */
+struct cgroup_migrator_dest {
+	char name[FILENAME_MAX];
+	/* Comma separated controllers, empty on cgroup v2 without controllers */
+	char controllers[FILENAME_MAX];
+	pid_t *pids;
+	/* CLOCK_MONOTONIC time each task was queued at, in nanoseconds */
+	uint64_t *queued_ns;
+	size_t cnt;
+	size_t size;
+	struct cgroup_migrator_dest *next;
+};
+
+/**
+ * Queue of task migrations, batched per destination and paced by a token
+ * bucket of rate tokens per second and burst tokens at most.
+ */
+struct cgroup_migrator {
+	unsigned int rate;
+	unsigned int burst;
+	double tokens;
+	uint64_t refill_ns;
+	struct cgroup_migrator_dest *dests;
+	struct cgroup_migrator_dest *tail;
+	struct cgroup_migrator_stats stats;
+	/* Totals the rate and the average latency of the stats are based on */
+	uint64_t flush_ns;
+	uint64_t latency_ns;
+};
+
+/* A stats file sampled by a cgroup_sampler */
+struct cgroup_sampler_file {
+	/* Shared by the files of the same group, owned by the first one */
+	struct cgroup_handle *handle;
+	bool own_handle;
+	char name[FILENAME_MAX];
+	/* The last two samples, stats[cur] is the last one */
+	struct cgroup_stats stats[2];
+	int cur;
+	/* CLOCK_MONOTONIC time of the last two samples, in nanoseconds */
+	uint64_t sample_ns[2];
+	struct cgroup_stat_delta *deltas;
+	int delta_cnt;
+	int delta_size;
+};
+
+/**
+ * The stats files sampled by a cgroup_sampler, and the deltas of their
+ * last two samples.
+ */
+struct cgroup_sampler {
+	struct cgroup_sampler_file *files;
+	int cnt;
+	int size;
+};
+
 /**
  * per thread errno variable, to be used when return code is ECGOTHER
  */
@@ -235,6 +403,17 @@ extern jmp_buf parser_error_env;
 
 /* Internal API */
 char *cg_build_path(const char *name, char *path, const char *type);
+
+/* Whether cgroup_init() was called, for the functions outside of api.c */
+bool cg_initialized(void);
+
+/*
+ * Copy the namespaces of the calling thread, which are thread local, for a
+ * thread that builds cgroup paths on its behalf.  The thread points its
+ * cg_namespace_table[] to the copy, which it must not free.
+ */
+int cg_namespace_table_dup(char *table[CG_CONTROLLER_MAX]);
+void cg_namespace_table_free(char *table[CG_CONTROLLER_MAX]);
 int cgroup_get_uid_gid_from_procfs(pid_t pid, uid_t *euid, gid_t *egid);
 int cgroup_get_procname_from_procfs(pid_t pid, char **procname);
 int cg_mkdir_p(const char *path);
@@ -264,6 +443,76 @@ extern __thread char *cg_namespace_table[CG_CONTROLLER_MAX];
  */
 extern char systemd_default_cgroup[FILENAME_MAX * 2 + 1];
 
+/*
+ * Recompute the path prefixes of the cg_mount_table[] entries.  Must be called
+ * whenever systemd_default_cgroup changes.  Takes the cg_mount_table_lock.
+ */
+void cg_refresh_mount_prefixes(void);
+
+/*
+ * Open file in the directory of the cgroup name in the hierarchy of the
+ * controller type.  If file is NULL, the cgroup directory itself is opened,
+ * e.g. to resolve several files relative to it.  O_CLOEXEC is always added
+ * to flags.  Returns the fd, or -1 with errno set (ENODEV if the
+ * controller isn't mounted).
+ */
+int cg_open_cgroup_file_locked(const char *name, const char *type, const char *file,
+			       int flags);
+int cg_open_cgroup_file(const char *name, const char *type, const char *file, int flags);
+
+/*
+ * Open file relative to dirfd as a stdio stream.  mode is either "re" or
+ * "we".
+ */
+FILE *cg_fopenat(int dirfd, const char *file, const char *mode);
+
+/*
+ * Read the whole content of fd, from offset 0, into *buf without the
+ * trailing newline.  *buf is a malloc()ed buffer of *size bytes, or NULL,
+ * that is doubled until the content fits, so it can be reused from one read
+ * to the next.  The length of the content is stored in len, if not NULL.
+ */
+int cg_read_fd_all(int fd, char **buf, size_t *size, size_t *len);
+
+/* A file read by cg_read_batch_run() */
+struct cg_read_file {
+	int dirfd;
+	const char *name;
+	/* Content without the trailing newline, see cg_read_fd_all() */
+	char *buf;
+	size_t buf_size;
+	size_t len;
+	/* 0, ECGROUPVALUENOTEXIST if the file doesn't exist, or ECGOTHER */
+	int error;
+};
+
+struct cg_uring;
+
+/*
+ * Files read together, with io_uring when available.  Initialize it with
+ * zeros and reset cnt to reuse it, the buffers are kept.  The ring is
+ * released when cg_read_batch_run() returns, unless keep_ring is set:
+ * then it is reused by the next runs, until cg_read_batch_free().
+ */
+struct cg_read_batch {
+	struct cg_read_file *files;
+	int cnt;
+	int size;
+	bool keep_ring;
+
+	/* Private, the ring of the batch and whether it can't be used */
+	struct cg_uring *uring;
+	bool uring_failed;
+};
+
+/* Add the file name, relative to dirfd, to batch; name must outlive the read */
+int cg_read_batch_add(struct cg_read_batch *batch, int dirfd, const char *name);
+
+/* Read the files of batch, the result of every file is in the file */
+void cg_read_batch_run(struct cg_read_batch *batch);
+
+void cg_read_batch_free(struct cg_read_batch *batch);
+
 /*
  * config related API
  */
@@ -363,6 +612,90 @@ char *cg_build_path_locked(const char *setting, char *path, const char *controll
 int cgroup_fill_cgc(struct dirent *ctrl_dir, struct cgroup *cgrp, struct cgroup_controller *cgc,
 		    int cg_index);
 
+/**
+ * Given a cgroup controller, populate all the settings of the cgroup
+ * directory.  The values are read together, see cg_read_batch_run().
+ *
+ * @param dir Directory stream of the cgroup
+ * @param cgrp current cgroup
+ * @param cgc current cgroup controller
+ * @param cg_index Index into the cg_mount_table of the cgroup
+ *
+ * @note The cg_mount_table_lock must be held prior to calling this function
+ */
+int cgroup_fill_cgc_dir(DIR *dir, struct cgroup *cgrp, struct cgroup_controller *cgc,
+			int cg_index);
+
+/**
+ * Create an empty arena
+ *
+ * @return The arena, or NULL if out of memory
+ */
+struct cg_arena *cg_arena_new(void);
+
+/**
+ * Allocate size zeroed bytes, aligned for any type, from arena
+ *
+ * @param arena The arena
+ * @param size Number of bytes
+ * @return The memory, or NULL if out of memory
+ */
+void *cg_arena_alloc(struct cg_arena *arena, size_t size);
+
+/**
+ * Release the arena and all memory allocated from it
+ *
+ * @param arena The arena, NULL is ignored
+ */
+void cg_arena_free(struct cg_arena *arena);
+
+/**
+ * Get the single, shared copy of a setting name.  The copies are kept for
+ * the lifetime of the process, names are compared with strcmp() as usual.
+ *
+ * @param name The name, truncated to FILENAME_MAX - 1 characters
+ * @return The interned name, or NULL if out of memory
+ */
+const char *cg_intern_name(const char *name);
+
+/**
+ * Store value in val, a value of the controller cgc.  Values of any length
+ * are stored intact.  The dirty flag isn't changed.
+ *
+ * @param cgc Controller of the value, its arena provides the storage
+ * @param val The value to change
+ * @param value The new value
+ */
+int cg_set_value(struct cgroup_controller *cgc, struct control_value *val, const char *value);
+
+/**
+ * Same as cg_set_value() for a value of len characters
+ */
+int cg_set_value_len(struct cgroup_controller *cgc, struct control_value *val,
+		     const char *value, size_t len);
+
+/**
+ * Read a value left unread by cgroup_get_cgroup_ext() with CGFLAG_GET_LAZY
+ *
+ * @param cgc Controller of the value
+ * @param val The unread value
+ * @param buf Buffer for the value, NULL or malloc()ed, grown as needed
+ * @param size Size of the buffer
+ * @param len Length of the value read
+ */
+int cg_read_lazy_value(const struct cgroup_controller * const cgc,
+		       const struct control_value * const val, char **buf, size_t *size,
+		       size_t *len);
+
+/**
+ * Read val into its own buffer, if it was left unread by
+ * cgroup_get_cgroup_ext() with CGFLAG_GET_LAZY
+ *
+ * @param cgc Controller of the value
+ * @param val The value, it's read at most once
+ */
+int cg_load_lazy_value(struct cgroup_controller *cgc, struct control_value *val);
+
 /**
  * Given a controller name, test if it's mounted
  *
@@ -425,6 +758,7 @@ int cgroupv2_subtree_control(const char *path, const char *ctrl_name, bool enabl
 int cgroupv2_get_subtree_control(const char *path,  const char *ctrl_name, bool * const enabled);
 int cgroupv2_controller_enabled(const char * const cg_name, const char * const ctrl_name);
 int get_next_rule_field(char *rule, char *field, size_t field_len, bool expect_quotes);
+int cg_move_task_files(int input_tasks, int output_tasks);
 
 #endif /* UNIT_TEST */
 
@@ -0,0 +1,361 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+/**
+ * Pools of pre-created control groups
+ *
+ * Creating a control group is made of mkdir, enabling the controllers in
+ * the ancestors, changing the ownership and writing the values.  A pool
+ * does this ahead of time, so that placing a job only takes a group from
+ * the pool.  Released groups are reset and recycled by a background thread.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <libcgroup.h>
+#include <libcgroup-internal.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <errno.h>
+
+static void cg_pool_push(struct cgroup_pool_member **list, struct cgroup_pool_member *member)
+{
+	member->next = *list;
+	*list = member;
+}
+
+static struct cgroup_pool_member *cg_pool_pop(struct cgroup_pool_member **list)
+{
+	struct cgroup_pool_member *member = *list;
+
+	if (member)
+		*list = member->next;
+
+	return member;
+}
+
+static void cg_pool_free_member(struct cgroup_pool_member *member, bool delete_cgrp)
+{
+	if (delete_cgrp)
+		cgroup_delete_cgroup(member->cgrp, 1);
+
+	cgroup_free(&member->cgrp);
+	free(member);
+}
+
+/*
+ * Copy the controllers, values, ownerships and permissions of src to dst.
+ * The copied values are marked dirty, i.e. they are all written by
+ * cgroup_modify_cgroup().
+ */
+static int cg_pool_copy_template(struct cgroup *dst, struct cgroup *src)
+{
+	int ret;
+
+	ret = cgroup_copy_cgroup(dst, src);
+	if (ret)
+		return ret;
+
+	dst->control_uid = src->control_uid;
+	dst->control_gid = src->control_gid;
+	dst->tasks_uid = src->tasks_uid;
+	dst->tasks_gid = src->tasks_gid;
+	dst->control_dperm = src->control_dperm;
+	dst->control_fperm = src->control_fperm;
+	dst->task_fperm = src->task_fperm;
+
+	return 0;
+}
+
+/* The ownership and permissions of the groups are only changed when set */
+static bool cg_pool_has_ownership(const struct cgroup * const tmpl)
+{
+	return tmpl->control_uid != NO_UID_GID || tmpl->control_gid != NO_UID_GID ||
+	       tmpl->tasks_uid != NO_UID_GID || tmpl->tasks_gid != NO_UID_GID ||
+	       tmpl->control_dperm != NO_PERMS || tmpl->control_fperm != NO_PERMS ||
+	       tmpl->task_fperm != NO_PERMS;
+}
+
+static int cg_pool_new_member(struct cgroup_pool *pool, struct cgroup_pool_member **member)
+{
+	char name[FILENAME_MAX];
+	unsigned long id;
+	int ret;
+
+	pthread_mutex_lock(&pool->lock);
+	id = pool->next_id++;
+	pthread_mutex_unlock(&pool->lock);
+
+	/* The pid keeps the pools of different processes apart */
+	if (snprintf(name, sizeof(name), "%s/pool-%d-%lu", pool->parent, getpid(),
+		     id) >= sizeof(name))
+		return ECGINVAL;
+
+	*member = calloc(1, sizeof(**member));
+	if (!*member) {
+		last_errno = errno;
+		return ECGOTHER;
+	}
+
+	(*member)->cgrp = cgroup_new_cgroup(name);
+	if (!(*member)->cgrp) {
+		ret = ECGFAIL;
+		goto err;
+	}
+
+	ret = cg_pool_copy_template((*member)->cgrp, pool->tmpl);
+	if (ret)
+		goto err;
+
+	ret = cgroup_create_cgroup((*member)->cgrp, !cg_pool_has_ownership(pool->tmpl));
+	if (ret)
+		goto err;
+
+	return 0;
+
+err:
+	cgroup_warn("cannot create pool group %s: %s\n", name, cgroup_strerror(ret));
+	cgroup_free(&(*member)->cgrp);
+	free(*member);
+	*member = NULL;
+
+	return ret;
+}
+
+/* Reset a released group to the template values */
+static int cg_pool_reset_member(struct cgroup_pool *pool, struct cgroup_pool_member *member)
+{
+	int ret;
+
+	ret = cg_pool_copy_template(member->cgrp, pool->tmpl);
+	if (ret)
+		return ret;
+
+	return cgroup_modify_cgroup(member->cgrp);
+}
+
+/*
+ * Background thread of the pool.  It recycles the released groups first,
+ * they are cheaper than new ones, then tops up the pool to its size.
+ */
+static void *cg_pool_worker(void *arg)
+{
+	struct cgroup_pool *pool = arg;
+	struct cgroup_pool_member *member;
+	int ret;
+
+	memcpy(cg_namespace_table, pool->namespaces, sizeof(cg_namespace_table));
+
+	pthread_mutex_lock(&pool->lock);
+	while (!pool->stop) {
+		member = cg_pool_pop(&pool->released);
+		if (member) {
+			pthread_mutex_unlock(&pool->lock);
+			ret = cg_pool_reset_member(pool, member);
+			if (ret) {
+				/* Replace the group with a new one */
+				cgroup_dbg("cannot reset pool group %s: %s\n", member->cgrp->name,
+					   cgroup_strerror(ret));
+				cg_pool_free_member(member, true);
+				member = NULL;
+			}
+			pthread_mutex_lock(&pool->lock);
+
+			if (member) {
+				cg_pool_push(&pool->ready, member);
+				pool->ready_cnt++;
+			}
+			continue;
+		}
+
+		if (pool->ready_cnt < pool->size && !pool->failed) {
+			pthread_mutex_unlock(&pool->lock);
+			ret = cg_pool_new_member(pool, &member);
+			pthread_mutex_lock(&pool->lock);
+
+			if (ret) {
+				/* Retry on the next acquire or release */
+				pool->failed = true;
+				continue;
+			}
+
+			cg_pool_push(&pool->ready, member);
+			pool->ready_cnt++;
+			continue;
+		}
+
+		pthread_cond_wait(&pool->cond, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	/* The namespaces belong to the pool */
+	memset(cg_namespace_table, 0, sizeof(cg_namespace_table));
+
+	return NULL;
+}
+
+int cgroup_pool_create(const char *parent, struct cgroup *tmpl, int size,
+		       struct cgroup_pool **pool)
+{
+	struct cgroup_pool_member *member;
+	struct cgroup_pool *new_pool;
+	int ret, i;
+
+	if (!parent || !tmpl || size < 0 || !pool)
+		return ECGINVAL;
+
+	*pool = NULL;
+
+	new_pool = calloc(1, sizeof(*new_pool));
+	if (!new_pool) {
+		last_errno = errno;
+		return ECGOTHER;
+	}
+
+	snprintf(new_pool->parent, sizeof(new_pool->parent), "%s", parent);
+	new_pool->size = size;
+	pthread_mutex_init(&new_pool->lock, NULL);
+	pthread_cond_init(&new_pool->cond, NULL);
+
+	new_pool->tmpl = cgroup_new_cgroup(parent);
+	if (!new_pool->tmpl) {
+		ret = ECGFAIL;
+		goto err;
+	}
+
+	ret = cg_pool_copy_template(new_pool->tmpl, tmpl);
+	if (ret)
+		goto err;
+
+	ret = cg_namespace_table_dup(new_pool->namespaces);
+	if (ret)
+		goto err;
+
+	/* Fill the pool upfront, a broken template fails here */
+	for (i = 0; i < size; i++) {
+		ret = cg_pool_new_member(new_pool, &member);
+		if (ret)
+			goto err;
+
+		cg_pool_push(&new_pool->ready, member);
+		new_pool->ready_cnt++;
+	}
+
+	if (pthread_create(&new_pool->thread, NULL, cg_pool_worker, new_pool)) {
+		last_errno = errno;
+		ret = ECGOTHER;
+		goto err;
+	}
+
+	*pool = new_pool;
+
+	return 0;
+
+err:
+	while ((member = cg_pool_pop(&new_pool->ready)))
+		cg_pool_free_member(member, true);
+
+	cgroup_free(&new_pool->tmpl);
+	cg_namespace_table_free(new_pool->namespaces);
+	pthread_cond_destroy(&new_pool->cond);
+	pthread_mutex_destroy(&new_pool->lock);
+	free(new_pool);
+
+	return ret;
+}
+
+int cgroup_pool_acquire(struct cgroup_pool *pool, struct cgroup **cgrp)
+{
+	struct cgroup_pool_member *member;
+	int ret;
+
+	if (!pool || !cgrp)
+		return ECGINVAL;
+
+	pthread_mutex_lock(&pool->lock);
+	member = cg_pool_pop(&pool->ready);
+	if (member)
+		pool->ready_cnt--;
+	pool->failed = false;
+	pthread_mutex_unlock(&pool->lock);
+
+	if (!member) {
+		/* The pool is drained, create the group right away */
+		ret = cg_pool_new_member(pool, &member);
+		if (ret)
+			return ret;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	cg_pool_push(&pool->busy, member);
+	pthread_cond_signal(&pool->cond);
+	pthread_mutex_unlock(&pool->lock);
+
+	*cgrp = member->cgrp;
+
+	return 0;
+}
+
+int cgroup_pool_release(struct cgroup_pool *pool, struct cgroup *cgrp)
+{
+	struct cgroup_pool_member **prev, *member;
+
+	if (!pool || !cgrp)
+		return ECGINVAL;
+
+	pthread_mutex_lock(&pool->lock);
+	for (prev = &pool->busy; *prev; prev = &(*prev)->next) {
+		if ((*prev)->cgrp == cgrp)
+			break;
+	}
+
+	member = *prev;
+	if (!member) {
+		pthread_mutex_unlock(&pool->lock);
+		return ECGROUPNOTEXIST;
+	}
+
+	*prev = member->next;
+	cg_pool_push(&pool->released, member);
+	pool->failed = false;
+	pthread_cond_signal(&pool->cond);
+	pthread_mutex_unlock(&pool->lock);
+
+	return 0;
+}
+
+void cgroup_pool_destroy(struct cgroup_pool **pool)
+{
+	struct cgroup_pool_member *member;
+
+	if (!pool || !*pool)
+		return;
+
+	pthread_mutex_lock(&(*pool)->lock);
+	(*pool)->stop = true;
+	pthread_cond_signal(&(*pool)->cond);
+	pthread_mutex_unlock(&(*pool)->lock);
+
+	pthread_join((*pool)->thread, NULL);
+
+	while ((member = cg_pool_pop(&(*pool)->ready)))
+		cg_pool_free_member(member, true);
+
+	while ((member = cg_pool_pop(&(*pool)->released)))
+		cg_pool_free_member(member, true);
+
+	/* Groups still in use are left in place */
+	while ((member = cg_pool_pop(&(*pool)->busy)))
+		cg_pool_free_member(member, false);
+
+	cgroup_free(&(*pool)->tmpl);
+	cg_namespace_table_free((*pool)->namespaces);
+	pthread_cond_destroy(&(*pool)->cond);
+	pthread_mutex_destroy(&(*pool)->lock);
+	free(*pool);
+	*pool = NULL;
+}
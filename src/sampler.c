@@ -0,0 +1,353 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+/**
+ * Rates of the values of stats files
+ *
+ * A sampler keeps the last two typed samples of every file it reads and
+ * turns them into deltas and rates.  The two samples are read in turns into
+ * the same two struct cgroup_stats, whose buffers are kept, as is the array
+ * of the deltas, so that steady-state sampling doesn't allocate memory.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <libcgroup.h>
+#include <libcgroup-internal.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <errno.h>
+
+/* Initial number of files of a sampler */
+#define CG_SAMPLER_MIN_FILES	8
+
+/* The keys whose values go up and down, the others are counters */
+static const bool cg_sampler_gauges[CG_STAT_KEY_CNT] = {
+	[CG_STAT_ANON]				= true,
+	[CG_STAT_FILE]				= true,
+	[CG_STAT_KERNEL]			= true,
+	[CG_STAT_KERNEL_STACK]			= true,
+	[CG_STAT_PAGETABLES]			= true,
+	[CG_STAT_SEC_PAGETABLES]		= true,
+	[CG_STAT_PERCPU]			= true,
+	[CG_STAT_SOCK]				= true,
+	[CG_STAT_VMALLOC]			= true,
+	[CG_STAT_SHMEM]				= true,
+	[CG_STAT_ZSWAP]				= true,
+	[CG_STAT_ZSWAPPED]			= true,
+	[CG_STAT_FILE_MAPPED]			= true,
+	[CG_STAT_FILE_DIRTY]			= true,
+	[CG_STAT_FILE_WRITEBACK]		= true,
+	[CG_STAT_SWAPCACHED]			= true,
+	[CG_STAT_ANON_THP]			= true,
+	[CG_STAT_FILE_THP]			= true,
+	[CG_STAT_SHMEM_THP]			= true,
+	[CG_STAT_INACTIVE_ANON]			= true,
+	[CG_STAT_ACTIVE_ANON]			= true,
+	[CG_STAT_INACTIVE_FILE]			= true,
+	[CG_STAT_ACTIVE_FILE]			= true,
+	[CG_STAT_UNEVICTABLE]			= true,
+	[CG_STAT_SLAB_RECLAIMABLE]		= true,
+	[CG_STAT_SLAB_UNRECLAIMABLE]		= true,
+	[CG_STAT_SLAB]				= true,
+
+	[CG_STAT_CACHE]				= true,
+	[CG_STAT_RSS]				= true,
+	[CG_STAT_RSS_HUGE]			= true,
+	[CG_STAT_MAPPED_FILE]			= true,
+	[CG_STAT_DIRTY]				= true,
+	[CG_STAT_WRITEBACK]			= true,
+	[CG_STAT_SWAP]				= true,
+	[CG_STAT_HIERARCHICAL_MEMORY_LIMIT]	= true,
+	[CG_STAT_HIERARCHICAL_MEMSW_LIMIT]	= true,
+
+	[CG_STAT_AVG10]				= true,
+	[CG_STAT_AVG60]				= true,
+	[CG_STAT_AVG300]			= true,
+};
+
+/* A decrease of an unknown key can't be told from a reset, it's a gauge */
+static bool cg_sampler_is_counter(int key)
+{
+	return key != CG_STAT_UNKNOWN && !cg_sampler_gauges[key];
+}
+
+static uint64_t cg_sampler_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static bool cg_sampler_same_entry(const struct cgroup_stat_entry *a,
+				  const struct cgroup_stat_entry *b)
+{
+	if (a->key != b->key)
+		return false;
+
+	/* Known keys are the same name */
+	if (a->key == CG_STAT_UNKNOWN && strcmp(a->name, b->name))
+		return false;
+
+	if (!a->scope || !b->scope)
+		return a->scope == b->scope;
+
+	return !strcmp(a->scope, b->scope);
+}
+
+/*
+ * Find the value entry of the current sample in the previous one.  The
+ * lines of a file rarely change from one sample to the next, so the entry
+ * at the same index is tried first.
+ */
+static const struct cgroup_stat_entry *cg_sampler_find_prev(const struct cgroup_stats *prev,
+							     const struct cgroup_stat_entry *entry,
+							     int index)
+{
+	int i;
+
+	if (index < prev->cnt && cg_sampler_same_entry(&prev->entries[index], entry))
+		return &prev->entries[index];
+
+	for (i = 0; i < prev->cnt; i++) {
+		if (cg_sampler_same_entry(&prev->entries[i], entry))
+			return &prev->entries[i];
+	}
+
+	return NULL;
+}
+
+static int cg_sampler_compute(struct cgroup_sampler_file *file, bool first)
+{
+	const struct cgroup_stats *prev = &file->stats[!file->cur];
+	const struct cgroup_stats *cur = &file->stats[file->cur];
+	const struct cgroup_stat_entry *entry, *prev_entry;
+	struct cgroup_stat_delta *delta, *deltas;
+	uint64_t interval_ns = 0;
+	int size, i;
+
+	if (cur->cnt > file->delta_size) {
+		size = file->delta_size ? file->delta_size : cur->cnt;
+		while (size < cur->cnt)
+			size *= 2;
+
+		deltas = realloc(file->deltas, size * sizeof(*deltas));
+		if (!deltas) {
+			last_errno = errno;
+			return ECGOTHER;
+		}
+
+		file->deltas = deltas;
+		file->delta_size = size;
+	}
+
+	if (!first)
+		interval_ns = file->sample_ns[file->cur] - file->sample_ns[!file->cur];
+
+	for (i = 0; i < cur->cnt; i++) {
+		entry = &cur->entries[i];
+		delta = &file->deltas[i];
+
+		delta->scope = entry->scope;
+		delta->name = entry->name;
+		delta->key = entry->key;
+		delta->value = entry->value;
+		delta->delta = 0;
+		delta->rate = 0;
+		delta->flags = 0;
+
+		prev_entry = first ? NULL : cg_sampler_find_prev(prev, entry, i);
+		if (!prev_entry) {
+			delta->flags = CG_STAT_DELTA_NEW;
+			continue;
+		}
+
+		if (!cg_sampler_is_counter(entry->key)) {
+			delta->delta = (int64_t)(entry->value - prev_entry->value);
+		} else if (entry->value >= prev_entry->value) {
+			delta->delta = entry->value - prev_entry->value;
+		} else {
+			/* The counter restarted from zero */
+			delta->delta = entry->value;
+			delta->flags = CG_STAT_DELTA_RESET;
+		}
+
+		if (interval_ns)
+			delta->rate = delta->delta * 1e9 / (double)interval_ns;
+	}
+	file->delta_cnt = cur->cnt;
+
+	return 0;
+}
+
+int cgroup_sampler_create(struct cgroup_sampler **sampler)
+{
+	if (!sampler)
+		return ECGINVAL;
+
+	*sampler = calloc(1, sizeof(**sampler));
+	if (!*sampler) {
+		last_errno = errno;
+		return ECGOTHER;
+	}
+
+	return 0;
+}
+
+int cgroup_sampler_add(struct cgroup_sampler *sampler, const char *name, const char *file,
+		       int *id)
+{
+	struct cgroup_sampler_file *new_file, *files;
+	struct cgroup_handle *handle = NULL;
+	int ret, size, i;
+
+	if (!sampler || !name || !file || !id)
+		return ECGINVAL;
+
+	/* The files of a group share its handle */
+	for (i = 0; i < sampler->cnt; i++) {
+		if (!strcmp(sampler->files[i].handle->name, name)) {
+			handle = sampler->files[i].handle;
+			break;
+		}
+	}
+
+	if (sampler->cnt == sampler->size) {
+		size = sampler->size ? sampler->size * 2 : CG_SAMPLER_MIN_FILES;
+
+		files = realloc(sampler->files, size * sizeof(*files));
+		if (!files) {
+			last_errno = errno;
+			return ECGOTHER;
+		}
+
+		sampler->files = files;
+		sampler->size = size;
+	}
+
+	new_file = &sampler->files[sampler->cnt];
+	memset(new_file, 0, sizeof(*new_file));
+
+	if (!handle) {
+		ret = cgroup_open(name, NULL, &handle);
+		if (ret)
+			return ret;
+		new_file->own_handle = true;
+	}
+
+	new_file->handle = handle;
+	snprintf(new_file->name, sizeof(new_file->name), "%s", file);
+
+	*id = sampler->cnt++;
+
+	return 0;
+}
+
+int cgroup_sampler_sample(struct cgroup_sampler *sampler)
+{
+	struct cgroup_sampler_file *file;
+	int error = 0;
+	bool first;
+	int ret, i;
+
+	if (!sampler)
+		return ECGINVAL;
+
+	for (i = 0; i < sampler->cnt; i++) {
+		file = &sampler->files[i];
+		first = file->sample_ns[file->cur] == 0;
+
+		/* Read into the older sample, the last one stays if that fails */
+		ret = cgroup_handle_read_stats(file->handle, file->name,
+					       &file->stats[!file->cur]);
+		if (!ret) {
+			file->cur = !file->cur;
+			file->sample_ns[file->cur] = cg_sampler_now_ns();
+			ret = cg_sampler_compute(file, first);
+		}
+
+		if (ret && !error)
+			error = ret;
+	}
+
+	return error;
+}
+
+int cgroup_sampler_get_deltas(const struct cgroup_sampler *sampler, int id,
+			      const struct cgroup_stat_delta **deltas, int *cnt,
+			      u_int64_t *interval_ns)
+{
+	const struct cgroup_sampler_file *file;
+
+	if (!sampler || id < 0 || id >= sampler->cnt || !deltas || !cnt)
+		return ECGINVAL;
+
+	file = &sampler->files[id];
+
+	*deltas = file->deltas;
+	*cnt = file->delta_cnt;
+
+	if (interval_ns) {
+		*interval_ns = 0;
+		if (file->sample_ns[!file->cur])
+			*interval_ns = file->sample_ns[file->cur] - file->sample_ns[!file->cur];
+	}
+
+	return 0;
+}
+
+int cgroup_sampler_get(const struct cgroup_sampler *sampler, int id, const char *scope,
+		       enum cgroup_stat_key key, struct cgroup_stat_delta *delta)
+{
+	const struct cgroup_sampler_file *file;
+	const struct cgroup_stat_delta *d;
+	int i;
+
+	if (!sampler || id < 0 || id >= sampler->cnt || key < 0 || key >= CG_STAT_KEY_CNT ||
+	    !delta)
+		return ECGINVAL;
+
+	file = &sampler->files[id];
+
+	for (i = 0; i < file->delta_cnt; i++) {
+		d = &file->deltas[i];
+		if (d->key != key)
+			continue;
+
+		if (scope ? d->scope && !strcmp(d->scope, scope) : !d->scope) {
+			*delta = *d;
+			return 0;
+		}
+	}
+
+	return ECGROUPVALUENOTEXIST;
+}
+
+void cgroup_sampler_free(struct cgroup_sampler **sampler)
+{
+	struct cgroup_sampler_file *file;
+	int i;
+
+	if (!sampler || !*sampler)
+		return;
+
+	for (i = 0; i < (*sampler)->cnt; i++) {
+		file = &(*sampler)->files[i];
+
+		if (file->own_handle)
+			cgroup_close(file->handle);
+		cgroup_stats_free(&file->stats[0]);
+		cgroup_stats_free(&file->stats[1]);
+		free(file->deltas);
+	}
+
+	free((*sampler)->files);
+	free(*sampler);
+	*sampler = NULL;
+}
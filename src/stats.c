@@ -0,0 +1,460 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+/**
+ * Typed readers of the stats files
+ *
+ * cgroup_read_stats_begin() and cgroup_read_stats_next() return one line at
+ * a time as strings.  The readers here parse a whole file in one pass, in
+ * place, into (key, value) pairs.  The names are looked up in a perfect hash
+ * of the known keys, built on first use, i.e. with a single compare, and the
+ * buffers are reused, so a monitoring agent can sample many groups quickly.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <libcgroup.h>
+#include <libcgroup-internal.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+
+/* Slots and buckets of the perfect hash, both powers of 2 */
+#define CG_STAT_HASH_SLOTS	256
+#define CG_STAT_HASH_BUCKETS	32
+
+/* Initial number of entries of a struct cgroup_stats */
+#define CG_STATS_MIN_ENTRIES	64
+
+static const char * const cg_stat_key_names[CG_STAT_KEY_CNT] = {
+	[CG_STAT_USAGE_USEC]			= "usage_usec",
+	[CG_STAT_USER_USEC]			= "user_usec",
+	[CG_STAT_SYSTEM_USEC]			= "system_usec",
+	[CG_STAT_CORE_SCHED_FORCE_IDLE_USEC]	= "core_sched.force_idle_usec",
+	[CG_STAT_NR_PERIODS]			= "nr_periods",
+	[CG_STAT_NR_THROTTLED]			= "nr_throttled",
+	[CG_STAT_THROTTLED_USEC]		= "throttled_usec",
+	[CG_STAT_THROTTLED_TIME]		= "throttled_time",
+	[CG_STAT_NR_BURSTS]			= "nr_bursts",
+	[CG_STAT_BURST_USEC]			= "burst_usec",
+	[CG_STAT_BURST_TIME]			= "burst_time",
+	[CG_STAT_USER]				= "user",
+	[CG_STAT_SYSTEM]			= "system",
+
+	[CG_STAT_ANON]				= "anon",
+	[CG_STAT_FILE]				= "file",
+	[CG_STAT_KERNEL]			= "kernel",
+	[CG_STAT_KERNEL_STACK]			= "kernel_stack",
+	[CG_STAT_PAGETABLES]			= "pagetables",
+	[CG_STAT_SEC_PAGETABLES]		= "sec_pagetables",
+	[CG_STAT_PERCPU]			= "percpu",
+	[CG_STAT_SOCK]				= "sock",
+	[CG_STAT_VMALLOC]			= "vmalloc",
+	[CG_STAT_SHMEM]				= "shmem",
+	[CG_STAT_ZSWAP]				= "zswap",
+	[CG_STAT_ZSWAPPED]			= "zswapped",
+	[CG_STAT_FILE_MAPPED]			= "file_mapped",
+	[CG_STAT_FILE_DIRTY]			= "file_dirty",
+	[CG_STAT_FILE_WRITEBACK]		= "file_writeback",
+	[CG_STAT_SWAPCACHED]			= "swapcached",
+	[CG_STAT_ANON_THP]			= "anon_thp",
+	[CG_STAT_FILE_THP]			= "file_thp",
+	[CG_STAT_SHMEM_THP]			= "shmem_thp",
+	[CG_STAT_INACTIVE_ANON]			= "inactive_anon",
+	[CG_STAT_ACTIVE_ANON]			= "active_anon",
+	[CG_STAT_INACTIVE_FILE]			= "inactive_file",
+	[CG_STAT_ACTIVE_FILE]			= "active_file",
+	[CG_STAT_UNEVICTABLE]			= "unevictable",
+	[CG_STAT_SLAB_RECLAIMABLE]		= "slab_reclaimable",
+	[CG_STAT_SLAB_UNRECLAIMABLE]		= "slab_unreclaimable",
+	[CG_STAT_SLAB]				= "slab",
+	[CG_STAT_WORKINGSET_REFAULT_ANON]	= "workingset_refault_anon",
+	[CG_STAT_WORKINGSET_REFAULT_FILE]	= "workingset_refault_file",
+	[CG_STAT_WORKINGSET_ACTIVATE_ANON]	= "workingset_activate_anon",
+	[CG_STAT_WORKINGSET_ACTIVATE_FILE]	= "workingset_activate_file",
+	[CG_STAT_WORKINGSET_RESTORE_ANON]	= "workingset_restore_anon",
+	[CG_STAT_WORKINGSET_RESTORE_FILE]	= "workingset_restore_file",
+	[CG_STAT_WORKINGSET_NODERECLAIM]	= "workingset_nodereclaim",
+	[CG_STAT_PGSCAN]			= "pgscan",
+	[CG_STAT_PGSTEAL]			= "pgsteal",
+	[CG_STAT_PGSCAN_KSWAPD]			= "pgscan_kswapd",
+	[CG_STAT_PGSCAN_DIRECT]			= "pgscan_direct",
+	[CG_STAT_PGSCAN_KHUGEPAGED]		= "pgscan_khugepaged",
+	[CG_STAT_PGSTEAL_KSWAPD]		= "pgsteal_kswapd",
+	[CG_STAT_PGSTEAL_DIRECT]		= "pgsteal_direct",
+	[CG_STAT_PGSTEAL_KHUGEPAGED]		= "pgsteal_khugepaged",
+	[CG_STAT_PGFAULT]			= "pgfault",
+	[CG_STAT_PGMAJFAULT]			= "pgmajfault",
+	[CG_STAT_PGREFILL]			= "pgrefill",
+	[CG_STAT_PGACTIVATE]			= "pgactivate",
+	[CG_STAT_PGDEACTIVATE]			= "pgdeactivate",
+	[CG_STAT_PGLAZYFREE]			= "pglazyfree",
+	[CG_STAT_PGLAZYFREED]			= "pglazyfreed",
+	[CG_STAT_ZSWPIN]			= "zswpin",
+	[CG_STAT_ZSWPOUT]			= "zswpout",
+	[CG_STAT_ZSWPWB]			= "zswpwb",
+	[CG_STAT_THP_FAULT_ALLOC]		= "thp_fault_alloc",
+	[CG_STAT_THP_COLLAPSE_ALLOC]		= "thp_collapse_alloc",
+	[CG_STAT_THP_SWPOUT]			= "thp_swpout",
+	[CG_STAT_THP_SWPOUT_FALLBACK]		= "thp_swpout_fallback",
+	[CG_STAT_CACHE]				= "cache",
+	[CG_STAT_RSS]				= "rss",
+	[CG_STAT_RSS_HUGE]			= "rss_huge",
+	[CG_STAT_MAPPED_FILE]			= "mapped_file",
+	[CG_STAT_DIRTY]				= "dirty",
+	[CG_STAT_WRITEBACK]			= "writeback",
+	[CG_STAT_SWAP]				= "swap",
+	[CG_STAT_PGPGIN]			= "pgpgin",
+	[CG_STAT_PGPGOUT]			= "pgpgout",
+	[CG_STAT_HIERARCHICAL_MEMORY_LIMIT]	= "hierarchical_memory_limit",
+	[CG_STAT_HIERARCHICAL_MEMSW_LIMIT]	= "hierarchical_memsw_limit",
+
+	[CG_STAT_LOW]				= "low",
+	[CG_STAT_HIGH]				= "high",
+	[CG_STAT_MAX]				= "max",
+	[CG_STAT_OOM]				= "oom",
+	[CG_STAT_OOM_KILL]			= "oom_kill",
+	[CG_STAT_OOM_GROUP_KILL]		= "oom_group_kill",
+	[CG_STAT_FAIL]				= "fail",
+
+	[CG_STAT_RBYTES]			= "rbytes",
+	[CG_STAT_WBYTES]			= "wbytes",
+	[CG_STAT_RIOS]				= "rios",
+	[CG_STAT_WIOS]				= "wios",
+	[CG_STAT_DBYTES]			= "dbytes",
+	[CG_STAT_DIOS]				= "dios",
+
+	[CG_STAT_AVG10]				= "avg10",
+	[CG_STAT_AVG60]				= "avg60",
+	[CG_STAT_AVG300]			= "avg300",
+	[CG_STAT_TOTAL]				= "total",
+};
+
+/*
+ * Hash and displace: a name goes to the bucket given by its hash, the
+ * displacement of the bucket then picks its slot, chosen so that no two
+ * known keys share a slot.  A lookup is one hash and one compare.
+ */
+static struct {
+	pthread_once_t once;
+	bool built;
+	u_int16_t disp[CG_STAT_HASH_BUCKETS];
+	int16_t slots[CG_STAT_HASH_SLOTS];
+} cg_stat_hash = {
+	.once = PTHREAD_ONCE_INIT,
+};
+
+/* FNV-1a */
+static u_int64_t cg_stat_hash_name(const char *name, size_t len)
+{
+	u_int64_t hash = 14695981039346656037ULL;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= (unsigned char)name[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+static unsigned int cg_stat_hash_slot(u_int64_t hash, unsigned int disp)
+{
+	/* The step is odd, i.e. the displacements reach every slot */
+	return ((hash >> 32) + disp * ((hash >> 8) | 1)) & (CG_STAT_HASH_SLOTS - 1);
+}
+
+static void cg_stat_build_hash(void)
+{
+	int bucket_keys[CG_STAT_HASH_BUCKETS][CG_STAT_KEY_CNT];
+	int bucket_cnt[CG_STAT_HASH_BUCKETS] = {0};
+	u_int64_t hashes[CG_STAT_KEY_CNT];
+	int order[CG_STAT_HASH_BUCKETS];
+	unsigned int slot, disp;
+	int i, j, k, b, tmp;
+	bool fits;
+
+	memset(cg_stat_hash.slots, -1, sizeof(cg_stat_hash.slots));
+
+	for (i = 0; i < CG_STAT_KEY_CNT; i++) {
+		hashes[i] = cg_stat_hash_name(cg_stat_key_names[i], strlen(cg_stat_key_names[i]));
+		b = hashes[i] & (CG_STAT_HASH_BUCKETS - 1);
+		bucket_keys[b][bucket_cnt[b]++] = i;
+	}
+
+	/* Place the largest buckets first, while most slots are free */
+	for (i = 0; i < CG_STAT_HASH_BUCKETS; i++)
+		order[i] = i;
+	for (i = 1; i < CG_STAT_HASH_BUCKETS; i++) {
+		for (j = i; j > 0 && bucket_cnt[order[j]] > bucket_cnt[order[j - 1]]; j--) {
+			tmp = order[j];
+			order[j] = order[j - 1];
+			order[j - 1] = tmp;
+		}
+	}
+
+	for (i = 0; i < CG_STAT_HASH_BUCKETS; i++) {
+		b = order[i];
+
+		for (disp = 0; disp <= UINT16_MAX; disp++) {
+			fits = true;
+
+			for (j = 0; j < bucket_cnt[b] && fits; j++) {
+				slot = cg_stat_hash_slot(hashes[bucket_keys[b][j]], disp);
+				if (cg_stat_hash.slots[slot] >= 0)
+					fits = false;
+
+				/* The keys of the bucket must not collide either */
+				for (k = 0; k < j && fits; k++) {
+					if (cg_stat_hash_slot(hashes[bucket_keys[b][k]], disp) == slot)
+						fits = false;
+				}
+			}
+
+			if (fits)
+				break;
+		}
+
+		if (!fits) {
+			/* Can't happen with the load of the table, lookups fall back to a scan */
+			cgroup_warn("cannot build the hash of the stat keys\n");
+			return;
+		}
+
+		cg_stat_hash.disp[b] = disp;
+		for (j = 0; j < bucket_cnt[b]; j++) {
+			slot = cg_stat_hash_slot(hashes[bucket_keys[b][j]], disp);
+			cg_stat_hash.slots[slot] = bucket_keys[b][j];
+		}
+	}
+
+	cg_stat_hash.built = true;
+}
+
+static bool cg_stat_key_is(int key, const char *name, size_t len)
+{
+	return !strncmp(cg_stat_key_names[key], name, len) && cg_stat_key_names[key][len] == '\0';
+}
+
+static int cg_stat_lookup(const char *name, size_t len)
+{
+	u_int64_t hash;
+	int key;
+
+	if (!cg_stat_hash.built) {
+		for (key = 0; key < CG_STAT_KEY_CNT; key++) {
+			if (cg_stat_key_is(key, name, len))
+				return key;
+		}
+
+		return CG_STAT_UNKNOWN;
+	}
+
+	hash = cg_stat_hash_name(name, len);
+	key = cg_stat_hash.slots[cg_stat_hash_slot(hash,
+				 cg_stat_hash.disp[hash & (CG_STAT_HASH_BUCKETS - 1)])];
+	if (key < 0 || !cg_stat_key_is(key, name, len))
+		return CG_STAT_UNKNOWN;
+
+	return key;
+}
+
+/*
+ * Parse the number str.  Decimals are kept to the hundredths, i.e. "0.25"
+ * is 25, and "max" is UINT64_MAX.
+ */
+static int cg_stat_parse_value(const char *str, u_int64_t *value)
+{
+	const char *p = str;
+	u_int64_t val = 0;
+	int i;
+
+	if (*p < '0' || *p > '9') {
+		if (strcmp(str, "max"))
+			return ECGINVAL;
+
+		*value = UINT64_MAX;
+		return 0;
+	}
+
+	for (; *p >= '0' && *p <= '9'; p++)
+		val = val * 10 + (*p - '0');
+
+	if (*p == '.') {
+		p++;
+		for (i = 0; i < 2; i++) {
+			val *= 10;
+			if (*p >= '0' && *p <= '9')
+				val += *p++ - '0';
+		}
+
+		/* Drop the decimals past the hundredths */
+		while (*p >= '0' && *p <= '9')
+			p++;
+	}
+
+	if (*p != '\0')
+		return ECGINVAL;
+
+	*value = val;
+
+	return 0;
+}
+
+/* Split the next field off *str, or return NULL at the end of the line */
+static char *cg_stat_next_field(char **str)
+{
+	char *field = *str;
+
+	while (*field == ' ')
+		field++;
+	if (*field == '\0')
+		return NULL;
+
+	*str = field;
+	while (**str != ' ' && **str != '\0')
+		(*str)++;
+	if (**str == ' ')
+		*(*str)++ = '\0';
+
+	return field;
+}
+
+static int cg_stats_add(struct cgroup_stats *stats, const char *scope, const char *name,
+			size_t name_len, const char *value)
+{
+	struct cgroup_stat_entry *entry;
+	int size;
+
+	if (stats->cnt == stats->size) {
+		size = stats->size ? stats->size * 2 : CG_STATS_MIN_ENTRIES;
+
+		entry = realloc(stats->entries, size * sizeof(*entry));
+		if (!entry) {
+			last_errno = errno;
+			return ECGOTHER;
+		}
+
+		stats->entries = entry;
+		stats->size = size;
+	}
+
+	entry = &stats->entries[stats->cnt];
+	entry->scope = scope;
+	entry->name = name;
+	entry->key = cg_stat_lookup(name, name_len);
+	if (cg_stat_parse_value(value, &entry->value))
+		return ECGINVAL;
+
+	stats->cnt++;
+
+	return 0;
+}
+
+/*
+ * Parse a line of a nested keyed file, i.e. "<scope> <key>=<value> ...",
+ * from line, the first field past the scope.
+ */
+static int cg_stats_parse_nested(struct cgroup_stats *stats, const char *scope, char *line)
+{
+	char *field, *eq;
+	int ret;
+
+	while ((field = cg_stat_next_field(&line))) {
+		eq = strchr(field, '=');
+		if (!eq)
+			return ECGINVAL;
+
+		*eq = '\0';
+		ret = cg_stats_add(stats, scope, field, eq - field, eq + 1);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+int cgroup_parse_stats(char *buf, struct cgroup_stats *stats)
+{
+	char *line, *end, *first, *second;
+	int ret;
+
+	if (!buf || !stats)
+		return ECGINVAL;
+
+	pthread_once(&cg_stat_hash.once, cg_stat_build_hash);
+
+	stats->cnt = 0;
+
+	for (line = buf; *line; line = end) {
+		end = strchrnul(line, '\n');
+		if (*end == '\n')
+			*end++ = '\0';
+
+		first = cg_stat_next_field(&line);
+		if (!first)
+			continue;
+
+		/* The first field of a nested keyed line is followed by key=value */
+		if (strchr(line, '=')) {
+			ret = cg_stats_parse_nested(stats, first, line);
+			if (ret)
+				return ret;
+			continue;
+		}
+
+		second = cg_stat_next_field(&line);
+		if (!second || cg_stat_next_field(&line))
+			return ECGINVAL;
+
+		ret = cg_stats_add(stats, NULL, first, strlen(first), second);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+int cgroup_stats_get(const struct cgroup_stats *stats, const char *scope,
+		     enum cgroup_stat_key key, u_int64_t *value)
+{
+	const struct cgroup_stat_entry *entry;
+	int i;
+
+	if (!stats || !value || key < 0 || key >= CG_STAT_KEY_CNT)
+		return ECGINVAL;
+
+	for (i = 0; i < stats->cnt; i++) {
+		entry = &stats->entries[i];
+		if (entry->key != key)
+			continue;
+
+		if (scope ? entry->scope && !strcmp(entry->scope, scope) : !entry->scope) {
+			*value = entry->value;
+			return 0;
+		}
+	}
+
+	return ECGROUPVALUENOTEXIST;
+}
+
+const char *cgroup_stat_key_name(enum cgroup_stat_key key)
+{
+	if (key < 0 || key >= CG_STAT_KEY_CNT)
+		return NULL;
+
+	return cg_stat_key_names[key];
+}
+
+void cgroup_stats_free(struct cgroup_stats *stats)
+{
+	if (!stats)
+		return;
+
+	free(stats->entries);
+	free(stats->buf);
+	memset(stats, 0, sizeof(*stats));
+}
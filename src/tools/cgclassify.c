@@ -51,10 +51,16 @@ static void usage(int status, const char *program_name)
 	}
 
 	info("Usage: %s [[-g] <controllers>:<path>] ", program_name);
-	info("[--sticky | --cancel-sticky] <list of pids>\n");
+	info("[--sticky | --cancel-sticky] [--stdin] <list of pids>\n");
+	info("       %s -g <controllers>:<path> --from <path> [--freeze]\n", program_name);
 	info("Move running task(s) to given cgroups\n");
 	info("  -h, --help			Display this help\n");
 	info("  -g <controllers>:<path>	Control group to be used as target\n");
+	info("  --stdin, --batch		Also read the pids from stdin and move ");
+	info("them in batches\n");
+	info("  --from <path>			Move all the processes of the group ");
+	info("<path> to the -g group\n");
+	info("  --freeze			Freeze the --from group during the move\n");
 	info("  --cancel-sticky		cgred daemon change pidlist and children tasks\n");
 	info("  --sticky			cgred daemon does not change ");
 	info("pidlist and children tasks\n");
@@ -125,9 +131,191 @@ out:
 	return ret;
 }
 
+/*
+ * Queue the move of pid, to the groups given on the command line or to the
+ * groups of the rules loaded in the cache.
+ */
+static int queue_pid(struct cgroup_migrator *migrator, pid_t pid,
+		     struct cgroup_group_spec *cgrp_list[], int cgrp_specified)
+{
+	char *procname = NULL;
+	uid_t euid;
+	gid_t egid;
+	int ret, i;
+
+	if (cgrp_specified) {
+		for (i = 0; i < CG_HIER_MAX && cgrp_list[i]; i++) {
+			ret = cgroup_migrator_add(migrator, cgrp_list[i]->path,
+					(const char *const*) cgrp_list[i]->controllers, pid);
+			if (ret) {
+				err("Error changing group of pid %d: %s\n", pid,
+				    cgroup_strerror(ret));
+				return -1;
+			}
+		}
+
+		return 0;
+	}
+
+	if (cgroup_get_uid_gid_from_procfs(pid, &euid, &egid)) {
+		err("Error in determining euid/egid of pid %d\n", pid);
+		return -1;
+	}
+
+	ret = cgroup_get_procname_from_procfs(pid, &procname);
+	if (ret) {
+		err("Error in determining process name of pid %d\n", pid);
+		return -1;
+	}
+
+	ret = cgroup_migrator_classify(migrator, euid, egid, procname, pid, CGFLAG_USECACHE);
+	free(procname);
+	if (ret) {
+		err("Error: change of cgroup failed for pid %d: %s\n", pid, cgroup_strerror(ret));
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Parse a pid, returns 0 on success.  The caller reports the invalid
+ * argument.
+ */
+static int parse_pid(const char *arg, pid_t *pid)
+{
+	char *endptr;
+
+	*pid = (pid_t) strtol(arg, &endptr, 10);
+	if (endptr == arg || endptr[0] != '\0')
+		return -1;
+
+	return 0;
+}
+
+/* Queue the pid given by arg, returns the exit code of a failure */
+static int queue_arg(struct cgroup_migrator *migrator, const char *arg,
+		     struct cgroup_group_spec *cgrp_list[], int cgrp_specified, int flag)
+{
+	pid_t pid;
+
+	if (parse_pid(arg, &pid)) {
+		err("Error: %s is not valid pid.\n", arg);
+		return 2;
+	}
+
+	if (flag && cgroup_register_unchanged_process(pid, flag))
+		return 1;
+
+	if (queue_pid(migrator, pid, cgrp_list, cgrp_specified))
+		return 1;
+
+	return 0;
+}
+
+/*
+ * Batch mode: the pids of the command line and of stdin are queued, then
+ * moved to their groups one destination after the other.  The rules are
+ * loaded once rather than for every pid.
+ */
+static int classify_batch(int argc, char *argv[], struct cgroup_group_spec *cgrp_list[],
+			  int cgrp_specified, int flag)
+{
+	struct cgroup_migrator_stats stats;
+	struct cgroup_migrator *migrator;
+	char buf[TEMP_BUF];
+	int exit_code = 0;
+	int ret, i;
+
+	if (!cgrp_specified) {
+		ret = cgroup_init_rules_cache();
+		if (ret) {
+			err("%s: failed to load the rules: %s\n", argv[0], cgroup_strerror(ret));
+			return 1;
+		}
+	}
+
+	ret = cgroup_migrator_create(0, 0, &migrator);
+	if (ret) {
+		err("%s: %s\n", argv[0], cgroup_strerror(ret));
+		return 1;
+	}
+
+	for (i = optind; i < argc; i++) {
+		ret = queue_arg(migrator, argv[i], cgrp_list, cgrp_specified, flag);
+		if (ret)
+			exit_code = ret;
+	}
+
+	while (scanf("%80s", buf) == 1) {
+		ret = queue_arg(migrator, buf, cgrp_list, cgrp_specified, flag);
+		if (ret)
+			exit_code = ret;
+	}
+
+	ret = cgroup_migrator_flush(migrator);
+	cgroup_migrator_get_stats(migrator, &stats);
+	if (ret) {
+		err("Error: %lu of %lu pids failed to move: %s\n", stats.failed,
+		    stats.moved + stats.failed, cgroup_strerror(ret));
+		exit_code = 1;
+	}
+
+	cgroup_migrator_free(&migrator);
+
+	return exit_code;
+}
+
+/*
+ * Move all the processes of the group from to the group of spec, in the
+ * hierarchies of the controllers of spec.
+ */
+static int migrate_all(const char *program_name, const char *from,
+		       struct cgroup_group_spec *spec, int flags)
+{
+	struct cgroup *src = NULL, *dst = NULL;
+	int ret = 0;
+	int i;
+
+	src = cgroup_new_cgroup(from);
+	dst = cgroup_new_cgroup(spec->path);
+	if (!src || !dst) {
+		ret = ECGFAIL;
+		goto out;
+	}
+
+	for (i = 0; i < CG_CONTROLLER_MAX && spec->controllers[i]; i++) {
+		if (strcmp(spec->controllers[i], "*") == 0) {
+			/* it is meta character, add all controllers */
+			ret = cgroup_add_all_controllers(src);
+			if (ret)
+				goto out;
+		} else if (!cgroup_add_controller(src, spec->controllers[i])) {
+			ret = ECGINVAL;
+			goto out;
+		}
+	}
+
+	ret = cgroup_migrate_all(src, dst, flags);
+
+out:
+	if (ret)
+		err("%s: moving the processes of %s to %s failed: %s\n", program_name, from,
+		    spec->path, cgroup_strerror(ret));
+
+	cgroup_free(&src);
+	cgroup_free(&dst);
+
+	return ret ? 1 : 0;
+}
+
 static struct option longopts[] = {
 	{"sticky",		no_argument, NULL, 's'},
 	{"cancel-sticky",	no_argument, NULL, 'u'},
+	{"stdin",		no_argument, NULL, 'i'},
+	{"batch",		no_argument, NULL, 'i'},
+	{"from",		required_argument, NULL, 'f'},
+	{"freeze",		no_argument, NULL, 'z'},
 	{"help",		no_argument, NULL, 'h'},
 	{0, 0, 0, 0}
 };
@@ -142,6 +330,9 @@ int main(int argc, char *argv[])
 	int skip_replace_idle = 0;
 	int cgrp_specified = 0;
 	pid_t scope_pid = -1;
+	int migrate_flags = 0;
+	char *from = NULL;
+	int batch = 0;
 	int replace_idle = 0;
 	int flag = 0;
 	char *endptr;
@@ -185,6 +376,15 @@ int main(int argc, char *argv[])
 		case 'u':
 			flag |= CGROUP_DAEMON_CANCEL_UNCHANGE_PROCESS;
 			break;
+		case 'i':
+			batch = 1;
+			break;
+		case 'f':
+			from = optarg;
+			break;
+		case 'z':
+			migrate_flags |= CGFLAG_MIGRATE_FREEZE;
+			break;
 		default:
 			usage(1, argv[0]);
 			exit(EXIT_BADARGS);
@@ -192,6 +392,24 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	/* The processes to move are the ones of the --from group */
+	if (from && (!cgrp_list[0] || cgrp_list[1] || optind < argc || batch ||
+		     replace_idle || flag)) {
+		err("%s: --from requires a single -g group and no pids\n", argv[0]);
+		exit(EXIT_BADARGS);
+	}
+
+	if (migrate_flags && !from) {
+		err("%s: --freeze requires --from\n", argv[0]);
+		exit(EXIT_BADARGS);
+	}
+
+	/* The idle thread of the scope is replaced while moving the first pid */
+	if (batch && replace_idle) {
+		err("%s: --stdin can't be used with -r\n", argv[0]);
+		exit(EXIT_BADARGS);
+	}
+
 	/* Initialize libcg */
 	ret = cgroup_init();
 	if (ret) {
@@ -204,6 +422,12 @@ int main(int argc, char *argv[])
 		cgroup_set_default_systemd_cgroup();
 #endif
 
+	if (batch)
+		return classify_batch(argc, argv, cgrp_list, cgrp_specified, flag);
+
+	if (from)
+		return migrate_all(argv[0], from, cgrp_list[0], migrate_flags);
+
 	for (i = optind; i < argc; i++) {
 		pid = (pid_t) strtol(argv[i], &endptr, 10);
 		if (endptr[0] != '\0') {
@@ -19,6 +19,8 @@
 
 static const struct option  long_options[] = {
 	{"recursive",	      no_argument, NULL, 'r'},
+	{"kill",	      no_argument, NULL, 'k'},
+	{"parallel",	      no_argument, NULL, 'p'},
 	{"help",	      no_argument, NULL, 'h'},
 	{"group",	required_argument, NULL, 'g'},
 	{NULL, 0, NULL, 0}
@@ -39,11 +41,15 @@ static void usage(int status, const char *program_name)
 		return;
 	}
 
-	info("Usage: %s [-h] [-r] [[-g] <controllers>:<path>] ...\n", program_name);
+	info("Usage: %s [-h] [-r] [-k] [-p] [[-g] <controllers>:<path>] ...\n", program_name);
 	info("Remove control group(s)\n");
 	info("  -g <controllers>:<path>	Control group to be removed (-g is optional)\n");
 	info("  -h, --help			Display this help\n");
 	info("  -r, --recursive		Recursively remove all subgroups\n");
+	info("  -k, --kill			Kill the tasks instead of moving them ");
+	info("to the parent (cgroup v2), with -r\n");
+	info("  -p, --parallel		Remove independent subgroups concurrently ");
+	info("with -r\n");
 #ifdef WITH_SYSTEMD
 	info("  -b				Ignore default systemd delegate hierarchy\n");
 #endif
@@ -157,18 +163,24 @@ int main(int argc, char *argv[])
 
 	/* Parse arguments */
 #ifdef WITH_SYSTEMD
-	while ((c = getopt_long(argc, argv, "rhg:b", long_options, NULL)) > 0) {
+	while ((c = getopt_long(argc, argv, "rkphg:b", long_options, NULL)) > 0) {
 		switch (c) {
 		case 'b':
 			ignore_default_systemd_delegate_slice = 1;
 			break;
 #else
-	while ((c = getopt_long(argc, argv, "rhg:", long_options, NULL)) > 0) {
+	while ((c = getopt_long(argc, argv, "rkphg:", long_options, NULL)) > 0) {
 		switch (c) {
 #endif
 		case 'r':
 			flags |= CGFLAG_DELETE_RECURSIVE;
 			break;
+		case 'k':
+			flags |= CGFLAG_DELETE_KILL;
+			break;
+		case 'p':
+			flags |= CGFLAG_DELETE_PARALLEL;
+			break;
 		case 'g':
 			ret = parse_cgroup_spec(cgrp_list, optarg, argc);
 			if (ret != 0) {
@@ -188,6 +200,14 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	/* cgroup.kill would kill the tasks of the subgroups that are kept */
+	if ((flags & CGFLAG_DELETE_KILL) && !(flags & CGFLAG_DELETE_RECURSIVE)) {
+		err("%s: -k requires -r\n", argv[0]);
+		usage(1, argv[0]);
+		ret = EXIT_BADARGS;
+		goto err;
+	}
+
 #ifdef WITH_SYSTEMD
 	if (!ignore_default_systemd_delegate_slice)
 		cgroup_set_default_systemd_cgroup();
@@ -24,6 +24,7 @@
 #include <unistd.h>
 #include <getopt.h>
 #include <signal.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <errno.h>
 #include <grp.h>
@@ -39,9 +40,13 @@
 static pid_t find_scope_pid(pid_t pid);
 static int write_systemd_unified(const char * const scope_name);
 static int is_scope_parsed(const char * const path);
+static int clone_command(struct cgroup_group_spec *spec, int flag_child, uid_t uid, gid_t gid,
+			 char *argv[]);
+static int wait_clone_child(pid_t pid);
 
 static struct option longopts[] = {
 	{"sticky",	no_argument, NULL, 's'},
+	{"clone",	no_argument, NULL, 'c'},
 	{"help",	no_argument, NULL, 'h'},
 	{0, 0, 0, 0}
 };
@@ -53,13 +58,15 @@ static void usage(int status, const char *program_name)
 		return;
 	}
 
-	info("Usage: %s [-h] [-g <controllers>:<path>] [--sticky] ", program_name);
+	info("Usage: %s [-h] [-g <controllers>:<path>] [--sticky] [--clone] ", program_name);
 	info("command [arguments] ...\n");
 	info("Run the task in given control group(s)\n");
 	info("  -g <controllers>:<path>	Control group which should be added\n");
 	info("  -h, --help			Display this help\n");
 	info("  --sticky			cgred daemon does not ");
 	info("change pidlist and children tasks\n");
+	info("  --clone			Start the command directly in the ");
+	info("cgroup v2 cgroup with clone3()\n");
 #ifdef WITH_SYSTEMD
 	info("  -b				Ignore default systemd delegate hierarchy\n");
 	info("  -r				Replace the default idle_thread spawned ");
@@ -77,6 +84,7 @@ int main(int argc, char *argv[])
 	int child_status = 0;
 	int replace_idle = 0;
 	int cg_specified = 0;
+	int clone_into = 0;
 	int flag_child = 0;
 	int i, ret = 0;
 	uid_t uid;
@@ -109,6 +117,9 @@ int main(int argc, char *argv[])
 		case 's':
 			flag_child |= CGROUP_DAEMON_UNCHANGE_CHILDREN;
 			break;
+		case 'c':
+			clone_into = 1;
+			break;
 		case 'h':
 			usage(0, argv[0]);
 			exit(0);
@@ -143,6 +154,18 @@ int main(int argc, char *argv[])
 
 	uid = getuid();
 	gid = getgid();
+
+	/*
+	 * A single cgroup v2 destination can be entered at process creation,
+	 * the command is then run by a child that never has to be migrated.
+	 * Otherwise fall back to moving cgexec itself before exec.
+	 */
+	if (clone_into && cg_specified && !cgrp_list[1] && !replace_idle) {
+		ret = clone_command(cgrp_list[0], flag_child, uid, gid, &argv[optind]);
+		if (ret != ECGROUPUNSUPP)
+			return ret;
+	}
+
 	pid = getpid();
 
 	ret = cgroup_register_unchanged_process(pid, flag_child);
@@ -183,7 +206,7 @@ int main(int argc, char *argv[])
 				return ret;
 			}
 		}
-	} else {
+	} else if (!cg_specified) {
 
 		/* Change the cgroup by determining the rules based on uid */
 		ret = cgroup_change_cgroup_flags(uid, gid, argv[optind], pid, 0);
@@ -232,6 +255,136 @@ int main(int argc, char *argv[])
 	return -1;
 }
 
+/*
+ * Run the command in the cgroup v2 cgroup of spec with clone3(), and wait
+ * for it.  The child is created by a raw clone3(), with the state of the
+ * C library left stale, so it only does async-signal-safe work: the parent
+ * registers it to cgred, then it drops the privileges and execs the
+ * command.  Returns ECGROUPUNSUPP if the command must be run without it.
+ */
+static int clone_command(struct cgroup_group_spec *spec, int flag_child, uid_t uid, gid_t gid,
+			 char *argv[])
+{
+	int ready[2], failed[2];
+	int child_errno;
+	char c = 0;
+	pid_t pid;
+	int ret;
+
+	/* The child waits for ready, and reports a failed exec in failed */
+	if (pipe2(ready, O_CLOEXEC)) {
+		err("%s", strerror(errno));
+		return -1;
+	}
+
+	if (pipe2(failed, O_CLOEXEC)) {
+		err("%s", strerror(errno));
+		close(ready[0]);
+		close(ready[1]);
+		return -1;
+	}
+
+	ret = cgroup_clone_into_cgroup_path(spec->path, (const char *const*) spec->controllers,
+					    &pid);
+	if (ret == 0 && pid == 0) {
+		close(ready[1]);
+		close(failed[0]);
+
+		/* The parent closes ready without writing if it fails */
+		if (read(ready[0], &c, 1) != 1)
+			_exit(EXIT_FAILURE);
+
+		if (!setresgid(gid, gid, gid) && !setresuid(uid, uid, uid))
+			execvp(argv[0], argv);
+
+		/* The parent prints the error, stdio can't be used here */
+		child_errno = errno;
+		if (write(failed[1], &child_errno, sizeof(child_errno)) < 0)
+			child_errno = 0;
+		_exit(EXIT_FAILURE);
+	}
+
+	close(ready[0]);
+	close(failed[1]);
+
+	if (ret) {
+		close(ready[1]);
+		close(failed[0]);
+
+		if (ret != ECGROUPUNSUPP)
+			err("cgroup clone into group failed: %s\n", cgroup_strerror(ret));
+		return ret;
+	}
+
+	ret = cgroup_register_unchanged_process(pid, flag_child);
+	if (ret || write(ready[1], &c, 1) != 1) {
+		err("registration of process failed\n");
+		close(ready[1]);
+		close(failed[0]);
+		waitpid(pid, NULL, 0);
+		return ret ? ret : -1;
+	}
+	close(ready[1]);
+
+	if (setresgid(gid, gid, gid) || setresuid(uid, uid, uid)) {
+		err("%s", strerror(errno));
+		close(failed[0]);
+		return -1;
+	}
+
+	/* A successful exec closes failed */
+	if (read(failed[0], &child_errno, sizeof(child_errno)) == sizeof(child_errno)) {
+		err("exec failed:%s\n", strerror(child_errno));
+		close(failed[0]);
+		waitpid(pid, NULL, 0);
+		return -1;
+	}
+	close(failed[0]);
+
+	return wait_clone_child(pid);
+}
+
+static pid_t clone_child;
+
+static void forward_signal(int sig)
+{
+	kill(clone_child, sig);
+}
+
+/*
+ * Wait for the command started with --clone and exit with its status, like
+ * the exec'd command would have.
+ */
+static int wait_clone_child(pid_t pid)
+{
+	struct sigaction sa;
+	int status;
+
+	clone_child = pid;
+
+	/* The terminal signals the whole foreground process group */
+	signal(SIGINT, SIG_IGN);
+	signal(SIGQUIT, SIG_IGN);
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = forward_signal;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGTERM, &sa, NULL);
+	sigaction(SIGHUP, &sa, NULL);
+
+	while (waitpid(pid, &status, 0) < 0) {
+		if (errno != EINTR) {
+			err("wait for pid %d failed: %s\n", pid, strerror(errno));
+			return -1;
+		}
+	}
+
+	if (WIFSIGNALED(status))
+		return 128 + WTERMSIG(status);
+
+	return WEXITSTATUS(status);
+}
+
 static pid_t search_systemd_idle_thread_task(pid_t pids[], size_t size)
 {
 	char task_cmd[FILENAME_MAX];
@@ -528,15 +528,15 @@ err:
 	return ret;
 }
 
-static int get_cv_value(struct control_value * const cv, const char * const cgrp_name,
-			const char * const controller_name)
+static int get_cv_value(struct cgroup_controller * const cgc, struct control_value * const cv,
+			const char * const cgrp_name)
 {
 	bool is_multiline = false;
 	void *tmp, *handle = NULL;
 	char tmp_line[LL_MAX];
 	int ret;
 
-	ret = cgroup_read_value_begin(controller_name, cgrp_name, cv->name, &handle, tmp_line,
+	ret = cgroup_read_value_begin(cgc->name, cgrp_name, cv->name, &handle, tmp_line,
 				      LL_MAX);
 	if (ret == ECGEOF)
 		goto read_end;
@@ -549,10 +549,10 @@ static int get_cv_value(struct control_value * const cv, const char * const cgrp
 			 * of cgget, try to determine if the failure was due
 			 * to an invalid controller
 			 */
-			tmp_ret = cgroup_test_subsys_mounted(controller_name);
+			tmp_ret = cgroup_test_subsys_mounted(cgc->name);
 			if (tmp_ret == 0) {
 				err("cgget: cannot find controller '%s' in group '%s'\n",
-				    controller_name, cgrp_name);
+				    cgc->name, cgrp_name);
 			} else {
 				err("variable file read failed %s\n", cgroup_strerror(ret));
 			}
@@ -564,7 +564,10 @@ static int get_cv_value(struct control_value * const cv, const char * const cgrp
 	/* remove the newline character */
 	tmp_line[strcspn(tmp_line, "\n")] = '\0';
 
-	strncpy(cv->value, tmp_line, CG_CONTROL_VALUE_MAX - 1);
+	ret = cgroup_set_value_string(cgc, cv->name, tmp_line);
+	if (ret)
+		goto read_end;
+
 	cv->multiline_value = strdup(cv->value);
 	if (cv->multiline_value == NULL)
 		goto read_end;
@@ -572,7 +575,9 @@ static int get_cv_value(struct control_value * const cv, const char * const cgrp
 	while ((ret = cgroup_read_value_next(&handle, tmp_line, LL_MAX)) == 0) {
 		if (ret == 0) {
 			is_multiline = true;
-			cv->value[0] = '\0';
+			ret = cgroup_set_value_string(cgc, cv->name, "");
+			if (ret)
+				goto read_end;
 
 			/* remove the newline character */
 			tmp_line[strcspn(tmp_line, "\n")] = '\0';
@@ -606,20 +611,34 @@ end:
 
 static int indent_multiline_value(struct control_value * const cv)
 {
-	char tmp_val[CG_CONTROL_VALUE_MAX] = {0};
 	char *tok, *saveptr = NULL;
+	char *tmp_val, *end;
+	size_t len;
+
+	/* Every line but the first gains a tab */
+	tmp_val = malloc(strlen(cv->value) * 2 + 1);
+	if (!tmp_val)
+		return ECGOTHER;
+
+	end = tmp_val;
+	*end = '\0';
 
 	tok = strtok_r(cv->value, "\n", &saveptr);
-	strncat(tmp_val, tok, CG_CONTROL_VALUE_MAX - 1);
 	/* don't indent the first value */
-	while ((tok = strtok_r(NULL, "\n", &saveptr))) {
-		strncat(tmp_val, "\n\t", (CG_CONTROL_VALUE_MAX - (strlen(tmp_val) + 1)));
-		strncat(tmp_val, tok, (CG_CONTROL_VALUE_MAX - (strlen(tmp_val) + 1)));
+	while (tok) {
+		len = strlen(tok);
+		memcpy(end, tok, len);
+		end += len;
+
+		tok = strtok_r(NULL, "\n", &saveptr);
+		if (tok) {
+			memcpy(end, "\n\t", 2);
+			end += 2;
+		}
 	}
+	*end = '\0';
 
-	cv->multiline_value = strdup(tmp_val);
-	if (!cv->multiline_value)
-		return ECGOTHER;
+	cv->multiline_value = tmp_val;
 
 	return 0;
 }
@@ -631,8 +650,7 @@ static int fill_empty_controller(struct cgroup * const cgrp, struct cgroup_contr
 #ifdef WITH_SYSTEMD
 	char tmp[FILENAME_MAX] = { '\0' };
 #endif
-	struct dirent *ctrl_dir = NULL;
-	int i, mnt_path_len, ret = 0;
+	int i, j, mnt_path_len, ret = 0;
 	bool found_mount = false;
 	DIR *dir = NULL;
 
@@ -697,28 +715,21 @@ static int fill_empty_controller(struct cgroup * const cgrp, struct cgroup_contr
 		goto out;
 	}
 
-	while ((ctrl_dir = readdir(dir)) != NULL) {
-		/* Skip over non regular files */
-		if (ctrl_dir->d_type != DT_REG)
-			continue;
-
-		ret = cgroup_fill_cgc(ctrl_dir, cgrp, cgc, i);
-		if (ret == ECGFAIL)
-			goto out;
+	ret = cgroup_fill_cgc_dir(dir, cgrp, cgc, i);
+	if (ret)
+		goto out;
 
-		if (cgc->index > 0) {
-			cgc->values[cgc->index - 1]->dirty = false;
+	for (j = 0; j < cgc->index; j++) {
+		cgc->values[j]->dirty = false;
 
-			/*
-			 * previous versions of cgget indented the second
-			 * and all subsequent lines. Continue that behavior
-			 */
-			if (strchr(cgc->values[cgc->index - 1]->value, '\n')) {
-				ret = indent_multiline_value(
-					cgc->values[cgc->index - 1]);
-				if (ret)
-					goto out;
-			}
+		/*
+		 * previous versions of cgget indented the second
+		 * and all subsequent lines. Continue that behavior
+		 */
+		if (strchr(cgc->values[j]->value, '\n')) {
+			ret = indent_multiline_value(cgc->values[j]);
+			if (ret)
+				goto out;
 		}
 	}
 
@@ -737,7 +748,7 @@ static int get_controller_values(struct cgroup * const cgrp, struct cgroup_contr
 	int i;
 
 	for (i = 0; i < cgc->index; i++) {
-		ret = get_cv_value(cgc->values[i], cgrp->name, cgc->name);
+		ret = get_cv_value(cgc, cgc->values[i], cgrp->name);
 		if (ret)
 			goto out;
 	}
@@ -428,6 +428,9 @@ STATIC int parse_r_flag(const char * const program_name, const char * const name
 	char *copy = NULL, *buf = NULL;
 	int ret = 0;
 
+	name_value->name = NULL;
+	name_value->value = NULL;
+
 	buf = strchr(name_value_str, '=');
 	if (buf == NULL) {
 		err("%s: wrong parameter of option -r: %s\n", program_name, optarg);
@@ -450,8 +453,12 @@ STATIC int parse_r_flag(const char * const program_name, const char * const name
 		goto err;
 	}
 
-	strncpy(name_value->name, buf, FILENAME_MAX);
-	name_value->name[FILENAME_MAX-1] = '\0';
+	name_value->name = strndup(buf, FILENAME_MAX - 1);
+	if (!name_value->name) {
+		err("%s: not enough memory\n", program_name);
+		ret = -1;
+		goto err;
+	}
 
 	buf = strchr(name_value_str, '=');
 	/*
@@ -466,13 +473,22 @@ STATIC int parse_r_flag(const char * const program_name, const char * const name
 		goto err;
 	}
 
-	strncpy(name_value->value, buf, CG_CONTROL_VALUE_MAX);
-	name_value->value[CG_CONTROL_VALUE_MAX-1] = '\0';
+	name_value->value = strndup(buf, CG_CONTROL_VALUE_MAX - 1);
+	if (!name_value->value) {
+		err("%s: not enough memory\n", program_name);
+		ret = -1;
+		goto err;
+	}
 
 err:
 	if (copy)
 		free(copy);
 
+	if (ret) {
+		free((void *)name_value->name);
+		name_value->name = NULL;
+	}
+
 	return ret;
 }
 
@@ -490,18 +506,32 @@ static int add_subtree_control_name_value(struct control_value *name_value)
 		return ECGFAIL;
 	}
 
-	snprintf(cgrp_subtree_ctrl_val->name, FILENAME_MAX, "%s", name_value->name);
-	snprintf(cgrp_subtree_ctrl_val->value, CG_CONTROL_VALUE_MAX, "%s", name_value->value);
+	/* The name and the value are handed over */
+	cgrp_subtree_ctrl_val->name = name_value->name;
+	cgrp_subtree_ctrl_val->value = name_value->value;
 
 	return 0;
 }
 
+static void free_name_values(struct control_value *name_value, int nv_number)
+{
+	int i;
+
+	for (i = 0; i < nv_number; i++) {
+		free((void *)name_value[i].name);
+		free(name_value[i].value);
+	}
+
+	free(name_value);
+}
+
 int main(int argc, char *argv[])
 {
 #ifdef WITH_SYSTEMD
 	int ignore_default_systemd_delegate_slice = 0;
 #endif
 	struct control_value *name_value = NULL;
+	struct control_value *new_name_value;
 	int nv_number = 0;
 	int recursive = 0;
 	int nv_max = 0;
@@ -557,13 +587,14 @@ int main(int argc, char *argv[])
 			/* add name-value pair to buffer (= name_value variable) */
 			if (nv_number >= nv_max) {
 				nv_max += CG_NV_MAX;
-				name_value = (struct control_value *)
+				new_name_value = (struct control_value *)
 					realloc(name_value, nv_max * sizeof(struct control_value));
-				if (!name_value) {
+				if (!new_name_value) {
 					err("%s: not enough memory\n", program_name);
 					ret = -1;
 					goto err;
 				}
+				name_value = new_name_value;
 			}
 
 			ret = parse_r_flag(program_name, optarg, &name_value[nv_number]);
@@ -678,7 +709,9 @@ int main(int argc, char *argv[])
 err:
 	cgroup_free(&src_cgrp);
 	cgroup_free(&subtree_cgrp);
-	free(name_value);
+	if (cgrp_subtree_ctrl_val)
+		free_name_values(cgrp_subtree_ctrl_val, 1);
+	free_name_values(name_value, nv_number);
 
 	return ret;
 }
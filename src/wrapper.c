@@ -76,7 +76,13 @@ struct cgroup_controller *cgroup_add_controller(struct cgroup *cgroup, const cha
 			return NULL;
 	}
 
-	controller = calloc(1, sizeof(struct cgroup_controller));
+	if (!cgroup->arena) {
+		cgroup->arena = cg_arena_new();
+		if (!cgroup->arena)
+			return NULL;
+	}
+
+	controller = cg_arena_alloc(cgroup->arena, sizeof(struct cgroup_controller));
 	if (!controller)
 		return NULL;
 
@@ -84,6 +90,7 @@ struct cgroup_controller *cgroup_add_controller(struct cgroup *cgroup, const cha
 	controller->name[CONTROL_NAMELEN_MAX - 1] = '\0';
 
 	controller->cgroup = cgroup;
+	controller->arena = cgroup->arena;
 	controller->index = 0;
 
 	if (strcmp(controller->name, CGRP_FILE_PREFIX) == 0) {
@@ -97,7 +104,6 @@ struct cgroup_controller *cgroup_add_controller(struct cgroup *cgroup, const cha
 		if (ret) {
 			cgroup_dbg("failed to get cgroup version for controller %s\n",
 				   controller->name);
-			free(controller);
 			return NULL;
 		}
 	}
@@ -219,16 +225,19 @@ out:
 	return ret;
 }
 
+/* The value itself lives in the arena of its cgroup */
 static void cgroup_free_value(struct control_value *value)
 {
-	if (value->multiline_value)
+	if (value->multiline_value) {
 		free(value->multiline_value);
-	if (value->prev_name)
-		free(value->prev_name);
-
-	free(value);
+		value->multiline_value = NULL;
+	}
 }
 
+/*
+ * The memory of the controller is only released together with its cgroup,
+ * by cgroup_free_controllers() or cgroup_free().
+ */
 void cgroup_free_controller(struct cgroup_controller *ctrl)
 {
 	int i;
@@ -236,8 +245,6 @@ void cgroup_free_controller(struct cgroup_controller *ctrl)
 	for (i = 0; i < ctrl->index; i++)
 		cgroup_free_value(ctrl->values[i]);
 	ctrl->index = 0;
-
-	free(ctrl);
 }
 
 void cgroup_free_controllers(struct cgroup *cgroup)
@@ -251,6 +258,9 @@ void cgroup_free_controllers(struct cgroup *cgroup)
 		cgroup_free_controller(cgroup->controller[i]);
 
 	cgroup->index = 0;
+
+	cg_arena_free(cgroup->arena);
+	cgroup->arena = NULL;
 }
 
 void cgroup_free(struct cgroup **cgroup)
@@ -283,25 +293,25 @@ int cgroup_add_value_string(struct cgroup_controller *controller, const char *na
 			return ECGVALUEEXISTS;
 	}
 
-	cntl_value = calloc(1, sizeof(struct control_value));
+	if (value && strlen(value) >= CG_CONTROL_VALUE_MAX) {
+		fprintf(stderr, "value exceeds the maximum of %d characters\n",
+			CG_CONTROL_VALUE_MAX - 1);
+		return ECGCONFIGPARSEFAIL;
+	}
+
+	if (!controller->arena)
+		return ECGINVAL;
+
+	cntl_value = cg_arena_alloc(controller->arena, sizeof(struct control_value));
 	if (!cntl_value)
 		return ECGCONTROLLERCREATEFAILED;
 
-	strncpy(cntl_value->name, name, sizeof(cntl_value->name));
-	cntl_value->name[sizeof(cntl_value->name)-1] = '\0';
-
-	if (value) {
-		if (strlen(value) >= sizeof(cntl_value->value)) {
-			fprintf(stderr, "value exceeds the maximum of %ld characters\n",
-				sizeof(cntl_value->value) - 1);
-			free(cntl_value);
-			return ECGCONFIGPARSEFAIL;
-		}
+	cntl_value->name = cg_intern_name(name);
+	if (!cntl_value->name || cg_set_value(controller, cntl_value, value ? value : ""))
+		return ECGCONTROLLERCREATEFAILED;
 
-		strncpy(cntl_value->value, value, sizeof(cntl_value->value));
-		cntl_value->value[sizeof(cntl_value->value)-1] = '\0';
+	if (value)
 		cntl_value->dirty = true;
-	}
 
 	controller->values[controller->index] = cntl_value;
 	controller->index++;
@@ -511,7 +521,7 @@ struct cgroup_controller *cgroup_get_controller(struct cgroup *cgroup, const cha
 
 int cgroup_get_value_string(struct cgroup_controller *controller, const char *name, char **value)
 {
-	int i;
+	int i, ret;
 
 	if (!controller || !name || !value)
 		return ECGINVAL;
@@ -520,6 +530,10 @@ int cgroup_get_value_string(struct cgroup_controller *controller, const char *na
 		struct control_value *val = controller->values[i];
 
 		if (!strcmp(val->name, name)) {
+			ret = cg_load_lazy_value(controller, val);
+			if (ret)
+				return ret;
+
 			*value = strdup(val->value);
 
 			if (!*value)
@@ -545,8 +559,10 @@ int cgroup_set_value_string(struct cgroup_controller *controller, const char *na
 		struct control_value *val = controller->values[i];
 
 		if (!strcmp(val->name, name)) {
-			strncpy(val->value, value, CG_CONTROL_VALUE_MAX);
-			val->value[sizeof(val->value)-1] = '\0';
+			if (cg_set_value(controller, val, value))
+				return ECGOTHER;
+
+			val->unread = false;
 			val->dirty = true;
 			return 0;
 		}
@@ -557,7 +573,7 @@ int cgroup_set_value_string(struct cgroup_controller *controller, const char *na
 
 int cgroup_get_value_int64(struct cgroup_controller *controller, const char *name, int64_t *value)
 {
-	int i;
+	int i, ret;
 
 	if (!controller || !name || !value)
 		return ECGINVAL;
@@ -566,6 +582,10 @@ int cgroup_get_value_int64(struct cgroup_controller *controller, const char *nam
 		struct control_value *val = controller->values[i];
 
 		if (!strcmp(val->name, name)) {
+			ret = cg_load_lazy_value(controller, val);
+			if (ret)
+				return ret;
+
 			if (sscanf(val->value, "%" SCNd64, value) != 1)
 				return ECGINVAL;
 
@@ -578,6 +598,7 @@ int cgroup_get_value_int64(struct cgroup_controller *controller, const char *nam
 
 int cgroup_set_value_int64(struct cgroup_controller *controller, const char *name, int64_t value)
 {
+	char buf[32];
 	int ret;
 	int i;
 
@@ -588,10 +609,12 @@ int cgroup_set_value_int64(struct cgroup_controller *controller, const char *nam
 		struct control_value *val = controller->values[i];
 
 		if (!strcmp(val->name, name)) {
-			ret = snprintf(val->value, sizeof(val->value), "%" PRId64, value);
-			if (ret >= sizeof(val->value))
-				return ECGINVAL;
+			snprintf(buf, sizeof(buf), "%" PRId64, value);
+			ret = cg_set_value(controller, val, buf);
+			if (ret)
+				return ret;
 
+			val->unread = false;
 			val->dirty = true;
 			return 0;
 		}
@@ -603,7 +626,7 @@ int cgroup_set_value_int64(struct cgroup_controller *controller, const char *nam
 int cgroup_get_value_uint64(struct cgroup_controller *controller, const char *name,
 			    u_int64_t *value)
 {
-	int i;
+	int i, ret;
 
 	if (!controller || !name || !value)
 		return ECGINVAL;
@@ -612,6 +635,10 @@ int cgroup_get_value_uint64(struct cgroup_controller *controller, const char *na
 		struct control_value *val = controller->values[i];
 
 		if (!strcmp(val->name, name)) {
+			ret = cg_load_lazy_value(controller, val);
+			if (ret)
+				return ret;
+
 			if (sscanf(val->value, "%" SCNu64, value) != 1)
 				return ECGINVAL;
 
@@ -625,6 +652,7 @@ int cgroup_get_value_uint64(struct cgroup_controller *controller, const char *na
 int cgroup_set_value_uint64(struct cgroup_controller *controller, const char *name,
 			    u_int64_t value)
 {
+	char buf[32];
 	int ret;
 	int i;
 
@@ -635,10 +663,12 @@ int cgroup_set_value_uint64(struct cgroup_controller *controller, const char *na
 		struct control_value *val = controller->values[i];
 
 		if (!strcmp(val->name, name)) {
-			ret = snprintf(val->value, sizeof(val->value), "%" PRIu64, value);
-			if (ret >= sizeof(val->value))
-				return ECGINVAL;
+			snprintf(buf, sizeof(buf), "%" PRIu64, value);
+			ret = cg_set_value(controller, val, buf);
+			if (ret)
+				return ret;
 
+			val->unread = false;
 			val->dirty = true;
 			return 0;
 		}
@@ -649,7 +679,7 @@ int cgroup_set_value_uint64(struct cgroup_controller *controller, const char *na
 
 int cgroup_get_value_bool(struct cgroup_controller *controller, const char *name, bool *value)
 {
-	int i;
+	int i, ret;
 
 	if (!controller || !name || !value)
 		return ECGINVAL;
@@ -658,6 +688,10 @@ int cgroup_get_value_bool(struct cgroup_controller *controller, const char *name
 		struct control_value *val = controller->values[i];
 
 		if (!strcmp(val->name, name)) {
+			ret = cg_load_lazy_value(controller, val);
+			if (ret)
+				return ret;
+
 			int cgc_val;
 
 			if (sscanf(val->value, "%d", &cgc_val) != 1)
@@ -687,14 +721,11 @@ int cgroup_set_value_bool(struct cgroup_controller *controller, const char *name
 		struct control_value *val = controller->values[i];
 
 		if (!strcmp(val->name, name)) {
-			if (value)
-				ret = snprintf(val->value, sizeof(val->value), "1");
-			else
-				ret = snprintf(val->value, sizeof(val->value), "0");
-
-			if (ret >= sizeof(val->value))
-				return ECGINVAL;
+			ret = cg_set_value(controller, val, value ? "1" : "0");
+			if (ret)
+				return ret;
 
+			val->unread = false;
 			val->dirty = true;
 			return 0;
 
@@ -781,8 +812,9 @@ char *cgroup_get_value_name(struct cgroup_controller *controller, int index)
 	if (!controller)
 		return NULL;
 
+	/* The names are interned, the callers must not change them */
 	if (index < controller->index)
-		return (controller->values[index])->name;
+		return (char *)(controller->values[index])->name;
 	else
 		return NULL;
 }
@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: LGPL-2.1-only
+#
+# cgexec --clone functionality test - start the task directly in the cgroup
+#
+
+from cgroup import Cgroup, CgroupVersion
+import consts
+import ftests
+import sys
+import os
+
+
+CONTROLLER = 'cpu'
+CGNAME = '094cgexecclone'
+
+
+def prereqs(config):
+    result = consts.TEST_PASSED
+    cause = None
+
+    if config.args.container:
+        result = consts.TEST_SKIPPED
+        cause = 'This test cannot be run within a container'
+        return result, cause
+
+    if CgroupVersion.get_version(CONTROLLER) != CgroupVersion.CGROUP_V2:
+        result = consts.TEST_SKIPPED
+        cause = 'This test requires the cgroup v2 cpu controller'
+
+    return result, cause
+
+
+def setup(config):
+    Cgroup.create(config, CONTROLLER, CGNAME)
+
+
+def test(config):
+    result = consts.TEST_PASSED
+    cause = None
+
+    # The task reports the cgroup it is running in and its exit status is
+    # passed on by cgexec
+    out = Cgroup.cgexec(config, controller=CONTROLLER, cgname=CGNAME,
+                        cmdline=['cat', '/proc/self/cgroup'], clone=True)
+
+    if '0::/{}'.format(CGNAME) not in out:
+        result = consts.TEST_FAILED
+        cause = 'Task was not started in cgroup {}: {}'.format(CGNAME, out)
+
+    return result, cause
+
+
+def teardown(config):
+    Cgroup.delete(config, CONTROLLER, CGNAME)
+
+
+def main(config):
+    [result, cause] = prereqs(config)
+    if result != consts.TEST_PASSED:
+        return [result, cause]
+
+    setup(config)
+    try:
+        [result, cause] = test(config)
+    finally:
+        teardown(config)
+
+    return [result, cause]
+
+
+if __name__ == '__main__':
+    config = ftests.parse_args()
+    # this test was invoked directly.  run only it
+    config.args.num = int(os.path.basename(__file__).split('-')[0])
+    sys.exit(ftests.main(config))
+
+# vim: set et ts=4 sw=4:
@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: LGPL-2.1-only
+#
+# cgdelete -k functionality test - kill the tasks of a subtree and remove it,
+# -k requires -r
+#
+
+from cgroup import Cgroup, CgroupVersion
+from run import RunError
+import consts
+import ftests
+import sys
+import os
+
+
+CONTROLLER = 'cpu'
+PARENT_CGNAME = '095cgdeletekill'
+CHILD_CGNAME = os.path.join(PARENT_CGNAME, 'child')
+
+PIDS = list()
+
+
+def prereqs(config):
+    result = consts.TEST_PASSED
+    cause = None
+
+    if config.args.container:
+        result = consts.TEST_SKIPPED
+        cause = 'This test cannot be run within a container'
+        return result, cause
+
+    if CgroupVersion.get_version(CONTROLLER) != CgroupVersion.CGROUP_V2:
+        result = consts.TEST_SKIPPED
+        cause = 'This test requires the cgroup v2 cpu controller'
+
+    return result, cause
+
+
+def setup(config):
+    global PIDS
+
+    Cgroup.create(config, CONTROLLER, PARENT_CGNAME)
+    Cgroup.create(config, CONTROLLER, CHILD_CGNAME)
+
+    config.process.create_process_in_cgroup(config, CONTROLLER, CHILD_CGNAME)
+    PIDS = Cgroup.get_pids_in_cgroup(config, CHILD_CGNAME, CONTROLLER)
+
+
+def test(config):
+    result = consts.TEST_PASSED
+    cause = None
+
+    # -k without -r would kill the tasks of the child that isn't removed
+    try:
+        Cgroup.delete(config, CONTROLLER, PARENT_CGNAME, kill=True)
+    except RunError:
+        pass
+    else:
+        result = consts.TEST_FAILED
+        cause = 'cgdelete -k erroneously succeeded without -r'
+        return result, cause
+
+    if Cgroup.get_pids_in_cgroup(config, CHILD_CGNAME, CONTROLLER) != PIDS:
+        result = consts.TEST_FAILED
+        cause = 'cgdelete -k without -r changed the tasks of {}'.format(CHILD_CGNAME)
+        return result, cause
+
+    Cgroup.delete(config, CONTROLLER, PARENT_CGNAME, recursive=True, kill=True)
+
+    if Cgroup.exists(config, CONTROLLER, PARENT_CGNAME):
+        result = consts.TEST_FAILED
+        cause = 'Cgroup {} was not removed'.format(PARENT_CGNAME)
+        return result, cause
+
+    # The tasks were killed, not moved to the root cgroup
+    root_pids = Cgroup.get_pids_in_cgroup(config, '', CONTROLLER)
+    for pid in PIDS:
+        if pid in root_pids:
+            result = consts.TEST_FAILED
+            cause = 'Task {} was moved instead of killed'.format(pid)
+
+    return result, cause
+
+
+def main(config):
+    [result, cause] = prereqs(config)
+    if result != consts.TEST_PASSED:
+        return [result, cause]
+
+    setup(config)
+    [result, cause] = test(config)
+
+    return [result, cause]
+
+
+if __name__ == '__main__':
+    config = ftests.parse_args()
+    # this test was invoked directly.  run only it
+    config.args.num = int(os.path.basename(__file__).split('-')[0])
+    sys.exit(ftests.main(config))
+
+# vim: set et ts=4 sw=4:
@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: LGPL-2.1-only
+#
+# cgclassify --stdin functionality test - move pids read from stdin
+#
+
+from cgroup import Cgroup
+from process import Process
+import consts
+import ftests
+import sys
+import os
+
+
+CONTROLLER = 'cpu'
+CGNAME = '096cgclassifystdin'
+
+PROCESS_CNT = 3
+
+
+def prereqs(config):
+    result = consts.TEST_PASSED
+    cause = None
+
+    if config.args.container:
+        result = consts.TEST_SKIPPED
+        cause = 'This test cannot be run within a container'
+
+    return result, cause
+
+
+def setup(config):
+    pids = list()
+
+    Cgroup.create(config, CONTROLLER, CGNAME)
+
+    for i in range(PROCESS_CNT):
+        pids.append(config.process.create_process(config))
+
+    return pids
+
+
+def test(config, pids):
+    result = consts.TEST_PASSED
+    cause = None
+
+    Cgroup.classify(config, CONTROLLER, CGNAME, pids, stdin=True)
+
+    cg_pids = Cgroup.get_pids_in_cgroup(config, CGNAME, CONTROLLER)
+    for pid in pids:
+        if pid not in cg_pids:
+            result = consts.TEST_FAILED
+            cause = 'Expected pid {} to be in {}, but it was not'.format(pid, CGNAME)
+
+    return result, cause
+
+
+def teardown(config, pids):
+    Process.kill(config, pids)
+
+    Cgroup.delete(config, CONTROLLER, CGNAME)
+
+
+def main(config):
+    [result, cause] = prereqs(config)
+    if result != consts.TEST_PASSED:
+        return [result, cause]
+
+    pids = setup(config)
+    [result, cause] = test(config, pids)
+    teardown(config, pids)
+
+    return [result, cause]
+
+
+if __name__ == '__main__':
+    config = ftests.parse_args()
+    # this test was invoked directly.  run only it
+    config.args.num = int(os.path.basename(__file__).split('-')[0])
+    sys.exit(ftests.main(config))
+
+# vim: set et ts=4 sw=4:
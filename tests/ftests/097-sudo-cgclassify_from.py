@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: LGPL-2.1-only
+#
+# cgclassify --from functionality test - move all the processes of a cgroup
+#
+
+from cgroup import Cgroup, CgroupVersion
+from process import Process
+import consts
+import ftests
+import sys
+import os
+
+
+CONTROLLER = 'cpu'
+SRC_CGNAME = '097cgclassifyfrom'
+DST_CGNAME = '097cgclassifyto'
+
+PROCESS_CNT = 3
+
+
+def prereqs(config):
+    result = consts.TEST_PASSED
+    cause = None
+
+    if config.args.container:
+        result = consts.TEST_SKIPPED
+        cause = 'This test cannot be run within a container'
+
+    return result, cause
+
+
+def setup(config):
+    Cgroup.create(config, CONTROLLER, SRC_CGNAME)
+    Cgroup.create(config, CONTROLLER, DST_CGNAME)
+
+    for i in range(PROCESS_CNT):
+        config.process.create_process_in_cgroup(config, CONTROLLER, SRC_CGNAME)
+
+    return Cgroup.get_pids_in_cgroup(config, SRC_CGNAME, CONTROLLER)
+
+
+def test(config, pids):
+    result = consts.TEST_PASSED
+    cause = None
+
+    freeze = CgroupVersion.get_version(CONTROLLER) == CgroupVersion.CGROUP_V2
+    Cgroup.classify(config, CONTROLLER, DST_CGNAME, None, from_cgname=SRC_CGNAME,
+                    freeze=freeze)
+
+    if Cgroup.get_pids_in_cgroup(config, SRC_CGNAME, CONTROLLER):
+        result = consts.TEST_FAILED
+        cause = 'Expected {} to be empty'.format(SRC_CGNAME)
+        return result, cause
+
+    cg_pids = Cgroup.get_pids_in_cgroup(config, DST_CGNAME, CONTROLLER)
+    for pid in pids:
+        if pid not in cg_pids:
+            result = consts.TEST_FAILED
+            cause = 'Expected pid {} to be in {}, but it was not'.format(pid, DST_CGNAME)
+
+    return result, cause
+
+
+def teardown(config, pids):
+    Process.kill(config, pids)
+
+    Cgroup.delete(config, CONTROLLER, SRC_CGNAME)
+    Cgroup.delete(config, CONTROLLER, DST_CGNAME)
+
+
+def main(config):
+    [result, cause] = prereqs(config)
+    if result != consts.TEST_PASSED:
+        return [result, cause]
+
+    pids = setup(config)
+    [result, cause] = test(config, pids)
+    teardown(config, pids)
+
+    return [result, cause]
+
+
+if __name__ == '__main__':
+    config = ftests.parse_args()
+    # this test was invoked directly.  run only it
+    config.args.num = int(os.path.basename(__file__).split('-')[0])
+    sys.exit(ftests.main(config))
+
+# vim: set et ts=4 sw=4:
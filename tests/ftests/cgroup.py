@@ -220,7 +220,8 @@ class Cgroup(object):
         return Cgroup.exists(config, ctrl_name, cgroup_name, ignore_systemd=ignore_systemd)
 
     @staticmethod
-    def delete(config, controller_list, cgname, recursive=False, ignore_systemd=False):
+    def delete(config, controller_list, cgname, recursive=False, ignore_systemd=False,
+               kill=False):
         if isinstance(controller_list, str):
             controller_list = [controller_list]
 
@@ -233,6 +234,9 @@ class Cgroup(object):
         if recursive:
             cmd.append('-r')
 
+        if kill:
+            cmd.append('-k')
+
         if controller_list:
             controllers_and_path = '{}:{}'.format(
                 ','.join(controller_list), cgname)
@@ -468,7 +472,8 @@ class Cgroup(object):
 
     @staticmethod
     def classify(config, controller, cgname, pid_list, sticky=False,
-                 cancel_sticky=False, ignore_systemd=False, replace_idle=False):
+                 cancel_sticky=False, ignore_systemd=False, replace_idle=False,
+                 stdin=False, from_cgname=None, freeze=False):
         cmd = list()
 
         if not config.args.container:
@@ -494,18 +499,32 @@ class Cgroup(object):
         else:
             raise ValueError('Unsupported controller format: {}'.format(type(controller)))
 
-        if isinstance(pid_list, str):
-            cmd.append(pid_list)
+        if from_cgname:
+            cmd.append('--from')
+            cmd.append(from_cgname)
+
+        if freeze:
+            cmd.append('--freeze')
+
+        if pid_list is None:
+            pid_list = []
+        elif isinstance(pid_list, str):
+            pid_list = [pid_list]
         elif isinstance(pid_list, int):
-            cmd.append(str(pid_list))
-        elif isinstance(pid_list, list):
+            pid_list = [str(pid_list)]
+
+        if stdin:
+            # pipe the pids to cgclassify
+            cmd.append('--stdin')
+            cmd = 'echo {} | {}'.format(' '.join(map(str, pid_list)), ' '.join(cmd))
+        else:
             for pid in pid_list:
                 cmd.append(str(pid))
 
         if config.args.container:
-            config.container.run(cmd)
+            config.container.run(cmd, shell_bool=stdin)
         else:
-            Run.run(cmd)
+            Run.run(cmd, shell_bool=stdin)
 
     @staticmethod
     # given a stdout of cgsnapshot-like data, create a dictionary of cgroup
@@ -981,7 +1000,8 @@ class Cgroup(object):
     # exec is a keyword in python, so let's name this function cgexec
     @staticmethod
     def cgexec(config, controller, cgname, cmdline, sticky=False,
-               cghelp=False,  ignore_systemd=False, replace_idle=False):
+               cghelp=False,  ignore_systemd=False, replace_idle=False,
+               clone=False):
         """cgexec equivalent method
         """
         cmd = list()
@@ -1002,6 +1022,9 @@ class Cgroup(object):
         if sticky:
             cmd.append('--sticky')
 
+        if clone:
+            cmd.append('--clone')
+
         if isinstance(cmdline, str):
             cmd.append(cmdline)
         elif isinstance(cmdline, list):
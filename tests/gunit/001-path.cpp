@@ -163,3 +163,33 @@ TEST_F(BuildPathV1Test, BuildPathV1_ControllerMatchWithNameAndNs)
 	out = cg_build_path(name, path, type);
 	ASSERT_STREQ(out, "/sys/fs/cgroup/controller5/ns5/TomsCgroup2/");
 }
+
+/**
+ * Published prefix test
+ * @param BuildPathV1Test googletest test case name
+ * @param BuildPathV1_PublishedPrefixes test name
+ *
+ * This test publishes the mount table path prefixes, like cgroup_init()
+ * does, and verifies that cg_build_path() builds the same paths as when
+ * the prefixes are computed on the fly.
+ */
+TEST_F(BuildPathV1Test, BuildPathV1_PublishedPrefixes)
+{
+	char path[FILENAME_MAX];
+	char *out;
+
+	memset(cg_cgroup_v2_mount_path, 0, sizeof(cg_cgroup_v2_mount_path));
+	cg_refresh_mount_prefixes();
+
+	out = cg_build_path(NULL, path, "controller0");
+	ASSERT_STREQ(out, "/sys/fs/cgroup/controller0/");
+
+	out = cg_build_path("TomsCgroup3/", path, "controller2");
+	ASSERT_STREQ(out, "/sys/fs/cgroup/controller2/TomsCgroup3/");
+
+	out = cg_build_path("/TomsCgroup4", path, "controller5");
+	ASSERT_STREQ(out, "/sys/fs/cgroup/controller5/ns5/TomsCgroup4/");
+
+	out = cg_build_path("", path, "controller1");
+	ASSERT_STREQ(out, "/sys/fs/cgroup/controller1/ns1/");
+}
@@ -230,6 +230,60 @@ TEST_F(CgroupGetCgroupTest, CgroupGetCgroup1)
 		cgroup_free(&cgrp);
 }
 
+/*
+ * The owner of the settings is the owner of the cgroup, the cgroup.* files
+ * may be delegated to another user
+ */
+TEST_F(CgroupGetCgroupTest, CgroupGetCgroupOwner)
+{
+	const char * const DELEGATED[] = {
+		"cgroup.procs", "cgroup.threads", "cgroup.subtree_control", "cgroup.kill",
+		"cgroup.type", "cgroup.events", "cgroup.freeze", "cgroup.stat", NULL
+	};
+	const uid_t settings_uid = 5678, delegated_uid = 1234;
+	char tmp_path[FILENAME_MAX];
+	struct cgroup *cgrp = NULL;
+	int i, j, ret;
+	FILE *f;
+
+	if (geteuid())
+		GTEST_SKIP() << "chown() needs root";
+
+	for (i = 0; i < CONTROLLERS_CNT; i++) {
+		if (i == CTRL_FREEZER)
+			continue;
+
+		for (j = 0; DELEGATED[j]; j++) {
+			snprintf(tmp_path, FILENAME_MAX - 1, "%s/%s/%s/%s",
+				 PARENT_DIR, CONTROLLERS[i], CG_NAME, DELEGATED[j]);
+			f = fopen(tmp_path, "w");
+			ASSERT_NE(f, nullptr);
+			fclose(f);
+			ASSERT_EQ(chown(tmp_path, delegated_uid, delegated_uid), 0);
+		}
+
+		for (j = 0; j < MAX_NAMES && NAMES[i][j]; j++) {
+			snprintf(tmp_path, FILENAME_MAX - 1, "%s/%s/%s/%s",
+				 PARENT_DIR, CONTROLLERS[i], CG_NAME, NAMES[i][j]);
+			if (strcmp(NAMES[i][j], "tasks") == 0)
+				ASSERT_EQ(chown(tmp_path, delegated_uid, delegated_uid), 0);
+			else
+				ASSERT_EQ(chown(tmp_path, settings_uid, settings_uid), 0);
+		}
+	}
+
+	cgrp = cgroup_new_cgroup(CG_NAME);
+	ASSERT_NE(cgrp, nullptr);
+
+	ret = cgroup_get_cgroup(cgrp);
+	ASSERT_EQ(ret, 0);
+
+	ASSERT_EQ(cgrp->control_uid, settings_uid);
+	ASSERT_EQ(cgrp->control_gid, settings_uid);
+
+	cgroup_free(&cgrp);
+}
+
 /*
  * This test must be last because it makes destructive changes to the cgroup hierarchy
  */
@@ -93,12 +93,9 @@ TEST_F(SetValuesRecursiveTest, SuccessfulSetValues)
 					sizeof(struct control_value));
 		ASSERT_NE(ctrlr.values[i], nullptr);
 
-		strncpy(ctrlr.values[i]->name, NAMES[i], FILENAME_MAX - 1);
-		ctrlr.values[i]->name[FILENAME_MAX - 1] = '\0';
-
-		strncpy(ctrlr.values[i]->value, VALUES[i],
-			CG_CONTROL_VALUE_MAX - 1);
-		ctrlr.values[i]->value[CG_CONTROL_VALUE_MAX - 1] = '\0';
+		ctrlr.values[i]->name = NAMES[i];
+		ctrlr.values[i]->value = strdup(VALUES[i]);
+		ASSERT_NE(ctrlr.values[i]->value, nullptr);
 
 		if (i == 0)
 			ctrlr.values[i]->dirty = true;
@@ -126,6 +123,7 @@ TEST_F(SetValuesRecursiveTest, SuccessfulSetValues)
 	}
 
 	for (i = 0; i < ctrlr.index; i++) {
+		free(ctrlr.values[i]->value);
 		free(ctrlr.values[i]);
 		ctrlr.values[i] = nullptr;
 	}
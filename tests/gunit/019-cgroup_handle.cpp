@@ -0,0 +1,356 @@
+/* SPDX-License-Identifier: LGPL-2.1-only */
+/**
+ * libcgroup googletest for cgroup_open() and the cgroup_handle functions
+ */
+
+#include <ftw.h>
+
+#include <string>
+
+#include "gtest/gtest.h"
+#include "libcgroup-internal.h"
+
+static const char * const PARENT_DIR = "test019cgroup";
+static const char * const CG_NAME = "jobcg";
+static const mode_t MODE = S_IRWXU | S_IRWXG | S_IRWXO;
+
+/*
+ * cpu and cpuacct are co-mounted, i.e. they share the same directory
+ */
+static const char * const CONTROLLERS[] = {
+	"cpu",
+	"cpuacct",
+	"memory",
+};
+static const char * const MOUNTS[] = {
+	"cpu,cpuacct",
+	"cpu,cpuacct",
+	"memory",
+};
+static const int CONTROLLERS_CNT = ARRAY_SIZE(CONTROLLERS);
+
+static const char * const FILES[][2] = {
+	{"cpu,cpuacct", "cpu.max"},
+	{"cpu,cpuacct", "cpuacct.usage"},
+	{"cpu,cpuacct", "cgroup.procs"},
+	{"memory", "memory.high"},
+	{"memory", "memory.stat"},
+	{"memory", "cgroup.procs"},
+};
+static const char * const VALUES[] = {
+	"max 100000\n",
+	"123456789\n",
+	"",
+	"max\n",
+	"anon 4096\nfile 8192\n",
+	"",
+};
+static const int FILES_CNT = ARRAY_SIZE(FILES);
+
+class CgroupHandleTest : public ::testing::Test {
+	protected:
+
+	void ReadFile(const char * const mount, const char * const name, char *buf, size_t len)
+	{
+		char tmp_path[FILENAME_MAX];
+		size_t read_len;
+		FILE *f;
+
+		snprintf(tmp_path, FILENAME_MAX - 1, "%s/%s/%s/%s", PARENT_DIR, mount, CG_NAME,
+			 name);
+
+		f = fopen(tmp_path, "r");
+		ASSERT_NE(f, nullptr);
+
+		read_len = fread(buf, 1, len - 1, f);
+		buf[read_len] = '\0';
+		fclose(f);
+	}
+
+	void SetUp() override
+	{
+		char tmp_path[FILENAME_MAX];
+		int i, ret;
+		FILE *f;
+
+		ret = cgroup_init();
+		ASSERT_EQ(ret, 0);
+
+		ret = mkdir(PARENT_DIR, MODE);
+		ASSERT_EQ(ret, 0);
+
+		/*
+		 * Artificially populate the mount table with local
+		 * directories
+		 */
+		memset(&cg_mount_table, 0, sizeof(cg_mount_table));
+		memset(&cg_namespace_table, 0, sizeof(cg_namespace_table));
+
+		for (i = 0; i < CONTROLLERS_CNT; i++) {
+			snprintf(cg_mount_table[i].name, CONTROL_NAMELEN_MAX, "%s", CONTROLLERS[i]);
+			snprintf(cg_mount_table[i].mount.path, FILENAME_MAX,
+				 "%s/%s", PARENT_DIR, MOUNTS[i]);
+			cg_mount_table[i].version = CGROUP_V1;
+
+			snprintf(tmp_path, FILENAME_MAX - 1, "%s/%s/%s", PARENT_DIR, MOUNTS[i],
+				 CG_NAME);
+			ret = mkdir(cg_mount_table[i].mount.path, MODE);
+			ASSERT_TRUE(ret == 0 || errno == EEXIST);
+			ret = mkdir(tmp_path, MODE);
+			ASSERT_TRUE(ret == 0 || errno == EEXIST);
+		}
+
+		for (i = 0; i < FILES_CNT; i++) {
+			snprintf(tmp_path, FILENAME_MAX - 1, "%s/%s/%s/%s", PARENT_DIR,
+				 FILES[i][0], CG_NAME, FILES[i][1]);
+
+			f = fopen(tmp_path, "w");
+			ASSERT_NE(f, nullptr);
+
+			fprintf(f, "%s", VALUES[i]);
+			fclose(f);
+		}
+	}
+
+	/*
+	 * https://stackoverflow.com/questions/5467725/how-to-delete-a-directory-and-its-contents-in-posix-c
+	 */
+	static int unlink_cb(const char *fpath, const struct stat *sb, int typeflag,
+		      struct FTW *ftwbuf)
+	{
+		return remove(fpath);
+	}
+
+	int rmrf(const char * const path)
+	{
+		return nftw(path, unlink_cb, 64, FTW_DEPTH | FTW_PHYS);
+	}
+
+	void TearDown() override
+	{
+		int ret = 0;
+
+		ret = rmrf(PARENT_DIR);
+		ASSERT_EQ(ret, 0);
+	}
+};
+
+TEST_F(CgroupHandleTest, CgroupHandleOpenAll)
+{
+	struct cgroup_handle *handle = NULL;
+	int ret;
+
+	ret = cgroup_open(CG_NAME, NULL, &handle);
+	ASSERT_EQ(ret, 0);
+	ASSERT_NE(handle, nullptr);
+
+	/* cpu and cpuacct share a directory */
+	ASSERT_EQ(handle->ctrl_cnt, 3);
+	ASSERT_EQ(handle->dir_cnt, 2);
+	ASSERT_EQ(handle->ctrl_dir[0], handle->ctrl_dir[1]);
+	ASSERT_NE(handle->ctrl_dir[0], handle->ctrl_dir[2]);
+
+	cgroup_close(handle);
+}
+
+TEST_F(CgroupHandleTest, CgroupHandleOpenErrors)
+{
+	const char * const missing_ctrl[] = {"cpu", "freezer", NULL};
+	const char * const memory[] = {"memory", NULL};
+	struct cgroup_handle *handle = NULL;
+	int ret;
+
+	ret = cgroup_open("missingcg", NULL, &handle);
+	ASSERT_EQ(ret, ECGROUPNOTEXIST);
+	ASSERT_EQ(handle, nullptr);
+
+	ret = cgroup_open("missingcg", memory, &handle);
+	ASSERT_EQ(ret, ECGROUPNOTEXIST);
+	ASSERT_EQ(handle, nullptr);
+
+	ret = cgroup_open(CG_NAME, missing_ctrl, &handle);
+	ASSERT_EQ(ret, ECGROUPSUBSYSNOTMOUNTED);
+	ASSERT_EQ(handle, nullptr);
+}
+
+TEST_F(CgroupHandleTest, CgroupHandleRead)
+{
+	struct cgroup_handle *handle = NULL;
+	char value[64];
+	char tmp_path[FILENAME_MAX];
+	FILE *f;
+	int ret;
+
+	ret = cgroup_open(CG_NAME, NULL, &handle);
+	ASSERT_EQ(ret, 0);
+
+	ret = cgroup_handle_read(handle, "cpuacct.usage", value, sizeof(value));
+	ASSERT_EQ(ret, 0);
+	ASSERT_STREQ(value, "123456789");
+
+	ret = cgroup_handle_read(handle, "memory.stat", value, sizeof(value));
+	ASSERT_EQ(ret, 0);
+	ASSERT_STREQ(value, "anon 4096\nfile 8192");
+
+	/* The value is truncated to the size of the buffer */
+	ret = cgroup_handle_read(handle, "memory.stat", value, 5);
+	ASSERT_EQ(ret, 0);
+	ASSERT_STREQ(value, "anon");
+
+	/* The cached fd must return the current content of the file */
+	snprintf(tmp_path, FILENAME_MAX - 1, "%s/memory/%s/memory.stat", PARENT_DIR, CG_NAME);
+	f = fopen(tmp_path, "w");
+	ASSERT_NE(f, nullptr);
+	fprintf(f, "anon 0\n");
+	fclose(f);
+
+	ret = cgroup_handle_read(handle, "memory.stat", value, sizeof(value));
+	ASSERT_EQ(ret, 0);
+	ASSERT_STREQ(value, "anon 0");
+
+	ret = cgroup_handle_read(handle, "memory.foo", value, sizeof(value));
+	ASSERT_EQ(ret, ECGROUPVALUENOTEXIST);
+
+	ret = cgroup_handle_read(handle, "pids.max", value, sizeof(value));
+	ASSERT_EQ(ret, ECGROUPSUBSYSNOTMOUNTED);
+
+	cgroup_close(handle);
+}
+
+TEST_F(CgroupHandleTest, CgroupHandleReadAll)
+{
+	struct cgroup_handle *handle = NULL;
+	char tmp_path[FILENAME_MAX];
+	std::string stat;
+	char *value = NULL;
+	size_t size = 0;
+	FILE *f;
+	int ret, i;
+
+	/* Larger than the default buffer, like memory.stat on big machines */
+	for (i = 0; i < 1000; i++)
+		stat += "key" + std::to_string(i) + " " + std::to_string(i * 4096) + "\n";
+
+	snprintf(tmp_path, FILENAME_MAX - 1, "%s/memory/%s/memory.stat", PARENT_DIR, CG_NAME);
+	f = fopen(tmp_path, "w");
+	ASSERT_NE(f, nullptr);
+	fprintf(f, "%s", stat.c_str());
+	fclose(f);
+
+	ret = cgroup_open(CG_NAME, NULL, &handle);
+	ASSERT_EQ(ret, 0);
+
+	ret = cgroup_handle_read_all(handle, "memory.stat", &value, &size);
+	ASSERT_EQ(ret, 0);
+	ASSERT_GT(size, stat.size());
+	stat.pop_back();
+	ASSERT_STREQ(value, stat.c_str());
+
+	/* The buffer is reused */
+	ret = cgroup_handle_read_all(handle, "cpuacct.usage", &value, &size);
+	ASSERT_EQ(ret, 0);
+	ASSERT_STREQ(value, "123456789");
+	ASSERT_GT(size, stat.size());
+
+	ret = cgroup_handle_read_all(handle, "memory.foo", &value, &size);
+	ASSERT_EQ(ret, ECGROUPVALUENOTEXIST);
+
+	free(value);
+	cgroup_close(handle);
+}
+
+TEST_F(CgroupHandleTest, CgroupHandleWrite)
+{
+	const char * const controllers[] = {"cpu", "memory", NULL};
+	struct cgroup_handle *handle = NULL;
+	char value[64];
+	int ret;
+
+	ret = cgroup_open(CG_NAME, controllers, &handle);
+	ASSERT_EQ(ret, 0);
+
+	ret = cgroup_handle_write(handle, "memory.high", "1073741824");
+	ASSERT_EQ(ret, 0);
+	ReadFile("memory", "memory.high", value, sizeof(value));
+	ASSERT_STREQ(value, "1073741824");
+
+	ret = cgroup_handle_write(handle, "cpu.max", "50000 100000");
+	ASSERT_EQ(ret, 0);
+	ReadFile("cpu,cpuacct", "cpu.max", value, sizeof(value));
+	ASSERT_STREQ(value, "50000 100000");
+
+	/* cpuacct wasn't opened even though it shares the directory with cpu */
+	ret = cgroup_handle_write(handle, "cpuacct.usage", "0");
+	ASSERT_EQ(ret, ECGROUPSUBSYSNOTMOUNTED);
+
+	ret = cgroup_handle_write(handle, "cpu.foo", "1");
+	ASSERT_EQ(ret, ECGROUPVALUENOTEXIST);
+
+	cgroup_close(handle);
+}
+
+TEST_F(CgroupHandleTest, CgroupHandleNoPrefix)
+{
+	const char * const memory[] = {"memory", NULL};
+	struct cgroup_handle *handle = NULL;
+	char tmp_path[FILENAME_MAX];
+	char value[64];
+	FILE *f;
+	int ret, i;
+
+	for (i = 0; i < CONTROLLERS_CNT; i++) {
+		snprintf(tmp_path, FILENAME_MAX - 1, "%s/%s/%s/notify_on_release", PARENT_DIR,
+			 MOUNTS[i], CG_NAME);
+		f = fopen(tmp_path, "w");
+		ASSERT_NE(f, nullptr);
+		fprintf(f, "%d\n", !strcmp(MOUNTS[i], "memory"));
+		fclose(f);
+	}
+
+	/* The first v1 hierarchy of the handle */
+	ret = cgroup_open(CG_NAME, NULL, &handle);
+	ASSERT_EQ(ret, 0);
+	ret = cgroup_handle_read(handle, "notify_on_release", value, sizeof(value));
+	ASSERT_EQ(ret, 0);
+	ASSERT_STREQ(value, "0");
+	cgroup_close(handle);
+
+	ret = cgroup_open(CG_NAME, memory, &handle);
+	ASSERT_EQ(ret, 0);
+	ret = cgroup_handle_read(handle, "notify_on_release", value, sizeof(value));
+	ASSERT_EQ(ret, 0);
+	ASSERT_STREQ(value, "1");
+	ret = cgroup_handle_read(handle, "tasks", value, sizeof(value));
+	ASSERT_EQ(ret, ECGROUPVALUENOTEXIST);
+	cgroup_close(handle);
+
+	/* cgroup v2 has no such files */
+	for (i = 0; i < CONTROLLERS_CNT; i++)
+		cg_mount_table[i].version = CGROUP_V2;
+
+	ret = cgroup_open(CG_NAME, memory, &handle);
+	ASSERT_EQ(ret, 0);
+	ret = cgroup_handle_read(handle, "notify_on_release", value, sizeof(value));
+	ASSERT_EQ(ret, ECGROUPSUBSYSNOTMOUNTED);
+	cgroup_close(handle);
+}
+
+TEST_F(CgroupHandleTest, CgroupHandleAttach)
+{
+	struct cgroup_handle *handle = NULL;
+	char value[64];
+	int ret;
+
+	ret = cgroup_open(CG_NAME, NULL, &handle);
+	ASSERT_EQ(ret, 0);
+
+	ret = cgroup_handle_attach(handle, 1234);
+	ASSERT_EQ(ret, 0);
+
+	ReadFile("cpu,cpuacct", "cgroup.procs", value, sizeof(value));
+	ASSERT_STREQ(value, "1234");
+	ReadFile("memory", "cgroup.procs", value, sizeof(value));
+	ASSERT_STREQ(value, "1234");
+
+	cgroup_close(handle);
+}
@@ -0,0 +1,220 @@
+/* SPDX-License-Identifier: LGPL-2.1-only */
+/**
+ * libcgroup googletest for cgroup_attach_tasks()
+ */
+
+#include <fcntl.h>
+#include <ftw.h>
+
+#include "gtest/gtest.h"
+#include "libcgroup-internal.h"
+
+static const char * const PARENT_DIR = "test020cgroup";
+static const char * const CG_NAME = "batchcg";
+static const mode_t MODE = S_IRWXU | S_IRWXG | S_IRWXO;
+
+static const char * const CONTROLLERS[] = {
+	"cpu",
+	"memory",
+};
+static const int CONTROLLERS_CNT = ARRAY_SIZE(CONTROLLERS);
+
+class CgroupAttachTasksTest : public ::testing::Test {
+	protected:
+
+	void ReadTasks(const char * const ctrl_name, char *buf, size_t len)
+	{
+		char tmp_path[FILENAME_MAX];
+		size_t read_len;
+		FILE *f;
+
+		snprintf(tmp_path, FILENAME_MAX - 1, "%s/%s/%s/tasks", PARENT_DIR, ctrl_name,
+			 CG_NAME);
+
+		f = fopen(tmp_path, "r");
+		ASSERT_NE(f, nullptr);
+
+		read_len = fread(buf, 1, len - 1, f);
+		buf[read_len] = '\0';
+		fclose(f);
+	}
+
+	void SetUp() override
+	{
+		char tmp_path[FILENAME_MAX];
+		int i, ret;
+		FILE *f;
+
+		ret = cgroup_init();
+		ASSERT_EQ(ret, 0);
+
+		ret = mkdir(PARENT_DIR, MODE);
+		ASSERT_EQ(ret, 0);
+
+		/*
+		 * Artificially populate the mount table with local
+		 * directories
+		 */
+		memset(&cg_mount_table, 0, sizeof(cg_mount_table));
+		memset(&cg_namespace_table, 0, sizeof(cg_namespace_table));
+
+		for (i = 0; i < CONTROLLERS_CNT; i++) {
+			snprintf(cg_mount_table[i].name, CONTROL_NAMELEN_MAX, "%s", CONTROLLERS[i]);
+			snprintf(cg_mount_table[i].mount.path, FILENAME_MAX,
+				 "%s/%s", PARENT_DIR, CONTROLLERS[i]);
+			cg_mount_table[i].version = CGROUP_V1;
+
+			ret = mkdir(cg_mount_table[i].mount.path, MODE);
+			ASSERT_EQ(ret, 0);
+
+			snprintf(tmp_path, FILENAME_MAX - 1, "%s/%s/%s", PARENT_DIR, CONTROLLERS[i],
+				 CG_NAME);
+			ret = mkdir(tmp_path, MODE);
+			ASSERT_EQ(ret, 0);
+
+			snprintf(tmp_path, FILENAME_MAX - 1, "%s/%s/%s/tasks", PARENT_DIR,
+				 CONTROLLERS[i], CG_NAME);
+			f = fopen(tmp_path, "w");
+			ASSERT_NE(f, nullptr);
+			fclose(f);
+		}
+	}
+
+	/*
+	 * https://stackoverflow.com/questions/5467725/how-to-delete-a-directory-and-its-contents-in-posix-c
+	 */
+	static int unlink_cb(const char *fpath, const struct stat *sb, int typeflag,
+		      struct FTW *ftwbuf)
+	{
+		return remove(fpath);
+	}
+
+	int rmrf(const char * const path)
+	{
+		return nftw(path, unlink_cb, 64, FTW_DEPTH | FTW_PHYS);
+	}
+
+	void TearDown() override
+	{
+		int ret = 0;
+
+		ret = rmrf(PARENT_DIR);
+		ASSERT_EQ(ret, 0);
+	}
+};
+
+TEST_F(CgroupAttachTasksTest, CgroupAttachTasks)
+{
+	struct cgroup_attach_result results[3];
+	const pid_t tids[] = {100, 200, 300};
+	struct cgroup *cgrp;
+	char buf[64];
+	int ret, i;
+
+	cgrp = cgroup_new_cgroup(CG_NAME);
+	ASSERT_NE(cgrp, nullptr);
+	ASSERT_NE(cgroup_add_controller(cgrp, "cpu"), nullptr);
+	ASSERT_NE(cgroup_add_controller(cgrp, "memory"), nullptr);
+
+	memset(results, 0xff, sizeof(results));
+	ret = cgroup_attach_tasks(cgrp, tids, ARRAY_SIZE(tids), results);
+	ASSERT_EQ(ret, 0);
+
+	for (i = 0; i < (int)ARRAY_SIZE(tids); i++) {
+		ASSERT_EQ(results[i].ret, 0);
+		ASSERT_EQ(results[i].err, 0);
+	}
+
+	/* The tasks files are opened once, so the writes follow each other */
+	ReadTasks("cpu", buf, sizeof(buf));
+	ASSERT_STREQ(buf, "100200300");
+	ReadTasks("memory", buf, sizeof(buf));
+	ASSERT_STREQ(buf, "100200300");
+
+	cgroup_free(&cgrp);
+}
+
+TEST_F(CgroupAttachTasksTest, CgroupAttachTasksNoCgroup)
+{
+	struct cgroup_attach_result results[1];
+	const pid_t tids[] = {100};
+	struct cgroup *cgrp;
+	int ret;
+
+	cgrp = cgroup_new_cgroup("missingcg");
+	ASSERT_NE(cgrp, nullptr);
+	ASSERT_NE(cgroup_add_controller(cgrp, "cpu"), nullptr);
+
+	ret = cgroup_attach_tasks(cgrp, tids, ARRAY_SIZE(tids), results);
+	ASSERT_EQ(ret, ECGROUPNOTEXIST);
+
+	cgroup_free(&cgrp);
+}
+
+TEST_F(CgroupAttachTasksTest, CgroupAttachTasksInvalidTids)
+{
+	struct cgroup *cgrp;
+	int ret;
+
+	cgrp = cgroup_new_cgroup(CG_NAME);
+	ASSERT_NE(cgrp, nullptr);
+	ASSERT_NE(cgroup_add_controller(cgrp, "cpu"), nullptr);
+
+	ret = cgroup_attach_tasks(cgrp, NULL, 1, NULL);
+	ASSERT_EQ(ret, ECGINVAL);
+
+	/* Nothing to move */
+	ret = cgroup_attach_tasks(cgrp, NULL, 0, NULL);
+	ASSERT_EQ(ret, 0);
+
+	cgroup_free(&cgrp);
+}
+
+TEST_F(CgroupAttachTasksTest, CgroupAttachTasksSharedHierarchy)
+{
+	struct cgroup_attach_result results[2];
+	char tmp_path[FILENAME_MAX];
+	const pid_t tids[] = {100, 200};
+	struct cgroup *cgrp;
+	char buf[64];
+	ssize_t len;
+	int ret, fd;
+
+	/* cpuacct is co-mounted with cpu */
+	snprintf(cg_mount_table[CONTROLLERS_CNT].name, CONTROL_NAMELEN_MAX, "cpuacct");
+	snprintf(cg_mount_table[CONTROLLERS_CNT].mount.path, FILENAME_MAX, "%s",
+		 cg_mount_table[0].mount.path);
+	cg_mount_table[CONTROLLERS_CNT].version = CGROUP_V1;
+	cg_mount_table[0].shared_mnt = 1;
+	cg_mount_table[CONTROLLERS_CNT].shared_mnt = 1;
+
+	/*
+	 * Two writers of a regular file would overwrite each other, a fifo
+	 * shows every write
+	 */
+	snprintf(tmp_path, FILENAME_MAX - 1, "%s/cpu/%s/tasks", PARENT_DIR, CG_NAME);
+	ASSERT_EQ(unlink(tmp_path), 0);
+	ASSERT_EQ(mkfifo(tmp_path, MODE), 0);
+	fd = open(tmp_path, O_RDONLY | O_NONBLOCK);
+	ASSERT_GE(fd, 0);
+
+	cgrp = cgroup_new_cgroup(CG_NAME);
+	ASSERT_NE(cgrp, nullptr);
+	ASSERT_NE(cgroup_add_controller(cgrp, "cpu"), nullptr);
+	ASSERT_NE(cgroup_add_controller(cgrp, "cpuacct"), nullptr);
+	ASSERT_NE(cgroup_add_controller(cgrp, "memory"), nullptr);
+
+	ret = cgroup_attach_tasks(cgrp, tids, ARRAY_SIZE(tids), results);
+	ASSERT_EQ(ret, 0);
+
+	/* Every task is written once per hierarchy */
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	ASSERT_GT(len, 0);
+	buf[len] = '\0';
+	ASSERT_STREQ(buf, "100200");
+	ReadTasks("memory", buf, sizeof(buf));
+	ASSERT_STREQ(buf, "100200");
+
+	cgroup_free(&cgrp);
+}
@@ -0,0 +1,130 @@
+/* SPDX-License-Identifier: LGPL-2.1-only */
+/**
+ * libcgroup googletest for cg_move_task_files()
+ */
+
+#include <fcntl.h>
+
+#include "gtest/gtest.h"
+#include "libcgroup-internal.h"
+
+static const char * const INPUT_FILE = "test021-input";
+static const char * const OUTPUT_FILE = "test021-output";
+
+class MoveTaskFilesTest : public ::testing::Test {
+	protected:
+
+	int in_fd;
+	int out_fd;
+
+	void WriteInput(const char * const tasks)
+	{
+		FILE *f;
+
+		f = fopen(INPUT_FILE, "w");
+		ASSERT_NE(f, nullptr);
+		fprintf(f, "%s", tasks);
+		fclose(f);
+
+		in_fd = open(INPUT_FILE, O_RDONLY);
+		ASSERT_GE(in_fd, 0);
+	}
+
+	void ReadOutput(char *buf, size_t len)
+	{
+		size_t read_len;
+		FILE *f;
+
+		f = fopen(OUTPUT_FILE, "r");
+		ASSERT_NE(f, nullptr);
+
+		read_len = fread(buf, 1, len - 1, f);
+		buf[read_len] = '\0';
+		fclose(f);
+	}
+
+	void SetUp() override
+	{
+		in_fd = -1;
+		out_fd = open(OUTPUT_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		ASSERT_GE(out_fd, 0);
+	}
+
+	void TearDown() override
+	{
+		if (in_fd >= 0)
+			close(in_fd);
+		close(out_fd);
+
+		remove(INPUT_FILE);
+		remove(OUTPUT_FILE);
+	}
+};
+
+TEST_F(MoveTaskFilesTest, MoveTaskFiles)
+{
+	char buf[64];
+	int ret;
+
+	WriteInput("1\n22\n333\n4444\n");
+
+	ret = cg_move_task_files(in_fd, out_fd);
+	ASSERT_EQ(ret, 0);
+
+	/* One write() per task, there are no separators in a regular file */
+	ReadOutput(buf, sizeof(buf));
+	ASSERT_STREQ(buf, "1223334444");
+}
+
+TEST_F(MoveTaskFilesTest, MoveTaskFilesEmpty)
+{
+	char buf[64];
+	int ret;
+
+	WriteInput("");
+
+	ret = cg_move_task_files(in_fd, out_fd);
+	ASSERT_EQ(ret, 0);
+
+	ReadOutput(buf, sizeof(buf));
+	ASSERT_STREQ(buf, "");
+}
+
+TEST_F(MoveTaskFilesTest, MoveTaskFilesLarge)
+{
+	std::string tasks, expected;
+	char buf[128 * 1024];
+	char tid[16];
+	int ret, i;
+
+	/* Larger than the initial read buffer */
+	for (i = 1; i <= 10000; i++) {
+		snprintf(tid, sizeof(tid), "%d", i);
+		tasks += tid;
+		tasks += "\n";
+		expected += tid;
+	}
+	WriteInput(tasks.c_str());
+
+	ret = cg_move_task_files(in_fd, out_fd);
+	ASSERT_EQ(ret, 0);
+
+	ReadOutput(buf, sizeof(buf));
+	ASSERT_STREQ(buf, expected.c_str());
+}
+
+TEST_F(MoveTaskFilesTest, MoveTaskFilesWriteError)
+{
+	int ret;
+
+	WriteInput("1\n");
+
+	/* The output isn't writable */
+	close(out_fd);
+	out_fd = open(OUTPUT_FILE, O_RDONLY);
+	ASSERT_GE(out_fd, 0);
+
+	ret = cg_move_task_files(in_fd, out_fd);
+	ASSERT_EQ(ret, ECGOTHER);
+	ASSERT_EQ(cgroup_get_last_errno(), EBADF);
+}
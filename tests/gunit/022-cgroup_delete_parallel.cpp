@@ -0,0 +1,236 @@
+/* SPDX-License-Identifier: LGPL-2.1-only */
+/**
+ * libcgroup googletest for cgroup_delete_cgroup_ext() with
+ * CGFLAG_DELETE_PARALLEL
+ */
+
+#include <ftw.h>
+
+#include "gtest/gtest.h"
+#include "libcgroup-internal.h"
+
+static const char * const PARENT_DIR = "test022cgroup";
+static const char * const CONTROLLER = "cpu";
+static const char * const CG_NAME = "jobs";
+static const mode_t MODE = S_IRWXU | S_IRWXG | S_IRWXO;
+
+/* jobs/job<i>/task<j>/thread<k> */
+static const int JOBS = 8;
+static const int TASKS = 4;
+static const int THREADS = 2;
+
+class CgroupDeleteParallelTest : public ::testing::Test {
+	protected:
+
+	char mnt_path[FILENAME_MAX];
+
+	void MakeDir(const char * const name)
+	{
+		char tmp_path[FILENAME_MAX];
+		int ret;
+
+		snprintf(tmp_path, FILENAME_MAX - 1, "%s/%s", mnt_path, name);
+		ret = mkdir(tmp_path, MODE);
+		ASSERT_EQ(ret, 0);
+	}
+
+	bool Exists(const char * const name)
+	{
+		char tmp_path[FILENAME_MAX];
+		struct stat st;
+
+		snprintf(tmp_path, FILENAME_MAX - 1, "%s/%s", mnt_path, name);
+		return stat(tmp_path, &st) == 0;
+	}
+
+	void SetUp() override
+	{
+		char name[FILENAME_MAX];
+		int i, j, k, ret;
+		FILE *f;
+
+		ret = cgroup_init();
+		ASSERT_EQ(ret, 0);
+
+		ret = mkdir(PARENT_DIR, MODE);
+		ASSERT_EQ(ret, 0);
+
+		/*
+		 * Artificially populate the mount table with local
+		 * directories
+		 */
+		memset(&cg_mount_table, 0, sizeof(cg_mount_table));
+		memset(&cg_namespace_table, 0, sizeof(cg_namespace_table));
+
+		snprintf(mnt_path, FILENAME_MAX, "%s/%s", PARENT_DIR, CONTROLLER);
+		snprintf(cg_mount_table[0].name, CONTROL_NAMELEN_MAX, "%s", CONTROLLER);
+		snprintf(cg_mount_table[0].mount.path, FILENAME_MAX, "%s", mnt_path);
+		cg_mount_table[0].version = CGROUP_V1;
+
+		ret = mkdir(mnt_path, MODE);
+		ASSERT_EQ(ret, 0);
+
+		/* The tasks of the deleted groups are moved to the root */
+		snprintf(name, FILENAME_MAX - 1, "%s/tasks", mnt_path);
+		f = fopen(name, "w");
+		ASSERT_NE(f, nullptr);
+		fclose(f);
+
+		MakeDir(CG_NAME);
+		for (i = 0; i < JOBS; i++) {
+			snprintf(name, FILENAME_MAX - 1, "%s/job%d", CG_NAME, i);
+			MakeDir(name);
+
+			for (j = 0; j < TASKS; j++) {
+				snprintf(name, FILENAME_MAX - 1, "%s/job%d/task%d", CG_NAME, i, j);
+				MakeDir(name);
+
+				for (k = 0; k < THREADS; k++) {
+					snprintf(name, FILENAME_MAX - 1, "%s/job%d/task%d/thread%d",
+						 CG_NAME, i, j, k);
+					MakeDir(name);
+				}
+			}
+		}
+	}
+
+	/*
+	 * https://stackoverflow.com/questions/5467725/how-to-delete-a-directory-and-its-contents-in-posix-c
+	 */
+	static int unlink_cb(const char *fpath, const struct stat *sb, int typeflag,
+		      struct FTW *ftwbuf)
+	{
+		return remove(fpath);
+	}
+
+	int rmrf(const char * const path)
+	{
+		return nftw(path, unlink_cb, 64, FTW_DEPTH | FTW_PHYS);
+	}
+
+	void TearDown() override
+	{
+		int ret = 0;
+
+		ret = rmrf(PARENT_DIR);
+		ASSERT_EQ(ret, 0);
+	}
+};
+
+TEST_F(CgroupDeleteParallelTest, CgroupDeleteParallel)
+{
+	struct cgroup *cgrp;
+	int ret;
+
+	cgrp = cgroup_new_cgroup(CG_NAME);
+	ASSERT_NE(cgrp, nullptr);
+	ASSERT_NE(cgroup_add_controller(cgrp, CONTROLLER), nullptr);
+
+	ret = cgroup_delete_cgroup_ext(cgrp, CGFLAG_DELETE_RECURSIVE | CGFLAG_DELETE_PARALLEL);
+	ASSERT_EQ(ret, 0);
+	ASSERT_FALSE(Exists(CG_NAME));
+
+	cgroup_free(&cgrp);
+}
+
+TEST_F(CgroupDeleteParallelTest, CgroupDeleteKillNotRecursive)
+{
+	char name[FILENAME_MAX];
+	struct cgroup *cgrp;
+	struct stat st;
+	FILE *f;
+	int ret;
+
+	snprintf(name, FILENAME_MAX - 1, "%s/%s/cgroup.kill", mnt_path, CG_NAME);
+	f = fopen(name, "w");
+	ASSERT_NE(f, nullptr);
+	fclose(f);
+
+	cgrp = cgroup_new_cgroup(CG_NAME);
+	ASSERT_NE(cgrp, nullptr);
+	ASSERT_NE(cgroup_add_controller(cgrp, CONTROLLER), nullptr);
+
+	/* The subgroups would be killed but not removed */
+	ret = cgroup_delete_cgroup_ext(cgrp, CGFLAG_DELETE_KILL);
+	ASSERT_EQ(ret, ECGINVAL);
+
+	ASSERT_EQ(stat(name, &st), 0);
+	ASSERT_EQ(st.st_size, 0);
+	ASSERT_TRUE(Exists("jobs/job0/task0"));
+
+	cgroup_free(&cgrp);
+}
+
+TEST_F(CgroupDeleteParallelTest, CgroupDeleteParallelFailure)
+{
+	char name[FILENAME_MAX];
+	struct cgroup *cgrp;
+	FILE *f;
+	int ret;
+
+	/* A group with a file can't be removed */
+	snprintf(name, FILENAME_MAX - 1, "%s/%s/job3/task1/thread0/busy", mnt_path, CG_NAME);
+	f = fopen(name, "w");
+	ASSERT_NE(f, nullptr);
+	fclose(f);
+
+	cgrp = cgroup_new_cgroup(CG_NAME);
+	ASSERT_NE(cgrp, nullptr);
+	ASSERT_NE(cgroup_add_controller(cgrp, CONTROLLER), nullptr);
+
+	ret = cgroup_delete_cgroup_ext(cgrp, CGFLAG_DELETE_RECURSIVE | CGFLAG_DELETE_PARALLEL);
+	ASSERT_EQ(ret, ECGOTHER);
+	ASSERT_EQ(cgroup_get_last_errno(), ENOTEMPTY);
+
+	/* The ancestors of the busy group are left in place */
+	ASSERT_TRUE(Exists("jobs/job3/task1/thread0"));
+	ASSERT_TRUE(Exists("jobs/job3/task1"));
+	ASSERT_TRUE(Exists("jobs/job3"));
+	ASSERT_TRUE(Exists(CG_NAME));
+
+	cgroup_free(&cgrp);
+}
+
+TEST_F(CgroupDeleteParallelTest, CgroupDeleteParallelNamespace)
+{
+	char name[FILENAME_MAX];
+	struct cgroup *cgrp;
+	int i, j, ret;
+	FILE *f;
+
+	/* The namespace is thread local, the worker threads must use it too */
+	MakeDir("ns");
+	snprintf(name, FILENAME_MAX - 1, "%s/ns/tasks", mnt_path);
+	f = fopen(name, "w");
+	ASSERT_NE(f, nullptr);
+	fclose(f);
+
+	MakeDir("ns/jobs");
+	for (i = 0; i < JOBS; i++) {
+		snprintf(name, FILENAME_MAX - 1, "ns/jobs/job%d", i);
+		MakeDir(name);
+
+		for (j = 0; j < TASKS; j++) {
+			snprintf(name, FILENAME_MAX - 1, "ns/jobs/job%d/task%d", i, j);
+			MakeDir(name);
+		}
+	}
+
+	cg_namespace_table[0] = strdup("ns");
+	ASSERT_NE(cg_namespace_table[0], nullptr);
+
+	cgrp = cgroup_new_cgroup(CG_NAME);
+	ASSERT_NE(cgrp, nullptr);
+	ASSERT_NE(cgroup_add_controller(cgrp, CONTROLLER), nullptr);
+
+	ret = cgroup_delete_cgroup_ext(cgrp, CGFLAG_DELETE_RECURSIVE | CGFLAG_DELETE_PARALLEL);
+	ASSERT_EQ(ret, 0);
+	ASSERT_FALSE(Exists("ns/jobs"));
+
+	/* The groups outside of the namespace are left alone */
+	ASSERT_TRUE(Exists("jobs/job0/task0/thread0"));
+
+	free(cg_namespace_table[0]);
+	cg_namespace_table[0] = NULL;
+	cgroup_free(&cgrp);
+}
@@ -0,0 +1,250 @@
+/* SPDX-License-Identifier: LGPL-2.1-only */
+/**
+ * libcgroup googletest for the cgroup_pool functions
+ */
+
+#include <ftw.h>
+
+#include "gtest/gtest.h"
+#include "libcgroup-internal.h"
+
+static const char * const PARENT_DIR = "test023cgroup";
+static const char * const CONTROLLER = "cpu";
+static const char * const POOL_PARENT = "pooljobs";
+static const mode_t MODE = S_IRWXU | S_IRWXG | S_IRWXO;
+
+static const int POOL_SIZE = 3;
+
+class CgroupPoolTest : public ::testing::Test {
+	protected:
+
+	char mnt_path[FILENAME_MAX];
+	struct cgroup *tmpl;
+
+	bool Exists(const char * const name)
+	{
+		char tmp_path[FILENAME_MAX];
+		struct stat st;
+
+		snprintf(tmp_path, FILENAME_MAX - 1, "%s/%s", mnt_path, name);
+		return stat(tmp_path, &st) == 0;
+	}
+
+	int CountGroups(const char * const prefix = "")
+	{
+		char tmp_path[FILENAME_MAX];
+		struct dirent *ent;
+		int cnt = 0;
+		DIR *dir;
+
+		snprintf(tmp_path, FILENAME_MAX - 1, "%s/%s%s", mnt_path, prefix, POOL_PARENT);
+		dir = opendir(tmp_path);
+		if (!dir)
+			return -1;
+
+		while ((ent = readdir(dir)) != NULL) {
+			if (strncmp(ent->d_name, "pool-", 5) == 0)
+				cnt++;
+		}
+		closedir(dir);
+
+		return cnt;
+	}
+
+	/* Wait for the background thread to fill the pool */
+	int WaitReady(struct cgroup_pool *pool, int cnt)
+	{
+		int ready = 0;
+		int i;
+
+		for (i = 0; i < 500; i++) {
+			pthread_mutex_lock(&pool->lock);
+			ready = pool->ready_cnt;
+			pthread_mutex_unlock(&pool->lock);
+
+			if (ready >= cnt)
+				break;
+			usleep(10000);
+		}
+
+		return ready;
+	}
+
+	/* Deleting a group moves its tasks to the parent */
+	void CreateParentTasks(const char * const prefix = "")
+	{
+		char tmp_path[FILENAME_MAX];
+		FILE *f;
+
+		snprintf(tmp_path, FILENAME_MAX - 1, "%s/%s%s/tasks", mnt_path, prefix,
+			 POOL_PARENT);
+		f = fopen(tmp_path, "w");
+		ASSERT_NE(f, nullptr);
+		fclose(f);
+	}
+
+	void SetUp() override
+	{
+		int ret;
+
+		ret = cgroup_init();
+		ASSERT_EQ(ret, 0);
+
+		ret = mkdir(PARENT_DIR, MODE);
+		ASSERT_EQ(ret, 0);
+
+		/*
+		 * Artificially populate the mount table with local
+		 * directories
+		 */
+		memset(&cg_mount_table, 0, sizeof(cg_mount_table));
+		memset(&cg_namespace_table, 0, sizeof(cg_namespace_table));
+
+		snprintf(mnt_path, FILENAME_MAX, "%s/%s", PARENT_DIR, CONTROLLER);
+		snprintf(cg_mount_table[0].name, CONTROL_NAMELEN_MAX, "%s", CONTROLLER);
+		snprintf(cg_mount_table[0].mount.path, FILENAME_MAX, "%s", mnt_path);
+		cg_mount_table[0].version = CGROUP_V1;
+
+		ret = mkdir(mnt_path, MODE);
+		ASSERT_EQ(ret, 0);
+
+		tmpl = cgroup_new_cgroup("template");
+		ASSERT_NE(tmpl, nullptr);
+		ASSERT_NE(cgroup_add_controller(tmpl, CONTROLLER), nullptr);
+	}
+
+	/*
+	 * https://stackoverflow.com/questions/5467725/how-to-delete-a-directory-and-its-contents-in-posix-c
+	 */
+	static int unlink_cb(const char *fpath, const struct stat *sb, int typeflag,
+		      struct FTW *ftwbuf)
+	{
+		return remove(fpath);
+	}
+
+	int rmrf(const char * const path)
+	{
+		return nftw(path, unlink_cb, 64, FTW_DEPTH | FTW_PHYS);
+	}
+
+	void TearDown() override
+	{
+		int ret = 0;
+
+		cgroup_free(&tmpl);
+
+		ret = rmrf(PARENT_DIR);
+		ASSERT_EQ(ret, 0);
+	}
+};
+
+TEST_F(CgroupPoolTest, CgroupPoolCreate)
+{
+	struct cgroup_pool *pool = NULL;
+	int ret;
+
+	ret = cgroup_pool_create(POOL_PARENT, tmpl, POOL_SIZE, &pool);
+	ASSERT_EQ(ret, 0);
+	ASSERT_NE(pool, nullptr);
+
+	/* The initial groups are created upfront */
+	ASSERT_EQ(pool->ready_cnt, POOL_SIZE);
+	ASSERT_EQ(CountGroups(), POOL_SIZE);
+
+	CreateParentTasks();
+	cgroup_pool_destroy(&pool);
+	ASSERT_EQ(pool, nullptr);
+	ASSERT_EQ(CountGroups(), 0);
+	ASSERT_TRUE(Exists(POOL_PARENT));
+}
+
+TEST_F(CgroupPoolTest, CgroupPoolAcquireRelease)
+{
+	struct cgroup *cgrps[POOL_SIZE + 1];
+	struct cgroup_pool *pool = NULL;
+	struct cgroup other;
+	int ret, i;
+
+	ret = cgroup_pool_create(POOL_PARENT, tmpl, POOL_SIZE, &pool);
+	ASSERT_EQ(ret, 0);
+
+	/* The last group is created on demand */
+	for (i = 0; i < POOL_SIZE + 1; i++) {
+		ret = cgroup_pool_acquire(pool, &cgrps[i]);
+		ASSERT_EQ(ret, 0);
+		ASSERT_EQ(strncmp(cgrps[i]->name, "pooljobs/pool-", 14), 0);
+		ASSERT_TRUE(Exists(cgrps[i]->name));
+	}
+
+	for (i = 1; i < POOL_SIZE + 1; i++)
+		ASSERT_STRNE(cgrps[0]->name, cgrps[i]->name);
+
+	/* The pool is topped up in the background */
+	ASSERT_EQ(WaitReady(pool, POOL_SIZE), POOL_SIZE);
+
+	/* A released group is reset and handed out again */
+	ret = cgroup_pool_release(pool, cgrps[0]);
+	ASSERT_EQ(ret, 0);
+	ASSERT_EQ(WaitReady(pool, POOL_SIZE + 1), POOL_SIZE + 1);
+
+	ret = cgroup_pool_release(pool, cgrps[0]);
+	ASSERT_EQ(ret, ECGROUPNOTEXIST);
+
+	memset(&other, 0, sizeof(other));
+	ret = cgroup_pool_release(pool, &other);
+	ASSERT_EQ(ret, ECGROUPNOTEXIST);
+
+	CreateParentTasks();
+	cgroup_pool_destroy(&pool);
+
+	/* The groups still acquired are left in place */
+	ASSERT_EQ(CountGroups(), POOL_SIZE);
+}
+
+TEST_F(CgroupPoolTest, CgroupPoolInvalid)
+{
+	struct cgroup_pool *pool = NULL;
+	int ret;
+
+	ret = cgroup_pool_create(NULL, tmpl, POOL_SIZE, &pool);
+	ASSERT_EQ(ret, ECGINVAL);
+
+	ret = cgroup_pool_create(POOL_PARENT, NULL, POOL_SIZE, &pool);
+	ASSERT_EQ(ret, ECGINVAL);
+
+	ret = cgroup_pool_create(POOL_PARENT, tmpl, -1, &pool);
+	ASSERT_EQ(ret, ECGINVAL);
+	ASSERT_EQ(pool, nullptr);
+}
+
+TEST_F(CgroupPoolTest, CgroupPoolNamespace)
+{
+	char tmp_path[FILENAME_MAX];
+	struct cgroup_pool *pool = NULL;
+	struct cgroup *cgrp;
+	int ret;
+
+	snprintf(tmp_path, FILENAME_MAX - 1, "%s/ns", mnt_path);
+	ASSERT_EQ(mkdir(tmp_path, MODE), 0);
+
+	/* The namespace is thread local, the background thread must use it too */
+	cg_namespace_table[0] = strdup("ns");
+	ASSERT_NE(cg_namespace_table[0], nullptr);
+
+	ret = cgroup_pool_create(POOL_PARENT, tmpl, 1, &pool);
+	ASSERT_EQ(ret, 0);
+
+	ret = cgroup_pool_acquire(pool, &cgrp);
+	ASSERT_EQ(ret, 0);
+	ASSERT_EQ(WaitReady(pool, 1), 1);
+
+	ASSERT_EQ(CountGroups("ns/"), 2);
+	ASSERT_FALSE(Exists(POOL_PARENT));
+
+	CreateParentTasks("ns/");
+	cgroup_pool_destroy(&pool);
+	ASSERT_EQ(CountGroups("ns/"), 1);
+
+	free(cg_namespace_table[0]);
+	cg_namespace_table[0] = NULL;
+}
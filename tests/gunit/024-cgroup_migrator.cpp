@@ -0,0 +1,277 @@
+/* SPDX-License-Identifier: LGPL-2.1-only */
+/**
+ * libcgroup googletest for the cgroup_migrator functions
+ */
+
+#include <ftw.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#include "gtest/gtest.h"
+#include "libcgroup-internal.h"
+
+static const char * const PARENT_DIR = "test024cgroup";
+static const mode_t MODE = S_IRWXU | S_IRWXG | S_IRWXO;
+
+static const char * const CONTROLLERS[] = {
+	"cpu",
+	"memory",
+	NULL,
+};
+static const int CONTROLLERS_CNT = ARRAY_SIZE(CONTROLLERS) - 1;
+
+static const char * const GROUPS[] = {
+	"jobs-a",
+	"jobs-b",
+};
+static const int GROUPS_CNT = ARRAY_SIZE(GROUPS);
+
+static const int CHILDREN_CNT = 3;
+
+class CgroupMigratorTest : public ::testing::Test {
+	protected:
+
+	pid_t children[CHILDREN_CNT];
+
+	void ReadTasks(const char * const ctrl_name, const char * const cg_name, char *buf,
+		       size_t len)
+	{
+		char tmp_path[FILENAME_MAX];
+		size_t read_len;
+		FILE *f;
+
+		snprintf(tmp_path, FILENAME_MAX - 1, "%s/%s/%s/tasks", PARENT_DIR, ctrl_name,
+			 cg_name);
+
+		f = fopen(tmp_path, "r");
+		ASSERT_NE(f, nullptr);
+
+		read_len = fread(buf, 1, len - 1, f);
+		buf[read_len] = '\0';
+		fclose(f);
+	}
+
+	void SetUp() override
+	{
+		char tmp_path[FILENAME_MAX];
+		int i, j, ret;
+		FILE *f;
+
+		ret = cgroup_init();
+		ASSERT_EQ(ret, 0);
+
+		ret = mkdir(PARENT_DIR, MODE);
+		ASSERT_EQ(ret, 0);
+
+		/*
+		 * Artificially populate the mount table with local
+		 * directories
+		 */
+		memset(&cg_mount_table, 0, sizeof(cg_mount_table));
+		memset(&cg_namespace_table, 0, sizeof(cg_namespace_table));
+
+		for (i = 0; i < CONTROLLERS_CNT; i++) {
+			snprintf(cg_mount_table[i].name, CONTROL_NAMELEN_MAX, "%s", CONTROLLERS[i]);
+			snprintf(cg_mount_table[i].mount.path, FILENAME_MAX,
+				 "%s/%s", PARENT_DIR, CONTROLLERS[i]);
+			cg_mount_table[i].version = CGROUP_V1;
+
+			ret = mkdir(cg_mount_table[i].mount.path, MODE);
+			ASSERT_EQ(ret, 0);
+
+			for (j = 0; j < GROUPS_CNT; j++) {
+				snprintf(tmp_path, FILENAME_MAX - 1, "%s/%s/%s", PARENT_DIR,
+					 CONTROLLERS[i], GROUPS[j]);
+				ret = mkdir(tmp_path, MODE);
+				ASSERT_EQ(ret, 0);
+
+				snprintf(tmp_path, FILENAME_MAX - 1, "%s/%s/%s/tasks", PARENT_DIR,
+					 CONTROLLERS[i], GROUPS[j]);
+				f = fopen(tmp_path, "w");
+				ASSERT_NE(f, nullptr);
+				fclose(f);
+			}
+		}
+
+		/* Single threaded processes, the tasks files get one tid each */
+		for (i = 0; i < CHILDREN_CNT; i++) {
+			children[i] = fork();
+			ASSERT_GE(children[i], 0);
+
+			if (children[i] == 0) {
+				pause();
+				_exit(0);
+			}
+		}
+	}
+
+	/*
+	 * https://stackoverflow.com/questions/5467725/how-to-delete-a-directory-and-its-contents-in-posix-c
+	 */
+	static int unlink_cb(const char *fpath, const struct stat *sb, int typeflag,
+		      struct FTW *ftwbuf)
+	{
+		return remove(fpath);
+	}
+
+	int rmrf(const char * const path)
+	{
+		return nftw(path, unlink_cb, 64, FTW_DEPTH | FTW_PHYS);
+	}
+
+	void TearDown() override
+	{
+		int ret = 0;
+		int i;
+
+		for (i = 0; i < CHILDREN_CNT; i++) {
+			if (children[i] > 0) {
+				kill(children[i], SIGKILL);
+				waitpid(children[i], NULL, 0);
+			}
+		}
+
+		ret = rmrf(PARENT_DIR);
+		ASSERT_EQ(ret, 0);
+	}
+};
+
+TEST_F(CgroupMigratorTest, CgroupMigratorFlush)
+{
+	struct cgroup_migrator *migrator = NULL;
+	struct cgroup_migrator_stats stats;
+	char expected[64];
+	char buf[64];
+	int ret;
+
+	ret = cgroup_migrator_create(0, 0, &migrator);
+	ASSERT_EQ(ret, 0);
+
+	ret = cgroup_migrator_add(migrator, GROUPS[0], CONTROLLERS, children[0]);
+	ASSERT_EQ(ret, 0);
+	ret = cgroup_migrator_add(migrator, GROUPS[1], CONTROLLERS, children[1]);
+	ASSERT_EQ(ret, 0);
+	ret = cgroup_migrator_add(migrator, GROUPS[0], CONTROLLERS, children[2]);
+	ASSERT_EQ(ret, 0);
+
+	/* Nothing is moved before the flush */
+	ReadTasks("cpu", GROUPS[0], buf, sizeof(buf));
+	ASSERT_STREQ(buf, "");
+
+	ret = cgroup_migrator_flush(migrator);
+	ASSERT_EQ(ret, 0);
+
+	/* The moves are grouped by destination */
+	snprintf(expected, sizeof(expected), "%d%d", children[0], children[2]);
+	ReadTasks("cpu", GROUPS[0], buf, sizeof(buf));
+	ASSERT_STREQ(buf, expected);
+	ReadTasks("memory", GROUPS[0], buf, sizeof(buf));
+	ASSERT_STREQ(buf, expected);
+
+	snprintf(expected, sizeof(expected), "%d", children[1]);
+	ReadTasks("cpu", GROUPS[1], buf, sizeof(buf));
+	ASSERT_STREQ(buf, expected);
+	ReadTasks("memory", GROUPS[1], buf, sizeof(buf));
+	ASSERT_STREQ(buf, expected);
+
+	ret = cgroup_migrator_get_stats(migrator, &stats);
+	ASSERT_EQ(ret, 0);
+	ASSERT_EQ(stats.moved, 3);
+	ASSERT_EQ(stats.failed, 0);
+	ASSERT_EQ(stats.batches, 2);
+	ASSERT_GT(stats.moves_per_sec, 0);
+	ASSERT_GE(stats.max_latency_us, stats.avg_latency_us);
+
+	/* The queues are empty after the flush */
+	ret = cgroup_migrator_flush(migrator);
+	ASSERT_EQ(ret, 0);
+	ASSERT_EQ(migrator->dests, nullptr);
+
+	cgroup_migrator_free(&migrator);
+	ASSERT_EQ(migrator, nullptr);
+}
+
+TEST_F(CgroupMigratorTest, CgroupMigratorNoCgroup)
+{
+	struct cgroup_migrator *migrator = NULL;
+	struct cgroup_migrator_stats stats;
+	char expected[64];
+	char buf[64];
+	int ret;
+
+	ret = cgroup_migrator_create(0, 0, &migrator);
+	ASSERT_EQ(ret, 0);
+
+	ret = cgroup_migrator_add(migrator, "missingcg", CONTROLLERS, children[0]);
+	ASSERT_EQ(ret, 0);
+	ret = cgroup_migrator_add(migrator, "missingcg", CONTROLLERS, children[1]);
+	ASSERT_EQ(ret, 0);
+	ret = cgroup_migrator_add(migrator, GROUPS[1], CONTROLLERS, children[2]);
+	ASSERT_EQ(ret, 0);
+
+	/* A broken destination doesn't stop the others */
+	ret = cgroup_migrator_flush(migrator);
+	ASSERT_EQ(ret, ECGROUPNOTEXIST);
+
+	snprintf(expected, sizeof(expected), "%d", children[2]);
+	ReadTasks("cpu", GROUPS[1], buf, sizeof(buf));
+	ASSERT_STREQ(buf, expected);
+
+	ret = cgroup_migrator_get_stats(migrator, &stats);
+	ASSERT_EQ(ret, 0);
+	ASSERT_EQ(stats.moved, 1);
+	ASSERT_EQ(stats.failed, 2);
+
+	cgroup_migrator_free(&migrator);
+}
+
+TEST_F(CgroupMigratorTest, CgroupMigratorRate)
+{
+	struct cgroup_migrator *migrator = NULL;
+	struct timespec start, end;
+	const int moves = 5;
+	const int rate = 50;
+	long elapsed_ms;
+	int ret, i;
+
+	ret = cgroup_migrator_create(rate, 1, &migrator);
+	ASSERT_EQ(ret, 0);
+
+	for (i = 0; i < moves; i++) {
+		ret = cgroup_migrator_add(migrator, GROUPS[0], CONTROLLERS, children[0]);
+		ASSERT_EQ(ret, 0);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	ret = cgroup_migrator_flush(migrator);
+	ASSERT_EQ(ret, 0);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	/* The first move uses the burst, the others wait for a token */
+	elapsed_ms = (end.tv_sec - start.tv_sec) * 1000 +
+		     (end.tv_nsec - start.tv_nsec) / 1000000;
+	ASSERT_GE(elapsed_ms, (moves - 1) * 1000 / rate - 1);
+
+	cgroup_migrator_free(&migrator);
+}
+
+TEST_F(CgroupMigratorTest, CgroupMigratorInvalid)
+{
+	struct cgroup_migrator *migrator = NULL;
+	int ret;
+
+	ret = cgroup_migrator_create(0, 0, NULL);
+	ASSERT_EQ(ret, ECGINVAL);
+
+	ret = cgroup_migrator_create(0, 0, &migrator);
+	ASSERT_EQ(ret, 0);
+
+	ret = cgroup_migrator_add(migrator, NULL, CONTROLLERS, children[0]);
+	ASSERT_EQ(ret, ECGINVAL);
+
+	ret = cgroup_migrator_classify(NULL, 0, 0, NULL, children[0], 0);
+	ASSERT_EQ(ret, ECGINVAL);
+
+	cgroup_migrator_free(&migrator);
+}
@@ -0,0 +1,257 @@
+/* SPDX-License-Identifier: LGPL-2.1-only */
+/**
+ * libcgroup googletest for the selective and lazy cgroup_get_cgroup()
+ */
+
+#include <ftw.h>
+
+#include <string>
+
+#include "gtest/gtest.h"
+#include "libcgroup-internal.h"
+
+static const char * const PARENT_DIR = "test025cgroup";
+static const char * const CG_NAME = "selectcg";
+static const mode_t MODE = S_IRWXU | S_IRWXG | S_IRWXO;
+
+static const char * const CONTROLLERS[] = {
+	"cpu",
+	"memory",
+};
+static const int CONTROLLERS_CNT = ARRAY_SIZE(CONTROLLERS);
+
+static const char * const FILES[][2] = {
+	{"cpu", "tasks"},
+	{"cpu", "cpu.shares"},
+	{"cpu", "cpu.cfs_quota_us"},
+	{"memory", "tasks"},
+	{"memory", "memory.limit_in_bytes"},
+	{"memory", "memory.stat"},
+	{"memory", "memory.usage_in_bytes"},
+};
+static const char * const VALUES[] = {
+	"",
+	"512\n",
+	"-1\n",
+	"",
+	"1073741824\n",
+	"cache 0\nrss 4096\n",
+	"8192\n",
+};
+static const int FILES_CNT = ARRAY_SIZE(FILES);
+
+class CgroupGetCgroupSelectiveTest : public ::testing::Test {
+	protected:
+
+	void WriteFile(const char * const ctrl_name, const char * const name,
+		       const char * const value)
+	{
+		char tmp_path[FILENAME_MAX];
+		FILE *f;
+
+		snprintf(tmp_path, FILENAME_MAX - 1, "%s/%s/%s/%s", PARENT_DIR, ctrl_name, CG_NAME,
+			 name);
+
+		f = fopen(tmp_path, "w");
+		ASSERT_NE(f, nullptr);
+
+		fprintf(f, "%s", value);
+		fclose(f);
+	}
+
+	void SetUp() override
+	{
+		char tmp_path[FILENAME_MAX];
+		int i, ret;
+
+		ret = cgroup_init();
+		ASSERT_EQ(ret, 0);
+
+		ret = mkdir(PARENT_DIR, MODE);
+		ASSERT_EQ(ret, 0);
+
+		/*
+		 * Artificially populate the mount table with local
+		 * directories
+		 */
+		memset(&cg_mount_table, 0, sizeof(cg_mount_table));
+		memset(&cg_namespace_table, 0, sizeof(cg_namespace_table));
+
+		for (i = 0; i < CONTROLLERS_CNT; i++) {
+			snprintf(cg_mount_table[i].name, CONTROL_NAMELEN_MAX, "%s", CONTROLLERS[i]);
+			snprintf(cg_mount_table[i].mount.path, FILENAME_MAX,
+				 "%s/%s", PARENT_DIR, CONTROLLERS[i]);
+			cg_mount_table[i].version = CGROUP_V1;
+
+			ret = mkdir(cg_mount_table[i].mount.path, MODE);
+			ASSERT_EQ(ret, 0);
+
+			snprintf(tmp_path, FILENAME_MAX - 1, "%s/%s/%s", PARENT_DIR, CONTROLLERS[i],
+				 CG_NAME);
+			ret = mkdir(tmp_path, MODE);
+			ASSERT_EQ(ret, 0);
+		}
+
+		for (i = 0; i < FILES_CNT; i++)
+			WriteFile(FILES[i][0], FILES[i][1], VALUES[i]);
+	}
+
+	/*
+	 * https://stackoverflow.com/questions/5467725/how-to-delete-a-directory-and-its-contents-in-posix-c
+	 */
+	static int unlink_cb(const char *fpath, const struct stat *sb, int typeflag,
+		      struct FTW *ftwbuf)
+	{
+		return remove(fpath);
+	}
+
+	int rmrf(const char * const path)
+	{
+		return nftw(path, unlink_cb, 64, FTW_DEPTH | FTW_PHYS);
+	}
+
+	void TearDown() override
+	{
+		int ret = 0;
+
+		ret = rmrf(PARENT_DIR);
+		ASSERT_EQ(ret, 0);
+	}
+};
+
+TEST_F(CgroupGetCgroupSelectiveTest, CgroupGetCgroupRequestedValues)
+{
+	struct cgroup_controller *cgc;
+	struct cgroup *cgrp;
+	char *value;
+	int ret;
+
+	cgrp = cgroup_new_cgroup(CG_NAME);
+	ASSERT_NE(cgrp, nullptr);
+	cgc = cgroup_add_controller(cgrp, "memory");
+	ASSERT_NE(cgc, nullptr);
+	ASSERT_EQ(cgroup_add_value_string(cgc, "memory.stat", NULL), 0);
+	ASSERT_EQ(cgroup_add_value_string(cgc, "memory.usage_in_bytes", NULL), 0);
+
+	ret = cgroup_get_cgroup(cgrp);
+	ASSERT_EQ(ret, 0);
+
+	/* Only the requested settings are read */
+	ASSERT_EQ(cgroup_get_controller_count(cgrp), 1);
+	ASSERT_EQ(cgroup_get_value_name_count(cgc), 2);
+	ASSERT_FALSE(cgc->values[0]->dirty);
+
+	ASSERT_EQ(cgroup_get_value_string(cgc, "memory.stat", &value), 0);
+	ASSERT_STREQ(value, "cache 0\nrss 4096");
+	free(value);
+
+	ASSERT_EQ(cgroup_get_value_string(cgc, "memory.usage_in_bytes", &value), 0);
+	ASSERT_STREQ(value, "8192");
+	free(value);
+
+	ASSERT_EQ(cgroup_get_value_string(cgc, "memory.limit_in_bytes", &value),
+		  ECGROUPVALUENOTEXIST);
+
+	cgroup_free(&cgrp);
+}
+
+TEST_F(CgroupGetCgroupSelectiveTest, CgroupGetCgroupRequestedMissing)
+{
+	struct cgroup_controller *cgc;
+	struct cgroup *cgrp;
+	int ret;
+
+	cgrp = cgroup_new_cgroup(CG_NAME);
+	ASSERT_NE(cgrp, nullptr);
+	cgc = cgroup_add_controller(cgrp, "cpu");
+	ASSERT_NE(cgc, nullptr);
+	ASSERT_EQ(cgroup_add_value_string(cgc, "cpu.shares", NULL), 0);
+	ASSERT_EQ(cgroup_add_value_string(cgc, "cpu.foo", NULL), 0);
+
+	ret = cgroup_get_cgroup(cgrp);
+	ASSERT_EQ(ret, ECGROUPVALUENOTEXIST);
+
+	cgroup_free(&cgrp);
+}
+
+TEST_F(CgroupGetCgroupSelectiveTest, CgroupGetCgroupLazy)
+{
+	struct cgroup_controller *cgc;
+	struct cgroup *cgrp, *copy;
+	u_int64_t limit;
+	int64_t quota;
+	char *value;
+	int ret;
+
+	cgrp = cgroup_new_cgroup(CG_NAME);
+	ASSERT_NE(cgrp, nullptr);
+
+	ret = cgroup_get_cgroup_ext(cgrp, CGFLAG_GET_LAZY);
+	ASSERT_EQ(ret, 0);
+	ASSERT_EQ(cgroup_get_controller_count(cgrp), 2);
+
+	cgc = cgroup_get_controller(cgrp, "memory");
+	ASSERT_NE(cgc, nullptr);
+	ASSERT_EQ(cgroup_get_value_name_count(cgc), 3);
+
+	/* The values are read on first access, i.e. they see later writes */
+	WriteFile("memory", "memory.limit_in_bytes", "2147483648\n");
+	ASSERT_EQ(cgroup_get_value_uint64(cgc, "memory.limit_in_bytes", &limit), 0);
+	ASSERT_EQ(limit, 2147483648ULL);
+
+	/* ...but only once */
+	WriteFile("memory", "memory.limit_in_bytes", "4096\n");
+	ASSERT_EQ(cgroup_get_value_uint64(cgc, "memory.limit_in_bytes", &limit), 0);
+	ASSERT_EQ(limit, 2147483648ULL);
+
+	/* The copy reads the values not read yet from the source group */
+	copy = cgroup_new_cgroup("othercg");
+	ASSERT_NE(copy, nullptr);
+	ASSERT_EQ(cgroup_copy_cgroup(copy, cgrp), 0);
+
+	cgc = cgroup_get_controller(copy, "cpu");
+	ASSERT_NE(cgc, nullptr);
+	ASSERT_EQ(cgroup_get_value_int64(cgc, "cpu.cfs_quota_us", &quota), 0);
+	ASSERT_EQ(quota, -1);
+
+	cgc = cgroup_get_controller(cgrp, "memory");
+	ASSERT_EQ(cgroup_get_value_string(cgc, "memory.stat", &value), 0);
+	ASSERT_STREQ(value, "cache 0\nrss 4096");
+	free(value);
+
+	cgroup_free(&copy);
+	cgroup_free(&cgrp);
+}
+
+TEST_F(CgroupGetCgroupSelectiveTest, CgroupGetCgroupLargeValue)
+{
+	struct cgroup_controller *cgc;
+	struct cgroup *cgrp;
+	std::string stat;
+	char *value;
+	int ret, i;
+
+	/* Larger than CG_CONTROL_VALUE_MAX */
+	for (i = 0; i < 1000; i++)
+		stat += "key" + std::to_string(i) + " " + std::to_string(i * 4096) + "\n";
+	WriteFile("memory", "memory.stat", stat.c_str());
+	stat.pop_back();
+
+	cgrp = cgroup_new_cgroup(CG_NAME);
+	ASSERT_NE(cgrp, nullptr);
+
+	ret = cgroup_get_cgroup(cgrp);
+	ASSERT_EQ(ret, 0);
+
+	cgc = cgroup_get_controller(cgrp, "memory");
+	ASSERT_NE(cgc, nullptr);
+	ASSERT_EQ(cgroup_get_value_string(cgc, "memory.stat", &value), 0);
+	ASSERT_STREQ(value, stat.c_str());
+	free(value);
+
+	ASSERT_EQ(cgroup_get_value_string(cgc, "memory.usage_in_bytes", &value), 0);
+	ASSERT_STREQ(value, "8192");
+	free(value);
+
+	cgroup_free(&cgrp);
+}
@@ -0,0 +1,194 @@
+/* SPDX-License-Identifier: LGPL-2.1-only */
+/**
+ * libcgroup googletest for the typed stats readers
+ */
+
+#include <ftw.h>
+
+#include <string>
+
+#include "gtest/gtest.h"
+#include "libcgroup-internal.h"
+
+static const char * const PARENT_DIR = "test026cgroup";
+static const char * const CG_NAME = "statcg";
+static const mode_t MODE = S_IRWXU | S_IRWXG | S_IRWXO;
+
+class CgroupStatsTest : public ::testing::Test {
+	protected:
+
+	void SetUp() override
+	{
+		char tmp_path[FILENAME_MAX];
+		FILE *f;
+		int ret;
+
+		ret = cgroup_init();
+		ASSERT_EQ(ret, 0);
+
+		ret = mkdir(PARENT_DIR, MODE);
+		ASSERT_EQ(ret, 0);
+
+		/*
+		 * Artificially populate the mount table with a local
+		 * directory
+		 */
+		memset(&cg_mount_table, 0, sizeof(cg_mount_table));
+		memset(&cg_namespace_table, 0, sizeof(cg_namespace_table));
+
+		snprintf(cg_mount_table[0].name, CONTROL_NAMELEN_MAX, "cpu");
+		snprintf(cg_mount_table[0].mount.path, FILENAME_MAX, "%s", PARENT_DIR);
+		cg_mount_table[0].version = CGROUP_V2;
+
+		snprintf(tmp_path, FILENAME_MAX - 1, "%s/%s", PARENT_DIR, CG_NAME);
+		ret = mkdir(tmp_path, MODE);
+		ASSERT_EQ(ret, 0);
+
+		snprintf(tmp_path, FILENAME_MAX - 1, "%s/%s/cpu.stat", PARENT_DIR, CG_NAME);
+		f = fopen(tmp_path, "w");
+		ASSERT_NE(f, nullptr);
+		fprintf(f, "usage_usec 1000\nuser_usec 600\nsystem_usec 400\n");
+		fclose(f);
+	}
+
+	/*
+	 * https://stackoverflow.com/questions/5467725/how-to-delete-a-directory-and-its-contents-in-posix-c
+	 */
+	static int unlink_cb(const char *fpath, const struct stat *sb, int typeflag,
+			     struct FTW *ftwbuf)
+	{
+		return remove(fpath);
+	}
+
+	int rmrf(const char * const path)
+	{
+		return nftw(path, unlink_cb, 64, FTW_DEPTH | FTW_PHYS);
+	}
+
+	void TearDown() override
+	{
+		int ret = 0;
+
+		ret = rmrf(PARENT_DIR);
+		ASSERT_EQ(ret, 0);
+	}
+};
+
+TEST_F(CgroupStatsTest, CgroupParseStatsFlat)
+{
+	char buf[] = "anon 4096\nfile 8192\nfoo_bar 12\nworkingset_refault_anon 3\n";
+	struct cgroup_stats stats = {};
+	u_int64_t value;
+
+	ASSERT_EQ(cgroup_parse_stats(buf, &stats), 0);
+	ASSERT_EQ(stats.cnt, 4);
+
+	ASSERT_EQ(stats.entries[0].scope, nullptr);
+	ASSERT_STREQ(stats.entries[0].name, "anon");
+	ASSERT_EQ(stats.entries[0].key, CG_STAT_ANON);
+	ASSERT_EQ(stats.entries[0].value, 4096);
+
+	/* Unknown keys are returned with their name */
+	ASSERT_STREQ(stats.entries[2].name, "foo_bar");
+	ASSERT_EQ(stats.entries[2].key, CG_STAT_UNKNOWN);
+	ASSERT_EQ(stats.entries[2].value, 12);
+
+	ASSERT_EQ(cgroup_stats_get(&stats, NULL, CG_STAT_FILE, &value), 0);
+	ASSERT_EQ(value, 8192);
+	ASSERT_EQ(cgroup_stats_get(&stats, NULL, CG_STAT_WORKINGSET_REFAULT_ANON, &value), 0);
+	ASSERT_EQ(value, 3);
+	ASSERT_EQ(cgroup_stats_get(&stats, NULL, CG_STAT_SHMEM, &value),
+		  ECGROUPVALUENOTEXIST);
+
+	cgroup_stats_free(&stats);
+}
+
+TEST_F(CgroupStatsTest, CgroupParseStatsNested)
+{
+	char io[] = "8:0 rbytes=1024 wbytes=2048 rios=1 wios=2 dbytes=0 dios=0\n"
+		    "8:16 rbytes=4096 wbytes=0 rios=4 wios=0 dbytes=0 dios=0\n";
+	char pressure[] = "some avg10=1.25 avg60=0.50 avg300=0.00 total=123456\n"
+			  "full avg10=0.07 avg60=0.00 avg300=0.00 total=789\n";
+	struct cgroup_stats stats = {};
+	u_int64_t value;
+
+	ASSERT_EQ(cgroup_parse_stats(io, &stats), 0);
+	ASSERT_EQ(stats.cnt, 12);
+	ASSERT_STREQ(stats.entries[6].scope, "8:16");
+	ASSERT_EQ(stats.entries[6].key, CG_STAT_RBYTES);
+
+	ASSERT_EQ(cgroup_stats_get(&stats, "8:16", CG_STAT_RBYTES, &value), 0);
+	ASSERT_EQ(value, 4096);
+	ASSERT_EQ(cgroup_stats_get(&stats, "8:0", CG_STAT_WIOS, &value), 0);
+	ASSERT_EQ(value, 2);
+	ASSERT_EQ(cgroup_stats_get(&stats, NULL, CG_STAT_RBYTES, &value),
+		  ECGROUPVALUENOTEXIST);
+
+	/* The entries are reused, the averages are in hundredths */
+	ASSERT_EQ(cgroup_parse_stats(pressure, &stats), 0);
+	ASSERT_EQ(stats.cnt, 8);
+	ASSERT_EQ(cgroup_stats_get(&stats, "some", CG_STAT_AVG10, &value), 0);
+	ASSERT_EQ(value, 125);
+	ASSERT_EQ(cgroup_stats_get(&stats, "some", CG_STAT_AVG60, &value), 0);
+	ASSERT_EQ(value, 50);
+	ASSERT_EQ(cgroup_stats_get(&stats, "full", CG_STAT_AVG10, &value), 0);
+	ASSERT_EQ(value, 7);
+	ASSERT_EQ(cgroup_stats_get(&stats, "full", CG_STAT_TOTAL, &value), 0);
+	ASSERT_EQ(value, 789);
+
+	cgroup_stats_free(&stats);
+}
+
+TEST_F(CgroupStatsTest, CgroupParseStatsInvalid)
+{
+	char not_number[] = "anon 12abc\n";
+	char no_value[] = "anon\n";
+	struct cgroup_stats stats = {};
+
+	ASSERT_EQ(cgroup_parse_stats(not_number, &stats), ECGINVAL);
+	ASSERT_EQ(cgroup_parse_stats(no_value, &stats), ECGINVAL);
+
+	cgroup_stats_free(&stats);
+}
+
+TEST_F(CgroupStatsTest, CgroupParseStatsAllKeys)
+{
+	struct cgroup_stats stats = {};
+	std::string buf;
+	int i;
+
+	/* Every known key must be found by the hash */
+	for (i = 0; i < CG_STAT_KEY_CNT; i++)
+		buf += std::string(cgroup_stat_key_name((enum cgroup_stat_key)i)) + " " +
+		       std::to_string(i) + "\n";
+
+	ASSERT_EQ(cgroup_parse_stats(&buf[0], &stats), 0);
+	ASSERT_EQ(stats.cnt, CG_STAT_KEY_CNT);
+
+	for (i = 0; i < CG_STAT_KEY_CNT; i++) {
+		ASSERT_EQ(stats.entries[i].key, i);
+		ASSERT_EQ(stats.entries[i].value, i);
+	}
+
+	cgroup_stats_free(&stats);
+}
+
+TEST_F(CgroupStatsTest, CgroupReadStatsTyped)
+{
+	struct cgroup_stats stats = {};
+	u_int64_t value;
+
+	ASSERT_EQ(cgroup_read_stats_typed("cpu", CG_NAME, "cpu.stat", &stats), 0);
+	ASSERT_EQ(stats.cnt, 3);
+	ASSERT_EQ(cgroup_stats_get(&stats, NULL, CG_STAT_USAGE_USEC, &value), 0);
+	ASSERT_EQ(value, 1000);
+	ASSERT_EQ(cgroup_stats_get(&stats, NULL, CG_STAT_SYSTEM_USEC, &value), 0);
+	ASSERT_EQ(value, 400);
+
+	ASSERT_EQ(cgroup_read_stats_typed("cpu", CG_NAME, "cpu.pressure", &stats),
+		  ECGROUPVALUENOTEXIST);
+	ASSERT_EQ(cgroup_read_stats_typed("memory", CG_NAME, "memory.stat", &stats),
+		  ECGROUPSUBSYSNOTMOUNTED);
+
+	cgroup_stats_free(&stats);
+}
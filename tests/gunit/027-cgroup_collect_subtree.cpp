@@ -0,0 +1,177 @@
+/* SPDX-License-Identifier: LGPL-2.1-only */
+/**
+ * libcgroup googletest for cgroup_collect_subtree()
+ */
+
+#include <ftw.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "libcgroup-internal.h"
+
+static const char * const PARENT_DIR = "test027cgroup";
+static const char * const CG_NAME = "collectcg";
+static const mode_t MODE = S_IRWXU | S_IRWXG | S_IRWXO;
+
+/* Subgroups per group and depth of the subtree */
+static const int FANOUT = 4;
+static const int DEPTH = 3;
+
+struct collect_result {
+	std::mutex lock;
+	std::map<std::string, std::string> usage;
+	std::map<std::string, int> missing;
+	int calls;
+};
+
+static int collect_cb(const char *path, struct cgroup_file_value *values, int cnt, void *arg)
+{
+	struct collect_result *result = (struct collect_result *)arg;
+	std::lock_guard<std::mutex> guard(result->lock);
+
+	EXPECT_EQ(cnt, 2);
+	EXPECT_STREQ(values[0].name, "cpu.stat");
+	EXPECT_STREQ(values[1].name, "cpu.foo");
+
+	result->calls++;
+	if (values[0].error == 0)
+		result->usage[path] = std::string(values[0].value, values[0].len);
+	result->missing[path] = values[1].error;
+
+	return 0;
+}
+
+static int stop_cb(const char *path, struct cgroup_file_value *values, int cnt, void *arg)
+{
+	return 1234;
+}
+
+class CgroupCollectSubtreeTest : public ::testing::Test {
+	protected:
+
+	int group_cnt;
+
+	void CreateGroup(const std::string &name, int depth)
+	{
+		std::string path = std::string(PARENT_DIR) + "/" + name;
+		FILE *f;
+		int i;
+
+		ASSERT_EQ(mkdir(path.c_str(), MODE), 0);
+
+		f = fopen((path + "/cpu.stat").c_str(), "w");
+		ASSERT_NE(f, nullptr);
+		fprintf(f, "usage_usec %s\nuser_usec 0\n", name.c_str());
+		fclose(f);
+
+		group_cnt++;
+
+		for (i = 0; depth < DEPTH && i < FANOUT; i++)
+			CreateGroup(name + "/sub" + std::to_string(i), depth + 1);
+	}
+
+	void SetUp() override
+	{
+		int ret;
+
+		ret = cgroup_init();
+		ASSERT_EQ(ret, 0);
+
+		ret = mkdir(PARENT_DIR, MODE);
+		ASSERT_EQ(ret, 0);
+
+		/*
+		 * Artificially populate the mount table with a local
+		 * directory
+		 */
+		memset(&cg_mount_table, 0, sizeof(cg_mount_table));
+		memset(&cg_namespace_table, 0, sizeof(cg_namespace_table));
+
+		snprintf(cg_mount_table[0].name, CONTROL_NAMELEN_MAX, "cpu");
+		snprintf(cg_mount_table[0].mount.path, FILENAME_MAX, "%s", PARENT_DIR);
+		cg_mount_table[0].version = CGROUP_V2;
+
+		group_cnt = 0;
+		CreateGroup(CG_NAME, 0);
+	}
+
+	/*
+	 * https://stackoverflow.com/questions/5467725/how-to-delete-a-directory-and-its-contents-in-posix-c
+	 */
+	static int unlink_cb(const char *fpath, const struct stat *sb, int typeflag,
+			     struct FTW *ftwbuf)
+	{
+		return remove(fpath);
+	}
+
+	int rmrf(const char * const path)
+	{
+		return nftw(path, unlink_cb, 64, FTW_DEPTH | FTW_PHYS);
+	}
+
+	void TearDown() override
+	{
+		int ret = 0;
+
+		ret = rmrf(PARENT_DIR);
+		ASSERT_EQ(ret, 0);
+	}
+};
+
+TEST_F(CgroupCollectSubtreeTest, CgroupCollectSubtree)
+{
+	const char * const files[] = {"cpu.stat", "cpu.foo", NULL};
+	struct collect_result result;
+	int nthreads[] = {1, 4, 0};
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < ARRAY_SIZE(nthreads); i++) {
+		result.calls = 0;
+		result.usage.clear();
+		result.missing.clear();
+
+		ret = cgroup_collect_subtree("cpu", CG_NAME, files, collect_cb, &result,
+					     nthreads[i]);
+		ASSERT_EQ(ret, 0);
+
+		/* Every group is collected once */
+		ASSERT_EQ(result.calls, group_cnt);
+		ASSERT_EQ((int)result.usage.size(), group_cnt);
+
+		for (auto &usage : result.usage) {
+			ASSERT_EQ(usage.second, "usage_usec " + usage.first + "\nuser_usec 0");
+			ASSERT_EQ(result.missing[usage.first], ECGROUPVALUENOTEXIST);
+		}
+	}
+
+	ASSERT_EQ(result.usage.count(CG_NAME), 1);
+	ASSERT_EQ(result.usage.count(std::string(CG_NAME) + "/sub3/sub2/sub1"), 1);
+}
+
+TEST_F(CgroupCollectSubtreeTest, CgroupCollectSubtreeStop)
+{
+	const char * const files[] = {"cpu.stat", NULL};
+	int ret;
+
+	ret = cgroup_collect_subtree("cpu", CG_NAME, files, stop_cb, NULL, 4);
+	ASSERT_EQ(ret, 1234);
+}
+
+TEST_F(CgroupCollectSubtreeTest, CgroupCollectSubtreeErrors)
+{
+	const char * const files[] = {"cpu.stat", NULL};
+	int ret;
+
+	ret = cgroup_collect_subtree("cpu", "nonexistent", files, stop_cb, NULL, 2);
+	ASSERT_EQ(ret, ECGROUPNOTEXIST);
+
+	ret = cgroup_collect_subtree("memory", CG_NAME, files, stop_cb, NULL, 2);
+	ASSERT_EQ(ret, ECGROUPSUBSYSNOTMOUNTED);
+
+	ret = cgroup_collect_subtree("cpu", CG_NAME, NULL, stop_cb, NULL, 2);
+	ASSERT_EQ(ret, ECGINVAL);
+}
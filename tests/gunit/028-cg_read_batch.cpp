@@ -0,0 +1,195 @@
+/* SPDX-License-Identifier: LGPL-2.1-only */
+/**
+ * libcgroup googletest for the batched reads of cg_read_batch_run()
+ */
+
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <ftw.h>
+
+#include <string>
+
+#include "gtest/gtest.h"
+#include "libcgroup-internal.h"
+
+static const char * const PARENT_DIR = "test028cgroup";
+static const mode_t MODE = S_IRWXU | S_IRWXG | S_IRWXO;
+
+/* More files than fit in one submission */
+static const int FILE_CNT = 100;
+
+class CgReadBatchTest : public ::testing::Test {
+	protected:
+
+	std::string names[FILE_CNT];
+	std::string large;
+	int dirfd;
+
+	void SetUp() override
+	{
+		FILE *f;
+		int i;
+
+		ASSERT_EQ(mkdir(PARENT_DIR, MODE), 0);
+
+		for (i = 0; i < FILE_CNT; i++) {
+			names[i] = "cpu.file" + std::to_string(i);
+
+			/* Every tenth file is missing */
+			if (i % 10 == 9)
+				continue;
+
+			f = fopen((std::string(PARENT_DIR) + "/" + names[i]).c_str(), "w");
+			ASSERT_NE(f, nullptr);
+			fprintf(f, "%d\n", i);
+			fclose(f);
+		}
+
+		/* Larger than the initial buffer of a file */
+		large = std::string(5000, 'x');
+		f = fopen((std::string(PARENT_DIR) + "/" + names[0]).c_str(), "w");
+		ASSERT_NE(f, nullptr);
+		fprintf(f, "%s\n", large.c_str());
+		fclose(f);
+
+		dirfd = open(PARENT_DIR, O_PATH | O_DIRECTORY | O_CLOEXEC);
+		ASSERT_GE(dirfd, 0);
+	}
+
+	/*
+	 * https://stackoverflow.com/questions/5467725/how-to-delete-a-directory-and-its-contents-in-posix-c
+	 */
+	static int unlink_cb(const char *fpath, const struct stat *sb, int typeflag,
+			     struct FTW *ftwbuf)
+	{
+		return remove(fpath);
+	}
+
+	int rmrf(const char * const path)
+	{
+		return nftw(path, unlink_cb, 64, FTW_DEPTH | FTW_PHYS);
+	}
+
+	void TearDown() override
+	{
+		int ret = 0;
+
+		close(dirfd);
+		ret = rmrf(PARENT_DIR);
+		ASSERT_EQ(ret, 0);
+	}
+
+	void CheckBatch(struct cg_read_batch *batch)
+	{
+		int i;
+
+		ASSERT_EQ(batch->cnt, FILE_CNT);
+
+		ASSERT_EQ(batch->files[0].error, 0);
+		ASSERT_EQ(batch->files[0].len, large.size());
+		ASSERT_EQ(std::string(batch->files[0].buf), large);
+
+		for (i = 1; i < FILE_CNT; i++) {
+			if (i % 10 == 9) {
+				ASSERT_EQ(batch->files[i].error, ECGROUPVALUENOTEXIST);
+				continue;
+			}
+
+			ASSERT_EQ(batch->files[i].error, 0);
+			ASSERT_STREQ(batch->files[i].buf, std::to_string(i).c_str());
+			ASSERT_EQ(batch->files[i].len, std::to_string(i).size());
+		}
+	}
+};
+
+TEST_F(CgReadBatchTest, CgReadBatchRun)
+{
+	struct cg_read_batch batch = {};
+	int i, j;
+
+	/* The batch is reused, with its buffers */
+	for (j = 0; j < 2; j++) {
+		batch.cnt = 0;
+		for (i = 0; i < FILE_CNT; i++)
+			ASSERT_EQ(cg_read_batch_add(&batch, dirfd, names[i].c_str()), 0);
+
+		cg_read_batch_run(&batch);
+		CheckBatch(&batch);
+
+		/* The ring is released after the run */
+		ASSERT_EQ(batch.uring, nullptr);
+	}
+
+	cg_read_batch_free(&batch);
+	ASSERT_EQ(batch.files, nullptr);
+}
+
+TEST_F(CgReadBatchTest, CgReadBatchKeepRing)
+{
+	struct cg_read_batch batch = {};
+	struct cg_uring *uring = NULL;
+	int i, j;
+
+	/* The ring, if any, is kept from one run to the next */
+	batch.keep_ring = true;
+	for (j = 0; j < 2; j++) {
+		batch.cnt = 0;
+		for (i = 0; i < FILE_CNT; i++)
+			ASSERT_EQ(cg_read_batch_add(&batch, dirfd, names[i].c_str()), 0);
+
+		cg_read_batch_run(&batch);
+		CheckBatch(&batch);
+
+		if (j > 0)
+			ASSERT_EQ(batch.uring, uring);
+		uring = batch.uring;
+	}
+
+	cg_read_batch_free(&batch);
+	ASSERT_EQ(batch.uring, nullptr);
+}
+
+TEST_F(CgReadBatchTest, CgReadBatchSingle)
+{
+	struct cg_read_batch batch = {};
+
+	ASSERT_EQ(cg_read_batch_add(&batch, dirfd, names[1].c_str()), 0);
+	cg_read_batch_run(&batch);
+
+	ASSERT_EQ(batch.files[0].error, 0);
+	ASSERT_STREQ(batch.files[0].buf, "1");
+
+	cg_read_batch_free(&batch);
+}
+
+TEST_F(CgReadBatchTest, CgReadBatchFork)
+{
+	struct cg_read_batch batch = {};
+	int i, status;
+	pid_t pid;
+
+	for (i = 0; i < FILE_CNT; i++)
+		ASSERT_EQ(cg_read_batch_add(&batch, dirfd, names[i].c_str()), 0);
+
+	/* The parent sets up its ring and keeps it, the child must not use it */
+	batch.keep_ring = true;
+	cg_read_batch_run(&batch);
+	CheckBatch(&batch);
+
+	pid = fork();
+	ASSERT_GE(pid, 0);
+	if (pid == 0) {
+		cg_read_batch_run(&batch);
+		_exit(batch.files[1].error || strcmp(batch.files[1].buf, "1") ||
+		      batch.files[9].error != ECGROUPVALUENOTEXIST);
+	}
+
+	ASSERT_EQ(waitpid(pid, &status, 0), pid);
+	ASSERT_TRUE(WIFEXITED(status));
+	ASSERT_EQ(WEXITSTATUS(status), 0);
+
+	cg_read_batch_run(&batch);
+	CheckBatch(&batch);
+
+	cg_read_batch_free(&batch);
+}
@@ -0,0 +1,220 @@
+/* SPDX-License-Identifier: LGPL-2.1-only */
+/**
+ * libcgroup googletest for the stats sampler
+ */
+
+#include <ftw.h>
+
+#include <string>
+
+#include "gtest/gtest.h"
+#include "libcgroup-internal.h"
+
+static const char * const PARENT_DIR = "test029cgroup";
+static const char * const CG_NAME = "samplecg";
+static const mode_t MODE = S_IRWXU | S_IRWXG | S_IRWXO;
+
+class CgroupSamplerTest : public ::testing::Test {
+	protected:
+
+	void WriteFile(const char * const name, const char * const content)
+	{
+		char tmp_path[FILENAME_MAX];
+		FILE *f;
+
+		snprintf(tmp_path, FILENAME_MAX - 1, "%s/%s/%s", PARENT_DIR, CG_NAME, name);
+		f = fopen(tmp_path, "w");
+		ASSERT_NE(f, nullptr);
+		fprintf(f, "%s", content);
+		fclose(f);
+	}
+
+	void SetUp() override
+	{
+		char tmp_path[FILENAME_MAX];
+		int ret;
+
+		ret = cgroup_init();
+		ASSERT_EQ(ret, 0);
+
+		ret = mkdir(PARENT_DIR, MODE);
+		ASSERT_EQ(ret, 0);
+
+		/*
+		 * Artificially populate the mount table with a local
+		 * directory
+		 */
+		memset(&cg_mount_table, 0, sizeof(cg_mount_table));
+		memset(&cg_namespace_table, 0, sizeof(cg_namespace_table));
+
+		snprintf(cg_mount_table[0].name, CONTROL_NAMELEN_MAX, "cpu");
+		snprintf(cg_mount_table[0].mount.path, FILENAME_MAX, "%s", PARENT_DIR);
+		cg_mount_table[0].version = CGROUP_V2;
+
+		snprintf(tmp_path, FILENAME_MAX - 1, "%s/%s", PARENT_DIR, CG_NAME);
+		ret = mkdir(tmp_path, MODE);
+		ASSERT_EQ(ret, 0);
+
+		WriteFile("cpu.stat", "usage_usec 1000\nuser_usec 600\nsystem_usec 400\n");
+		WriteFile("cpu.pressure", "some avg10=0.00 avg60=0.00 avg300=0.00 total=100\n"
+					  "full avg10=0.00 avg60=0.00 avg300=0.00 total=50\n");
+	}
+
+	/*
+	 * https://stackoverflow.com/questions/5467725/how-to-delete-a-directory-and-its-contents-in-posix-c
+	 */
+	static int unlink_cb(const char *fpath, const struct stat *sb, int typeflag,
+			     struct FTW *ftwbuf)
+	{
+		return remove(fpath);
+	}
+
+	int rmrf(const char * const path)
+	{
+		return nftw(path, unlink_cb, 64, FTW_DEPTH | FTW_PHYS);
+	}
+
+	void TearDown() override
+	{
+		int ret = 0;
+
+		ret = rmrf(PARENT_DIR);
+		ASSERT_EQ(ret, 0);
+	}
+};
+
+TEST_F(CgroupSamplerTest, CgroupSamplerDeltas)
+{
+	const struct cgroup_stat_delta *deltas;
+	struct cgroup_sampler *sampler;
+	struct cgroup_stat_delta delta;
+	u_int64_t interval_ns;
+	int stat_id, psi_id;
+	int cnt;
+
+	ASSERT_EQ(cgroup_sampler_create(&sampler), 0);
+	ASSERT_EQ(cgroup_sampler_add(sampler, CG_NAME, "cpu.stat", &stat_id), 0);
+	ASSERT_EQ(cgroup_sampler_add(sampler, CG_NAME, "cpu.pressure", &psi_id), 0);
+
+	/* The files of the group share its handle */
+	ASSERT_EQ(sampler->files[stat_id].handle, sampler->files[psi_id].handle);
+
+	/* No deltas before the first sample, all values are new after it */
+	ASSERT_EQ(cgroup_sampler_get_deltas(sampler, stat_id, &deltas, &cnt, &interval_ns), 0);
+	ASSERT_EQ(cnt, 0);
+
+	ASSERT_EQ(cgroup_sampler_sample(sampler), 0);
+	ASSERT_EQ(cgroup_sampler_get_deltas(sampler, stat_id, &deltas, &cnt, &interval_ns), 0);
+	ASSERT_EQ(cnt, 3);
+	ASSERT_EQ(interval_ns, 0);
+	ASSERT_EQ(deltas[0].key, CG_STAT_USAGE_USEC);
+	ASSERT_EQ(deltas[0].value, 1000);
+	ASSERT_EQ(deltas[0].delta, 0);
+	ASSERT_EQ(deltas[0].flags, CG_STAT_DELTA_NEW);
+
+	WriteFile("cpu.stat", "usage_usec 3000\nuser_usec 600\nsystem_usec 2400\n");
+	WriteFile("cpu.pressure", "some avg10=0.00 avg60=0.00 avg300=0.00 total=300\n"
+				  "full avg10=0.00 avg60=0.00 avg300=0.00 total=50\n");
+	usleep(1000);
+
+	ASSERT_EQ(cgroup_sampler_sample(sampler), 0);
+	ASSERT_EQ(cgroup_sampler_get_deltas(sampler, stat_id, &deltas, &cnt, &interval_ns), 0);
+	ASSERT_EQ(cnt, 3);
+	ASSERT_GE(interval_ns, 1000000);
+
+	ASSERT_EQ(cgroup_sampler_get(sampler, stat_id, NULL, CG_STAT_USAGE_USEC, &delta), 0);
+	ASSERT_EQ(delta.value, 3000);
+	ASSERT_EQ(delta.delta, 2000);
+	ASSERT_EQ(delta.flags, 0);
+	ASSERT_DOUBLE_EQ(delta.rate, 2000 * 1e9 / interval_ns);
+
+	ASSERT_EQ(cgroup_sampler_get(sampler, stat_id, NULL, CG_STAT_USER_USEC, &delta), 0);
+	ASSERT_EQ(delta.delta, 0);
+	ASSERT_EQ(delta.rate, 0);
+
+	ASSERT_EQ(cgroup_sampler_get(sampler, psi_id, "some", CG_STAT_TOTAL, &delta), 0);
+	ASSERT_EQ(delta.delta, 200);
+	ASSERT_EQ(cgroup_sampler_get(sampler, psi_id, "full", CG_STAT_TOTAL, &delta), 0);
+	ASSERT_EQ(delta.delta, 0);
+	ASSERT_EQ(cgroup_sampler_get(sampler, psi_id, NULL, CG_STAT_TOTAL, &delta),
+		  ECGROUPVALUENOTEXIST);
+
+	/* A counter going backwards was reset, new lines are matched by name */
+	WriteFile("cpu.stat", "nr_periods 5\nusage_usec 500\nuser_usec 700\nsystem_usec 2400\n");
+
+	ASSERT_EQ(cgroup_sampler_sample(sampler), 0);
+	ASSERT_EQ(cgroup_sampler_get(sampler, stat_id, NULL, CG_STAT_USAGE_USEC, &delta), 0);
+	ASSERT_EQ(delta.delta, 500);
+	ASSERT_EQ(delta.flags, CG_STAT_DELTA_RESET);
+	ASSERT_EQ(cgroup_sampler_get(sampler, stat_id, NULL, CG_STAT_USER_USEC, &delta), 0);
+	ASSERT_EQ(delta.delta, 100);
+	ASSERT_EQ(delta.flags, 0);
+	ASSERT_EQ(cgroup_sampler_get(sampler, stat_id, NULL, CG_STAT_NR_PERIODS, &delta), 0);
+	ASSERT_EQ(delta.delta, 0);
+	ASSERT_EQ(delta.flags, CG_STAT_DELTA_NEW);
+
+	cgroup_sampler_free(&sampler);
+	ASSERT_EQ(sampler, nullptr);
+}
+
+TEST_F(CgroupSamplerTest, CgroupSamplerGauges)
+{
+	struct cgroup_sampler *sampler;
+	struct cgroup_stat_delta delta;
+	int id;
+
+	WriteFile("cpu.pressure", "some avg10=1.50 avg60=0.00 avg300=0.00 total=100\n");
+	WriteFile("cpu.stat", "usage_usec 1000\nfoo_usec 300\n");
+
+	ASSERT_EQ(cgroup_sampler_create(&sampler), 0);
+	ASSERT_EQ(cgroup_sampler_add(sampler, CG_NAME, "cpu.pressure", &id), 0);
+	ASSERT_EQ(cgroup_sampler_add(sampler, CG_NAME, "cpu.stat", &id), 0);
+	ASSERT_EQ(cgroup_sampler_sample(sampler), 0);
+
+	WriteFile("cpu.pressure", "some avg10=0.50 avg60=0.25 avg300=0.00 total=90\n");
+	WriteFile("cpu.stat", "usage_usec 2000\nfoo_usec 100\n");
+	ASSERT_EQ(cgroup_sampler_sample(sampler), 0);
+
+	/* A gauge that decreased wasn't reset */
+	ASSERT_EQ(cgroup_sampler_get(sampler, 0, "some", CG_STAT_AVG10, &delta), 0);
+	ASSERT_EQ(delta.delta, -100);
+	ASSERT_EQ(delta.flags, 0);
+	ASSERT_LT(delta.rate, 0);
+	ASSERT_EQ(cgroup_sampler_get(sampler, 0, "some", CG_STAT_AVG60, &delta), 0);
+	ASSERT_EQ(delta.delta, 25);
+
+	/* A counter that decreased was */
+	ASSERT_EQ(cgroup_sampler_get(sampler, 0, "some", CG_STAT_TOTAL, &delta), 0);
+	ASSERT_EQ(delta.delta, 90);
+	ASSERT_EQ(delta.flags, CG_STAT_DELTA_RESET);
+
+	/* Unknown keys are gauges */
+	ASSERT_EQ(sampler->files[id].deltas[1].key, CG_STAT_UNKNOWN);
+	ASSERT_EQ(sampler->files[id].deltas[1].delta, -200);
+	ASSERT_EQ(sampler->files[id].deltas[1].flags, 0);
+
+	cgroup_sampler_free(&sampler);
+}
+
+TEST_F(CgroupSamplerTest, CgroupSamplerErrors)
+{
+	struct cgroup_sampler *sampler;
+	struct cgroup_stat_delta delta;
+	int id;
+
+	ASSERT_EQ(cgroup_sampler_create(&sampler), 0);
+	ASSERT_EQ(cgroup_sampler_add(sampler, "nonexistent", "cpu.stat", &id),
+		  ECGROUPNOTEXIST);
+	ASSERT_EQ(cgroup_sampler_add(sampler, CG_NAME, "cpu.foo", &id), 0);
+
+	/* The other files are sampled anyway */
+	ASSERT_EQ(cgroup_sampler_add(sampler, CG_NAME, "cpu.stat", &id), 0);
+	ASSERT_EQ(cgroup_sampler_sample(sampler), ECGROUPVALUENOTEXIST);
+	ASSERT_EQ(cgroup_sampler_get(sampler, id, NULL, CG_STAT_USAGE_USEC, &delta), 0);
+	ASSERT_EQ(delta.value, 1000);
+
+	ASSERT_EQ(cgroup_sampler_get(sampler, id + 1, NULL, CG_STAT_USAGE_USEC, &delta),
+		  ECGINVAL);
+
+	cgroup_sampler_free(&sampler);
+}
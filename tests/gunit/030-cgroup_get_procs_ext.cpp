@@ -0,0 +1,177 @@
+/* SPDX-License-Identifier: LGPL-2.1-only */
+/**
+ * libcgroup googletest for cgroup_get_procs_ext() and cgroup_get_threads_ext()
+ */
+
+#include <ftw.h>
+
+#include <algorithm>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "libcgroup-internal.h"
+
+static const char * const PARENT_DIR = "test030cgroup";
+static const char * const CG_NAME = "procscg";
+static const mode_t MODE = S_IRWXU | S_IRWXG | S_IRWXO;
+
+/* Spans several chunks of the reader */
+static const int PID_CNT = 20000;
+
+class CgroupGetProcsExtTest : public ::testing::Test {
+	protected:
+
+	void WriteFile(const char * const name, const std::string &content)
+	{
+		char tmp_path[FILENAME_MAX];
+		FILE *f;
+
+		snprintf(tmp_path, FILENAME_MAX - 1, "%s/%s/%s", PARENT_DIR, CG_NAME, name);
+		f = fopen(tmp_path, "w");
+		ASSERT_NE(f, nullptr);
+		fprintf(f, "%s", content.c_str());
+		fclose(f);
+	}
+
+	void SetUp() override
+	{
+		char tmp_path[FILENAME_MAX];
+		std::string procs;
+		int ret, i;
+
+		ret = cgroup_init();
+		ASSERT_EQ(ret, 0);
+
+		ret = mkdir(PARENT_DIR, MODE);
+		ASSERT_EQ(ret, 0);
+
+		/*
+		 * Artificially populate the mount table with a local
+		 * directory
+		 */
+		memset(&cg_mount_table, 0, sizeof(cg_mount_table));
+		memset(&cg_namespace_table, 0, sizeof(cg_namespace_table));
+
+		snprintf(cg_mount_table[0].name, CONTROL_NAMELEN_MAX, "cpu");
+		snprintf(cg_mount_table[0].mount.path, FILENAME_MAX, "%s", PARENT_DIR);
+		cg_mount_table[0].version = CGROUP_V2;
+
+		snprintf(tmp_path, FILENAME_MAX - 1, "%s/%s", PARENT_DIR, CG_NAME);
+		ret = mkdir(tmp_path, MODE);
+		ASSERT_EQ(ret, 0);
+
+		/* Descending, so that sorting shows */
+		for (i = PID_CNT; i > 0; i--)
+			procs += std::to_string(i * 7) + "\n";
+		WriteFile("cgroup.procs", procs);
+
+		/* Without the last newline */
+		WriteFile("cgroup.threads", "300\n100\n200");
+	}
+
+	/*
+	 * https://stackoverflow.com/questions/5467725/how-to-delete-a-directory-and-its-contents-in-posix-c
+	 */
+	static int unlink_cb(const char *fpath, const struct stat *sb, int typeflag,
+			     struct FTW *ftwbuf)
+	{
+		return remove(fpath);
+	}
+
+	int rmrf(const char * const path)
+	{
+		return nftw(path, unlink_cb, 64, FTW_DEPTH | FTW_PHYS);
+	}
+
+	void TearDown() override
+	{
+		int ret = 0;
+
+		ret = rmrf(PARENT_DIR);
+		ASSERT_EQ(ret, 0);
+	}
+};
+
+TEST_F(CgroupGetProcsExtTest, CgroupGetProcsExt)
+{
+	pid_t *pids = NULL, *buf;
+	int size = 0, cnt;
+	int ret, i;
+
+	ret = cgroup_get_procs_ext(CG_NAME, "cpu", &pids, &size, &cnt, 0);
+	ASSERT_EQ(ret, 0);
+	ASSERT_EQ(cnt, PID_CNT);
+	ASSERT_GE(size, PID_CNT);
+	for (i = 0; i < cnt; i++)
+		ASSERT_EQ(pids[i], (PID_CNT - i) * 7);
+
+	/* The buffer is reused */
+	buf = pids;
+	ret = cgroup_get_procs_ext(CG_NAME, "cpu", &pids, &size, &cnt, CGFLAG_GET_PIDS_SORT);
+	ASSERT_EQ(ret, 0);
+	ASSERT_EQ(pids, buf);
+	ASSERT_EQ(cnt, PID_CNT);
+	for (i = 0; i < cnt; i++)
+		ASSERT_EQ(pids[i], (i + 1) * 7);
+
+	ret = cgroup_get_procs_ext(CG_NAME, "cpu", NULL, NULL, &cnt, CGFLAG_GET_PIDS_COUNT);
+	ASSERT_EQ(ret, 0);
+	ASSERT_EQ(cnt, PID_CNT);
+
+	free(pids);
+}
+
+TEST_F(CgroupGetProcsExtTest, CgroupGetThreadsExt)
+{
+	pid_t *pids = NULL;
+	int size = 0, cnt;
+	int ret;
+
+	ret = cgroup_get_threads_ext(CG_NAME, "cpu", &pids, &size, &cnt, CGFLAG_GET_PIDS_SORT);
+	ASSERT_EQ(ret, 0);
+	ASSERT_EQ(cnt, 3);
+	ASSERT_EQ(pids[0], 100);
+	ASSERT_EQ(pids[1], 200);
+	ASSERT_EQ(pids[2], 300);
+
+	ret = cgroup_get_threads_ext(CG_NAME, "cpu", NULL, NULL, &cnt, CGFLAG_GET_PIDS_COUNT);
+	ASSERT_EQ(ret, 0);
+	ASSERT_EQ(cnt, 3);
+
+	/* The legacy function is sorted and always allocated */
+	free(pids);
+	ret = cgroup_get_threads(CG_NAME, "cpu", &pids, &cnt);
+	ASSERT_EQ(ret, 0);
+	ASSERT_EQ(cnt, 3);
+	ASSERT_TRUE(std::is_sorted(pids, pids + cnt));
+	free(pids);
+
+	WriteFile("cgroup.threads", "");
+	ret = cgroup_get_threads(CG_NAME, "cpu", &pids, &cnt);
+	ASSERT_EQ(ret, 0);
+	ASSERT_EQ(cnt, 0);
+	ASSERT_NE(pids, nullptr);
+	free(pids);
+}
+
+TEST_F(CgroupGetProcsExtTest, CgroupGetProcsExtErrors)
+{
+	pid_t *pids = NULL;
+	int size = 0, cnt;
+	int ret;
+
+	ret = cgroup_get_procs_ext(CG_NAME, "cpu", NULL, NULL, &cnt, 0);
+	ASSERT_EQ(ret, ECGINVAL);
+
+	ret = cgroup_get_procs_ext("nonexistent", "cpu", &pids, &size, &cnt, 0);
+	ASSERT_EQ(ret, ECGROUPUNSUPP);
+
+	ret = cgroup_get_procs_ext(CG_NAME, "memory", &pids, &size, &cnt, 0);
+	ASSERT_EQ(ret, ECGROUPSUBSYSNOTMOUNTED);
+
+	WriteFile("cgroup.procs", "12\nabc\n");
+	ret = cgroup_get_procs_ext(CG_NAME, "cpu", &pids, &size, &cnt, 0);
+	ASSERT_EQ(ret, ECGINVAL);
+
+	free(pids);
+}
@@ -0,0 +1,106 @@
+/* SPDX-License-Identifier: LGPL-2.1-only */
+/**
+ * libcgroup googletest for cgroup_load_templates_cache_from_files()
+ */
+
+#include <malloc.h>
+
+#include "gtest/gtest.h"
+
+#include "libcgroup-internal.h"
+#include "tools-common.h"
+
+static const char * const TEMPLATE_FILES[] = {
+	"test031-templates1.conf",
+	"test031-templates2.conf",
+};
+
+static const char * const TEMPLATES[] = {
+	"template students/%u {\n"
+	"	cpu {\n"
+	"		cpu.shares = \"100\";\n"
+	"	}\n"
+	"}\n",
+
+	"template staff/%u {\n"
+	"	cpu {\n"
+	"		cpu.shares = \"200\";\n"
+	"	}\n"
+	"	memory {\n"
+	"		memory.limit_in_bytes = \"1G\";\n"
+	"	}\n"
+	"}\n"
+	"template guests/%u {\n"
+	"	cpu {\n"
+	"		cpu.shares = \"50\";\n"
+	"	}\n"
+	"}\n",
+};
+
+class CgroupLoadTemplatesCacheTest : public ::testing::Test {
+	protected:
+
+	struct cgroup_string_list files;
+
+	void SetUp() override
+	{
+		unsigned int i;
+		FILE *f;
+
+		ASSERT_EQ(cgroup_init(), 0);
+
+		/* Fill allocations with garbage, so that uninitialized fields show */
+		mallopt(M_PERTURB, 0xa5);
+
+		/* The controllers of the templates must be known */
+		memset(&cg_mount_table, 0, sizeof(cg_mount_table));
+		memset(&cg_namespace_table, 0, sizeof(cg_namespace_table));
+
+		snprintf(cg_mount_table[0].name, CONTROL_NAMELEN_MAX, "cpu");
+		snprintf(cg_mount_table[0].mount.path, FILENAME_MAX, "/sys/fs/cgroup");
+		cg_mount_table[0].version = CGROUP_V2;
+		snprintf(cg_mount_table[1].name, CONTROL_NAMELEN_MAX, "memory");
+		snprintf(cg_mount_table[1].mount.path, FILENAME_MAX, "/sys/fs/cgroup");
+		cg_mount_table[1].version = CGROUP_V2;
+
+		for (i = 0; i < ARRAY_SIZE(TEMPLATE_FILES); i++) {
+			f = fopen(TEMPLATE_FILES[i], "w");
+			ASSERT_NE(f, nullptr);
+			fprintf(f, "%s", TEMPLATES[i]);
+			fclose(f);
+		}
+
+		files.items = (char **)TEMPLATE_FILES;
+		files.size = ARRAY_SIZE(TEMPLATE_FILES);
+		files.count = ARRAY_SIZE(TEMPLATE_FILES);
+	}
+
+	void TearDown() override
+	{
+		unsigned int i;
+
+		mallopt(M_PERTURB, 0);
+
+		for (i = 0; i < ARRAY_SIZE(TEMPLATE_FILES); i++)
+			ASSERT_EQ(remove(TEMPLATE_FILES[i]), 0);
+	}
+};
+
+TEST_F(CgroupLoadTemplatesCacheTest, CgroupLoadTemplatesFromTwoFiles)
+{
+	int file_index = -1;
+	int ret;
+
+	cgroup_templates_cache_set_source_files(&files);
+
+	ret = cgroup_load_templates_cache_from_files(&file_index);
+	ASSERT_EQ(ret, 0);
+	ASSERT_EQ(file_index, -1);
+
+	/* Loading again frees the templates of the first load */
+	ret = cgroup_load_templates_cache_from_files(&file_index);
+	ASSERT_EQ(ret, 0);
+	ASSERT_EQ(file_index, -1);
+
+	cgroup_templates_cache_set_source_files(NULL);
+}